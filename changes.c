@@ -0,0 +1,186 @@
+/* changes.c: Recording what the game logic changes from tick to tick.
+ *
+ * Copyright (C) 2001-2014 by Brian Raiter, Madhav Shanbhag, and Eric Schmidt,
+ * under the GNU General Public License. No warranty. See COPYING for details.
+ */
+
+#include	<stdlib.h>
+#include	<string.h>
+#include	"defs.h"
+#include	"err.h"
+#include	"changes.h"
+
+/* Create an empty change log.
+ */
+changelog *newchangelog(void)
+{
+    changelog  *log;
+
+    log = calloc(1, sizeof *log);
+    if (!log)
+	memerrexit();
+    log->all = TRUE;
+    return log;
+}
+
+/* Free a change log.
+ */
+void freechangelog(changelog *log)
+{
+    if (!log)
+	return;
+    free(log->slots);
+    free(log->before);
+    free(log->after);
+    free(log);
+}
+
+/* Empty the log. Only the marks of the cells actually listed need to
+ * be cleared. The creatures as they are now become the ones that
+ * later changes are measured against.
+ */
+void clearchangelog(changelog *log)
+{
+    creature   *swap;
+    int		n;
+
+    for (n = 0 ; n < log->cellcount ; ++n)
+	log->cellmarks[log->cells[n]] = 0;
+    log->cellcount = 0;
+    log->slotcount = 0;
+    if (log->all) {
+	log->havebefore = FALSE;
+	log->all = FALSE;
+    } else if (log->haveafter) {
+	swap = log->before;
+	log->before = log->after;
+	log->after = swap;
+	n = log->beforeallocated;
+	log->beforeallocated = log->afterallocated;
+	log->afterallocated = n;
+	log->beforecount = log->aftercount;
+	log->havebefore = TRUE;
+    }
+    log->haveafter = FALSE;
+}
+
+/* Add a map location to the list of changed cells, if it is not
+ * already there.
+ */
+void logcellchange(changelog *log, int pos)
+{
+    if (pos < 0 || pos >= CXGRID * CYGRID || log->cellmarks[pos])
+	return;
+    log->cellmarks[pos] = 1;
+    log->cells[log->cellcount++] = pos;
+}
+
+/* Make sure that a creature buffer has room for count creatures.
+ */
+static creature *growbuffer(creature **buf, int *allocated, int count)
+{
+    if (count > *allocated) {
+	*allocated = count + 256;
+	*buf = realloc(*buf, *allocated * sizeof **buf);
+	if (!*buf)
+	    memerrexit();
+    }
+    return *buf;
+}
+
+/* Return room for a copy of the creatures as they are at the start
+ * of a tick, unless the log already has one.
+ */
+creature *creaturesbefore(changelog *log, int count)
+{
+    if (log->havebefore)
+	return NULL;
+    log->havebefore = TRUE;
+    log->beforecount = count;
+    return growbuffer(&log->before, &log->beforeallocated, count);
+}
+
+/* Return room for a copy of the creatures as they are at the end of
+ * a tick.
+ */
+creature *creaturesafter(changelog *log, int count)
+{
+    log->haveafter = TRUE;
+    log->aftercount = count;
+    return growbuffer(&log->after, &log->afterallocated, count);
+}
+
+/* The number of creature slots compared at a time when looking for
+ * the ones that have changed.
+ */
+#define	SLOTRUN		16
+
+/* TRUE if the given entry in a copy of the creatures is in use.
+ */
+#define	inuse(list, count, n)	\
+	((n) < (count) && (list)[n].id != Nothing && !(list)[n].hidden)
+
+/* Compare two creatures field by field (so as not to be misled by
+ * any padding between them).
+ */
+static int samecreature(creature const *a, creature const *b)
+{
+    return a->pos == b->pos && a->id == b->id && a->dir == b->dir
+			    && a->moving == b->moving && a->frame == b->frame
+			    && a->hidden == b->hidden && a->state == b->state
+			    && a->tdir == b->tdir
+			    && a->slipindex == b->slipindex;
+}
+
+/* Compare the creatures as they are now with the creatures as they
+ * were when the log was cleared, and list the ones that differ. The
+ * list is rebuilt every time, so that a creature that has changed
+ * and then changed back is not listed. A slot that is out of use is
+ * listed if its bytes differ at all. Since few slots change in any one
+ * tick, runs of them are first compared as a block.
+ */
+void logcreaturechanges(changelog *log)
+{
+    creature const     *before = log->before;
+    creature const     *after = log->after;
+    int			was, is, how, common, n;
+
+    log->slotcount = 0;
+    n = log->beforecount > log->aftercount ? log->beforecount
+					   : log->aftercount;
+    if (log->slotsallocated < n) {
+	log->slotsallocated = n + 256;
+	log->slots = realloc(log->slots,
+			     log->slotsallocated * sizeof *log->slots);
+	if (!log->slots)
+	    memerrexit();
+    }
+
+    common = log->beforecount < log->aftercount ? log->beforecount
+						: log->aftercount;
+    for (n = 0 ; n < log->beforecount || n < log->aftercount ; ++n) {
+	if (n % SLOTRUN == 0 && n + SLOTRUN <= common
+			     && !memcmp(before + n, after + n,
+					SLOTRUN * sizeof *before)) {
+	    n += SLOTRUN - 1;
+	    continue;
+	}
+	was = inuse(before, log->beforecount, n);
+	is = inuse(after, log->aftercount, n);
+	if (was && is)
+	    how = CHANGE_MODIFIED;
+	else if (is)
+	    how = CHANGE_ADDED;
+	else if (was)
+	    how = CHANGE_REMOVED;
+	else if (n < common && memcmp(before + n, after + n, sizeof *before))
+	    how = 0;
+	else
+	    continue;
+	if (how == CHANGE_MODIFIED && samecreature(before + n, after + n))
+	    continue;
+	log->slots[log->slotcount].slot = n;
+	log->slots[log->slotcount].how = how;
+	++log->slotcount;
+    }
+}
@@ -0,0 +1,83 @@
+/* changes.h: Recording what the game logic changes from tick to tick.
+ *
+ * Copyright (C) 2001-2014 by Brian Raiter, Madhav Shanbhag, and Eric Schmidt,
+ * under the GNU General Public License. No warranty. See COPYING for details.
+ */
+
+#ifndef	HEADER_changes_h_
+#define	HEADER_changes_h_
+
+#include	"state.h"
+
+/* The ways in which a creature slot can have changed.
+ */
+#define	CHANGE_MODIFIED		0x01	/* the creature is different */
+#define	CHANGE_ADDED		0x02	/* the slot has come into use */
+#define	CHANGE_REMOVED		0x04	/* the slot has gone out of use */
+
+/* A creature slot that has changed. For the Lynx ruleset, slot is an
+ * index into the game state's creature list. The MS ruleset keeps its
+ * creatures to itself, so there the number only identifies the same
+ * creature from one tick to the next. how is 0 for a slot that is out
+ * of use both before and after but whose contents are different, as
+ * the logic can still look at them.
+ */
+typedef struct changedslot {
+    int			slot;		/* which creature */
+    int			how;		/* one of CHANGE_*, or 0 */
+} changedslot;
+
+/* A record of the changes made to the map and to the creatures since
+ * the log was last cleared. If all is TRUE, the game state has been
+ * replaced wholesale (by a new level, or by going back to an earlier
+ * tick), and the lists of changes are not to be relied upon. A cell
+ * may be listed even though it ends up as it started, but a creature
+ * slot is only listed if its contents are different.
+ */
+typedef struct changelog {
+    int			all;			/* everything has changed */
+    int			cellcount;		/* number of cells changed */
+    int			slotcount;		/* number of creatures changed */
+    short		cells[CXGRID * CYGRID];	/* the cells changed */
+    changedslot	       *slots;			/* the creatures changed */
+    int			slotsallocated;
+    unsigned char	cellmarks[CXGRID * CYGRID];
+						/* which cells are listed */
+    creature	       *before;			/* the creatures as of the */
+    int			beforecount;		/*   last time the log was */
+    int			beforeallocated;	/*   cleared */
+    int			havebefore;
+    creature	       *after;			/* the creatures as of now */
+    int			aftercount;
+    int			afterallocated;
+    int			haveafter;
+} changelog;
+
+/* Create an empty change log.
+ */
+extern changelog *newchangelog(void);
+
+/* Free a change log.
+ */
+extern void freechangelog(changelog *log);
+
+/* Empty the log, so that it records changes from this point on.
+ */
+extern void clearchangelog(changelog *log);
+
+/* Add a map location to the list of changed cells.
+ */
+extern void logcellchange(changelog *log, int pos);
+
+/* The logic modules record the changes to their creatures by copying
+ * them before and after each tick. creaturesbefore() returns room for
+ * count creatures as they are at the start of a tick, or NULL if the
+ * log already has a copy from an earlier tick. creaturesafter()
+ * returns room for count creatures as they are at the end of the
+ * tick. The two copies are then compared with logcreaturechanges().
+ */
+extern creature *creaturesbefore(changelog *log, int count);
+extern creature *creaturesafter(changelog *log, int count);
+extern void logcreaturechanges(changelog *log);
+
+#endif
@@ -35,6 +35,11 @@ ifneq ($(findstring qt,$(OSHW)),)
         COMMONFLAGS += -DTWPLUSPLUS
 endif
 
+# "make PHASETIMING=1" times each phase of the game logic (see -H)
+ifdef PHASETIMING
+	COMMONFLAGS += -DPHASETIMING
+endif
+
 CFLAGS += $(COMMONFLAGS)
 CXXFLAGS += $(COMMONFLAGS)
 
@@ -33,12 +33,20 @@ typedef	struct fileinfo {
     char	alloc;		/* TRUE if name was allocated internally */
 } fileinfo;
 
+/* The contents of a file, as mapped into memory by filemap().
+ */
+typedef	struct filemapping {
+    unsigned char      *data;		/* the file's bytes, or NULL */
+    unsigned long	size;		/* the number of bytes */
+    char		mapped;		/* FALSE if data was read into memory */
+} filemapping;
+
 /* Pseudorandom number generators.
  */
 typedef	struct prng {
     uint32_t		initial;	/* initial seed value */
     uint32_t		value;		/* latest random value */
-    char		shared;		/* FALSE if independent sequence */
+    uint32_t	       *shared;		/* NULL if independent sequence */
 } prng;
 
 /*
@@ -57,6 +65,17 @@ typedef struct actlist {
     action	       *list;		/* the array */
 } actlist;
 
+/* A position within a level's packed solution data, from which the
+ * moves can be decoded one at a time (see solution.h). next is the
+ * move at this position, and is only meaningful if more is TRUE.
+ */
+typedef struct solutioncursor {
+    int			offset;		/* where the next byte is decoded */
+    int			packed;		/* moves already taken from it */
+    action		next;		/* the move at the cursor */
+    int			more;		/* FALSE once the moves run out */
+} solutioncursor;
+
 /* The range of relative mouse moves is a 19x19 square around Chip.
  * (Mouse moves are stored as a relative offset in order to fit all
  * possible moves in nine bits.)
@@ -115,6 +134,7 @@ enum {
     CmdQuit,
     CmdPreserve,
     CmdSeek,
+    CmdRewind,
 #ifndef NDEBUG
     CmdCheatNorth,
     CmdCheatWest,
@@ -190,6 +210,7 @@ typedef	struct gamesetup {
     unsigned char      *solutiondata;	/* the player's best solution so far */
     uint32_t		levelhash;	/* the level data's hash value */
     char const	       *unsolvable;	/* why level is unsolvable, or NULL */
+    char		detailsread;	/* TRUE if name, time, hash are set */
     char		name[256];	/* name of the level */
     char		passwd[256];	/* the level's password */
 } gamesetup;
@@ -199,6 +220,8 @@ typedef	struct gamesetup {
 #define	SGF_HASPASSWD		0x0001	/* player knows the level's password */
 #define	SGF_REPLACEABLE		0x0002	/* solution is marked as replaceable */
 #define	SGF_SETNAME		0x0004	/* internal to solution.c */
+#define	SGF_MAPPED		0x0008	/* internal to solution.c */
+#define	SGF_MODIFIED		0x0010	/* not yet saved to disk */
 
 /* The history for the last time a levelset was played.
  */
@@ -219,8 +242,11 @@ typedef	struct gameseries {
     int			gsflags;	/* series flags (see below) */
     gamesetup	       *games;		/* the array of levels */
     fileinfo		mapfile;	/* the file containing the levels */
+    filemapping		datmap;		/* the contents of said file */
     char	       *mapfilename;	/* the name of said file */
     fileinfo		savefile;	/* the file holding the solutions */
+    filemapping		savemap;	/* the contents of said file */
+    filemapping		journalmap;	/* the contents of its journal */
     char	       *savefilename;	/* non-default name for said file */
     int			solheaderflags;	/* solution flags (none defined yet) */
     int			solheadersize;	/* size of extra solution header */
@@ -236,5 +262,8 @@ typedef	struct gameseries {
 #define	GSF_NODEFAULTSAVE	0x0004	/* don't use default tws filename */
 #define	GSF_IGNOREPASSWDS	0x0008	/* don't require passwords */
 #define	GSF_LYNXFIXES		0x0010	/* change MS data into Lynx levels */
+#define	GSF_SAVEFILEREAD	0x0020	/* solution file exists and was read */
+#define	GSF_JOURNALED		0x0040	/* solution file has a journal */
+#define	GSF_JOURNALTORN		0x0080	/* journal ends in a partial record */
 
 #endif
@@ -347,6 +347,7 @@ void getenddisplaysetup(gamestate *state)
     ending.solutiondata = NULL;
     strcpy(ending.name, "CONGRATULATIONS!");
     ending.passwd[0] = '\0';
+    ending.detailsread = TRUE;
 
     state->game = &ending;
     expandmsdatlevel(state);
@@ -6,13 +6,19 @@
 
 #include	<stdlib.h>
 #include	<stdarg.h>
+#include	<pthread.h>
 #include	"oshw.h"
 #include	"err.h"
 
 /* "Hidden" arguments to warn_, errmsg_, and die_.
  */
-char const      *err_cfile_ = NULL;
-unsigned long	err_lineno_ = 0;
+ERR_THREADLOCAL char const     *err_cfile_ = NULL;
+ERR_THREADLOCAL unsigned long	err_lineno_ = 0;
+
+/* Messages may come from more than one thread (see verify.c), so
+ * they are passed on to the user one at a time.
+ */
+static pthread_mutex_t		errlock = PTHREAD_MUTEX_INITIALIZER;
 
 /* Log a warning message.
  */
@@ -21,7 +27,9 @@ void warn_(char const *fmt, ...)
     va_list	args;
 
     va_start(args, fmt);
+    pthread_mutex_lock(&errlock);
     usermessage(NOTIFY_LOG, NULL, err_cfile_, err_lineno_, fmt, args);
+    pthread_mutex_unlock(&errlock);
     va_end(args);
     err_cfile_ = NULL;
     err_lineno_ = 0;
@@ -34,7 +42,9 @@ void errmsg_(char const *prefix, char const *fmt, ...)
     va_list	args;
 
     va_start(args, fmt);
+    pthread_mutex_lock(&errlock);
     usermessage(NOTIFY_ERR, prefix, err_cfile_, err_lineno_, fmt, args);
+    pthread_mutex_unlock(&errlock);
     va_end(args);
     err_cfile_ = NULL;
     err_lineno_ = 0;
@@ -47,7 +57,9 @@ void die_(char const *fmt, ...)
     va_list	args;
 
     va_start(args, fmt);
+    pthread_mutex_lock(&errlock);
     usermessage(NOTIFY_DIE, NULL, err_cfile_, err_lineno_, fmt, args);
+    pthread_mutex_unlock(&errlock);
     va_end(args);
     exit(EXIT_FAILURE);
 }
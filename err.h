@@ -33,10 +33,16 @@ extern void die_(char const *fmt, ...);
 #endif
 
 /* A really ugly hack used to smuggle extra arguments into variadic
- * functions.
+ * functions. Each thread has its own pair, so that threads reporting
+ * errors at the same time cannot swap each other's source locations.
  */
-extern char const      *err_cfile_;
-extern unsigned long	err_lineno_;
+#ifdef _MSC_VER
+#define	ERR_THREADLOCAL	__declspec(thread)
+#else
+#define	ERR_THREADLOCAL	__thread
+#endif
+extern ERR_THREADLOCAL char const      *err_cfile_;
+extern ERR_THREADLOCAL unsigned long	err_lineno_;
 #define	warn	(err_cfile_ = __FILE__, err_lineno_ = __LINE__, warn_)
 #define	errmsg	(err_cfile_ = __FILE__, err_lineno_ = __LINE__, errmsg_)
 #define	die	(err_cfile_ = __FILE__, err_lineno_ = __LINE__, die_)
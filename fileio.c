@@ -11,6 +11,12 @@
 #include	<dirent.h>
 #include	<sys/types.h>
 #include	<sys/stat.h>
+#ifdef WIN32
+#include	<io.h>
+#else
+#include	<unistd.h>
+#include	<sys/mman.h>
+#endif
 #include	"err.h"
 #include	"fileio.h"
 
@@ -78,6 +84,19 @@ int fileexists(char const * name)
     return !stat(name, &buf);
 }
 
+/* Look up the modification time and the size of a file.
+ */
+int getfilestamp(char const *name, unsigned long *mtime, unsigned long *size)
+{
+    struct stat	st;
+
+    if (stat(name, &st) || S_ISDIR(st.st_mode))
+	return FALSE;
+    *mtime = (unsigned long)st.st_mtime;
+    *size = (unsigned long)st.st_size;
+    return TRUE;
+}
+
 /* Open a file. If the fileinfo structure does not already have a
  * filename assigned to it, use name (after making an independent
  * copy).
@@ -209,6 +228,73 @@ void *filereadbuf(fileinfo *file, unsigned long size, char const *msg)
     return buf;
 }
 
+/* Map the contents of the given file into memory, or read them in if
+ * the file cannot be mapped.
+ */
+int filemap(fileinfo *file, filemapping *map, char const *msg)
+{
+    struct stat	st;
+    void       *data;
+
+    map->data = NULL;
+    map->size = 0;
+    map->mapped = FALSE;
+    errno = 0;
+    if (fstat(fileno(file->fp), &st))
+	return fileerr(file, msg);
+    if (st.st_size <= 0)
+	return TRUE;
+    map->size = (unsigned long)st.st_size;
+#ifndef WIN32
+    data = mmap(NULL, map->size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		fileno(file->fp), 0);
+    if (data != MAP_FAILED) {
+	map->data = data;
+	map->mapped = TRUE;
+	return TRUE;
+    }
+#endif
+    if (!filerewind(file, msg) || !(data = filereadbuf(file, map->size, msg))) {
+	map->size = 0;
+	return FALSE;
+    }
+    map->data = data;
+    return TRUE;
+}
+
+/* Release a file's contents made available by filemap().
+ */
+void fileunmap(filemapping *map)
+{
+    if (map->data) {
+#ifndef WIN32
+	if (map->mapped)
+	    munmap(map->data, map->size);
+	else
+#endif
+	    free(map->data);
+    }
+    map->data = NULL;
+    map->size = 0;
+    map->mapped = FALSE;
+}
+
+/* Flush the file's buffer and then the operating system's.
+ */
+int filesync(fileinfo *file, char const *msg)
+{
+    errno = 0;
+    if (fflush(file->fp))
+	return fileerr(file, msg);
+#ifdef WIN32
+    if (_commit(_fileno(file->fp)))
+#else
+    if (fsync(fileno(file->fp)))
+#endif
+	return fileerr(file, msg);
+    return TRUE;
+}
+
 /* Read one full line from fp and store the first len characters,
  * including any trailing newline.
  */
@@ -21,6 +21,12 @@ extern void clearfileinfo(fileinfo *file);
 /* Determine whether a file exists */
 extern int fileexists(char const * name);
 
+/* Look up the modification time and the size of the named file.
+ * FALSE is returned if the file cannot be examined.
+ */
+extern int getfilestamp(char const *name, unsigned long *mtime,
+			unsigned long *size);
+
 /* Open a file. If the fileinfo structure does not already have a
  * filename assigned to it, name will be used as the filename. If msg
  * is NULL, no error will be displayed if the file cannot be opened.
@@ -75,6 +81,25 @@ extern int filewriteint32(fileinfo *file, uint32_t val32,
  */
 extern void *filereadbuf(fileinfo *file, unsigned long size, char const *msg);
 
+/* Make the entire contents of the given open file available in
+ * memory, and store the location and size in map. The file is mapped
+ * into memory where possible, so that it is only read as its pages
+ * are looked at; otherwise it is read into an allocated buffer. Any
+ * changes made to the contents in memory are private, and are never
+ * written back to the file. The file can be closed afterwards without
+ * affecting map.
+ */
+extern int filemap(fileinfo *file, filemapping *map, char const *msg);
+
+/* Release the memory used by a filemap() call, and reset map to empty.
+ */
+extern void fileunmap(filemapping *map);
+
+/* Write out any data buffered for the given file, and wait until it
+ * has reached the disk.
+ */
+extern int filesync(fileinfo *file, char const *msg);
+
 /* Read one full line from fp and store the first len characters,
  * including any trailing newline. len receives the length of the line
  * stored in buf, minus any trailing newline, upon return.
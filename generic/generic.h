@@ -41,6 +41,8 @@ typedef	struct genericglobals
 
     /* Coordinates of the NW corner of the visible part of the map
      * (measured in quarter-tiles), or -1 if no map is currently visible.
+     * Anything that draws over the map view must set this to -1, so
+     * that the next frame of the map view is drawn in full.
      */
     int			mapvieworigin;
 
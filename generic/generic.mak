@@ -17,7 +17,7 @@ endif
 generic.o : generic.c generic.h oshwbind.h
 tile.o    : tile.c generic.h oshwbind.h ../gen.h ../oshw.h ../err.h \
             ../defs.h ../state.h
-timer.o   : timer.c generic.h oshwbind.h ../gen.h ../oshw.h
+timer.o   : timer.c generic.h oshwbind.h ../gen.h ../oshw.h ../phase.h
 
 IN_C_DEPS = generic.h oshwbind.h ../gen.h ../oshw.h ../err.h ../defs.h
 in.o      : in.c $(IN_C_DEPS)
@@ -92,6 +92,7 @@ static keycmdmap const gamekeycmds[] = {
     { 'n',                        0,  0,  0,   CmdNext,               FALSE },
     { TWK_PAGEDOWN,              -1, -1,  0,   CmdNext10,             FALSE },
     { TWK_BACKSPACE,             -1, -1,  0,   CmdPauseGame,          FALSE },
+    { 'b',                        0,  0,  0,   CmdRewind,             FALSE },
 /* TEMP disabling help */
 #ifndef TWPLUSPLUS
     { '?',                       -1, -1,  0,   CmdHelp,               FALSE },
@@ -523,6 +524,7 @@ tablespec const *keyboardhelp(int which)
 	"1-2 4 6 8 (keypad)", "1-also move Chip",
 	"1-Q", "1-quit the current game",
 	"1-Bkspc", "1-pause the game",
+	"1-B", "1-step back one tick (hold to keep going)",
 	"1-Ctrl-R", "1-restart the current level",
 	"1-Ctrl-P", "1-jump to the previous level",
 	"1-Ctrl-N", "1-jump to the next level",
@@ -531,7 +533,7 @@ tablespec const *keyboardhelp(int which)
 	"1-Ctrl-C", "1-exit the program",
 	"1-Alt-F4", "1-exit the program"
     };
-    static tablespec const keyhelp_ingame = { 11, 2, 4, 1, ingame_items };
+    static tablespec const keyhelp_ingame = { 12, 2, 4, 1, ingame_items };
 
     static char const *twixtgame_items[] = {
 	"1-P", "1-jump to the previous level",
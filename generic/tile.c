@@ -207,9 +207,28 @@ static int		surfacesallocated = 0;
  */
 static tilemap		tileptr[NTILES];
 
-/* An internal buffer surface.
+/* The number of composite cell images kept at any one time.
  */
-static TW_Surface      *opaquetile = NULL;
+#define	CELLCACHESIZE	64
+
+/* A composite image of a cell, made from a transparent tile over
+ * another tile, together with the time it was last asked for.
+ */
+typedef	struct cachedcell {
+    TW_Surface	       *image;		/* the composite image */
+    short		top;		/* the id of the upper tile */
+    short		bot;		/* the id of the lower tile */
+    signed char		nt;		/* the cel used for each tile */
+    signed char		nb;
+    unsigned long	lastused;	/* when the image was last used */
+} cachedcell;
+
+/* The recently used composite cell images. The surfaces are on the
+ * heap of remembered surfaces, and are reused once the cache is full.
+ */
+static cachedcell	cellcache[CELLCACHESIZE];
+static int		cellcacheused = 0;
+static unsigned long	cellcacheclock = 0;
 
 /* Add the given surface to the heap of remembered surfaces.
  */
@@ -237,6 +256,15 @@ static void freerememberedsurfaces(void)
     surfacesallocated = 0;
 }
 
+/* Forget all composite cell images. The surfaces themselves are freed
+ * along with the rest of the heap.
+ */
+static void flushcellcache(void)
+{
+    cellcacheused = 0;
+    cellcacheclock = 0;
+}
+
 /* Set the size of one tile. FALSE is returned if the dimensions are
  * invalid.
  */
@@ -249,8 +277,7 @@ static int settilesize(int w, int h)
     geng.wtile = w;
     geng.htile = h;
     geng.cptile = w * h;
-    opaquetile = TW_NewSurface(w, h, FALSE);
-    remembersurface(opaquetile);
+    flushcellcache();
     return TRUE;
 }
 
@@ -323,16 +350,63 @@ static TW_Surface *getcreatureimage(TW_Rect *rect,
     return s;
 }
 
+/* Return a composite image of a cell with the given transparent tile
+ * over the given lower tile, using cels nt and nb respectively. Images
+ * are made as needed and kept in the cache, with the least recently
+ * used image being replaced once the cache is full.
+ */
+static TW_Surface *getcompositeimage(int top, int nt, int bot, int nb)
+{
+    cachedcell	       *cell;
+    int			n;
+
+    ++cellcacheclock;
+    for (n = 0 ; n < cellcacheused ; ++n) {
+	cell = cellcache + n;
+	if (cell->top == top && cell->nt == nt
+			     && cell->bot == bot && cell->nb == nb) {
+	    cell->lastused = cellcacheclock;
+	    return cell->image;
+	}
+    }
+
+    if (cellcacheused < CELLCACHESIZE) {
+	cell = cellcache + cellcacheused++;
+	cell->image = TW_NewSurface(geng.wtile, geng.htile, FALSE);
+	if (!cell->image)
+	    die("%s", TW_GetError());
+	remembersurface(cell->image);
+    } else {
+	cell = cellcache;
+	for (n = 1 ; n < CELLCACHESIZE ; ++n)
+	    if (cellcache[n].lastused < cell->lastused)
+		cell = cellcache + n;
+    }
+    cell->top = top;
+    cell->nt = nt;
+    cell->bot = bot;
+    cell->nb = nb;
+    cell->lastused = cellcacheclock;
+
+    if (tileptr[bot].opaque[nb]) {
+	TW_BlitSurface(tileptr[bot].opaque[nb], NULL, cell->image, NULL);
+    } else {
+	TW_BlitSurface(tileptr[Empty].opaque[0], NULL, cell->image, NULL);
+	addtransparenttile(cell->image, bot, nb);
+    }
+    addtransparenttile(cell->image, top, nt);
+    return cell->image;
+}
+
 /* Return an image of a cell with the given tiles. If the top tile is
- * transparent, the appropriate composite image is constructed in the
- * overlay buffer. (If the top tile is opaque but has transparent
- * pixels, the image returned is constructed in a private surface). If
- * rect is not NULL, the width and height fields are filled in.
+ * transparent, the appropriate composite image is taken from the
+ * cache of composite images. (This is also the case if the top tile
+ * is opaque but has transparent pixels.) If rect is not NULL, the
+ * width and height fields are filled in.
  */
 static TW_Surface *getcellimage(TW_Rect *rect,
 				 int top, int bot, int timerval)
 {
-    TW_Surface	       *dest;
     int			nt, nb;
 
     if (!tileptr[top].celcount)
@@ -347,24 +421,13 @@ static TW_Surface *getcellimage(TW_Rect *rect,
     if (bot == Nothing || bot == Empty || !tileptr[top].transp[0]) {
 	if (tileptr[top].opaque[nt])
 	    return tileptr[top].opaque[nt];
-	TW_BlitSurface(tileptr[Empty].opaque[0], NULL, opaquetile, NULL);
-	addtransparenttile(opaquetile, top, nt);
-	return opaquetile;
+	return getcompositeimage(top, nt, Empty, 0);
     }
 
     if (!tileptr[bot].celcount)
 	die("map element %02X has no suitable image", bot);
     nb = (timerval + 1) % tileptr[bot].celcount;
-    dest = tileptr[Overlay_Buffer].opaque[0];
-    if (tileptr[bot].opaque[nb]) {
-	TW_BlitSurface(tileptr[bot].opaque[nb], NULL, dest, NULL);
-    } else {
-	TW_BlitSurface(tileptr[Empty].opaque[0], NULL, dest, NULL);
-	addtransparenttile(dest, bot, nb);
-    }
-    addtransparenttile(dest, top, nt);
-
-    return dest;
+    return getcompositeimage(top, nt, bot, nb);
 }
 
 /* Get a generic tile image.
@@ -424,20 +487,83 @@ static void drawclippedtile(TW_Rect const *rect, TW_Surface *src,
     }
 }
 
+/* What was drawn in each cell of the map view on the previous frame.
+ * The cells are indexed relative to the top left corner of the view,
+ * with an extra row and column for when the view is partway between
+ * tiles. crsig combines the images and positions of the creatures
+ * drawn over the cell, in the order in which they were drawn.
+ */
+typedef	struct viewcell {
+    unsigned char	top;		/* the upper tile */
+    unsigned char	bot;		/* the lower tile */
+    unsigned char	topframe;	/* the animation frame of each */
+    unsigned char	botframe;
+    unsigned long	crsig;		/* the creatures over the cell */
+} viewcell;
+
+#define	VIEWW		(NXTILES + 1)
+#define	VIEWH		(NYTILES + 1)
+
+/* The contents of the map view as of the previous frame, and where it
+ * was drawn. The previous frame is only used if the map view is still
+ * showing it, which the display code indicates by leaving
+ * geng.mapvieworigin alone.
+ */
+static viewcell		lastview[VIEWW * VIEWH];
+static int		lastxdisppos, lastydisppos;
+static TW_Rect		lastdisplayloc;
+static TW_Surface      *lastscreen = NULL;
+
+/* Return the index of the tile whose pixels include the given offset
+ * from the map origin.
+ */
+static int tileat(int offset, int size)
+{
+    return offset >= 0 ? offset / size : -((size - 1 - offset) / size);
+}
+
+/* Return the intersection of two rectangles. The width or height is
+ * zero if they do not overlap.
+ */
+static TW_Rect cliprect(TW_Rect a, TW_Rect const *b)
+{
+    int	r, t;
+
+    r = a.x + a.w < b->x + b->w ? a.x + a.w : b->x + b->w;
+    t = a.y + a.h < b->y + b->h ? a.y + a.h : b->y + b->h;
+    if (a.x < b->x)
+	a.x = b->x;
+    if (a.y < b->y)
+	a.y = b->y;
+    a.w = r > a.x ? r - a.x : 0;
+    a.h = t > a.y ? t - a.y : 0;
+    return a;
+}
+
 /* Render the view of the visible area of the map to the display, with
  * the view position centered on the display as much as possible. The
  * gamestate's map and the list of creatures are consulted to
- * determine what to render.
+ * determine what to render. If the view has not moved since the
+ * previous frame, only the cells whose tiles, animation frames, or
+ * overlapping creatures have changed are redrawn. Each such cell is
+ * drawn as it would be by a full redraw: the cell image, then every
+ * creature that overlaps it, clipped to the cell.
  */
 static void _displaymapview(gamestate const *state, TW_Rect displayloc)
 {
-    TW_Rect		rect;
+    TW_Rect		rect, cell;
     TW_Surface	       *s;
     creature const     *cr;
+    viewcell		view[VIEWW * VIEWH];
+    unsigned char	dirty[VIEWW * VIEWH];
+    viewcell	       *v;
+    unsigned long	h;
     int			xdisppos, ydisppos;
     int			xorigin, yorigin;
     int			lmap, tmap, rmap, bmap;
-    int			pos, x, y;
+    int			x0, y0, x1, y1;
+    int			timerval, redrawall, any;
+    int			pos, x, y, n;
 
     xdisppos = state->xviewpos / 2 - (NXTILES / 2) * 4;
     ydisppos = state->yviewpos / 2 - (NYTILES / 2) * 4;
@@ -452,45 +578,124 @@ static void _displaymapview(gamestate const *state, TW_Rect displayloc)
     xorigin = displayloc.x - (xdisppos * geng.wtile / 4);
     yorigin = displayloc.y - (ydisppos * geng.htile / 4);
 
+    redrawall = geng.mapvieworigin < 0 || geng.screen != lastscreen
+				       || xdisppos != lastxdisppos
+				       || ydisppos != lastydisppos
+				       || displayloc.x != lastdisplayloc.x
+				       || displayloc.y != lastdisplayloc.y
+				       || displayloc.w != lastdisplayloc.w
+				       || displayloc.h != lastdisplayloc.h;
     geng.mapvieworigin = ydisppos * CXGRID * 4 + xdisppos;
+    lastscreen = geng.screen;
+    lastxdisppos = xdisppos;
+    lastydisppos = ydisppos;
+    lastdisplayloc = displayloc;
 
     lmap = xdisppos / 4;
     tmap = ydisppos / 4;
     rmap = (xdisppos + 3) / 4 + NXTILES;
     bmap = (ydisppos + 3) / 4 + NYTILES;
+    timerval = (state->statusflags & SF_NOANIMATION) ? -1
+						     : state->currenttime;
+
+    memset(view, 0, sizeof view);
+    for (y = tmap ; y < bmap ; ++y) {
+	if (y < 0 || y >= CXGRID)
+	    continue;
+	for (x = lmap ; x < rmap ; ++x) {
+	    if (x < 0 || x >= CXGRID)
+		continue;
+	    pos = y * CXGRID + x;
+	    v = view + (y - tmap) * VIEWW + (x - lmap);
+	    v->top = state->map[pos].top.id;
+	    v->bot = state->map[pos].bot.id;
+	    if (tileptr[v->top].celcount)
+		v->topframe = (timerval + 1) % tileptr[v->top].celcount;
+	    if (tileptr[v->bot].celcount)
+		v->botframe = (timerval + 1) % tileptr[v->bot].celcount;
+	}
+    }
+
+    for (cr = state->creatures ; cr->id ; ++cr) {
+	if (cr->hidden)
+	    continue;
+	x = cr->pos % CXGRID;
+	y = cr->pos / CXGRID;
+	if (x < lmap - 2 || x >= rmap + 2 || y < tmap - 2 || y >= bmap + 2)
+	    continue;
+	rect.x = xorigin + x * geng.wtile;
+	rect.y = yorigin + y * geng.htile;
+	s = getcreatureimage(&rect, cr->id, cr->dir, cr->moving, cr->frame);
+	h = (unsigned long)(size_t)s ^ ((unsigned long)rect.x << 16)
+				     ^ (unsigned long)rect.y;
+	x0 = tileat(rect.x - xorigin, geng.wtile);
+	y0 = tileat(rect.y - yorigin, geng.htile);
+	x1 = tileat(rect.x + rect.w - 1 - xorigin, geng.wtile);
+	y1 = tileat(rect.y + rect.h - 1 - yorigin, geng.htile);
+	for (y = y0 < tmap ? tmap : y0 ; y <= y1 && y < bmap ; ++y) {
+	    for (x = x0 < lmap ? lmap : x0 ; x <= x1 && x < rmap ; ++x) {
+		v = view + (y - tmap) * VIEWW + (x - lmap);
+		v->crsig = v->crsig * 2654435761UL + h + 1;
+	    }
+	}
+    }
+
+    any = FALSE;
+    memset(dirty, 0, sizeof dirty);
     for (y = tmap ; y < bmap ; ++y) {
 	if (y < 0 || y >= CXGRID)
 	    continue;
 	for (x = lmap ; x < rmap ; ++x) {
 	    if (x < 0 || x >= CXGRID)
 		continue;
+	    n = (y - tmap) * VIEWW + (x - lmap);
+	    if (!redrawall && !memcmp(view + n, lastview + n, sizeof *view))
+		continue;
+	    dirty[n] = TRUE;
+	    any = TRUE;
 	    pos = y * CXGRID + x;
 	    rect.x = xorigin + x * geng.wtile;
 	    rect.y = yorigin + y * geng.htile;
 	    s = getcellimage(&rect,
 			     state->map[pos].top.id,
 			     state->map[pos].bot.id,
-			     (state->statusflags & SF_NOANIMATION) ?
-						-1 : state->currenttime);
+			     timerval);
 	    drawclippedtile(&rect, s, displayloc);
 	}
     }
+    memcpy(lastview, view, sizeof lastview);
+    if (!any)
+	return;
 
-    lmap -= 2;
-    tmap -= 2;
-    rmap += 2;
-    bmap += 2;
     for (cr = state->creatures ; cr->id ; ++cr) {
 	if (cr->hidden)
 	    continue;
 	x = cr->pos % CXGRID;
 	y = cr->pos / CXGRID;
-	if (x < lmap || x >= rmap || y < tmap || y >= bmap)
+	if (x < lmap - 2 || x >= rmap + 2 || y < tmap - 2 || y >= bmap + 2)
 	    continue;
 	rect.x = xorigin + x * geng.wtile;
 	rect.y = yorigin + y * geng.htile;
 	s = getcreatureimage(&rect, cr->id, cr->dir, cr->moving, cr->frame);
-	drawclippedtile(&rect, s, displayloc);
+	if (redrawall) {
+	    drawclippedtile(&rect, s, displayloc);
+	    continue;
+	}
+	x0 = tileat(rect.x - xorigin, geng.wtile);
+	y0 = tileat(rect.y - yorigin, geng.htile);
+	x1 = tileat(rect.x + rect.w - 1 - xorigin, geng.wtile);
+	y1 = tileat(rect.y + rect.h - 1 - yorigin, geng.htile);
+	for (y = y0 < tmap ? tmap : y0 ; y <= y1 && y < bmap ; ++y) {
+	    for (x = x0 < lmap ? lmap : x0 ; x <= x1 && x < rmap ; ++x) {
+		if (!dirty[(y - tmap) * VIEWW + (x - lmap)])
+		    continue;
+		cell.x = xorigin + x * geng.wtile;
+		cell.y = yorigin + y * geng.htile;
+		cell.w = geng.wtile;
+		cell.h = geng.htile;
+		drawclippedtile(&rect, s, cliprect(cell, &displayloc));
+	    }
+	}
     }
 }
 
@@ -1131,7 +1336,8 @@ void freetileset(void)
     geng.wtile = 0;
     geng.htile = 0;
     geng.cptile = 0;
-    opaquetile = NULL;
+    geng.mapvieworigin = -1;
+    flushcellcache();
     freerememberedsurfaces();
 }
 
@@ -6,35 +6,144 @@
 
 #include	<stdlib.h>
 #include	<stdio.h>
+#include	<stdint.h>
+#include	<errno.h>
+#include	<time.h>
+#include	<pthread.h>
+#ifndef WIN32
+#include	<unistd.h>
+#endif
 #include	"../gen.h"
 #include	"../oshw.h"
+#include	"../phase.h"
 #include	"generic.h"
 
+/* The system's monotonic clock is used wherever there is one. (If
+ * _POSIX_MONOTONIC_CLOCK is zero, it must still be checked for when
+ * the program runs.) Otherwise the time is taken from TW_GetTicks(),
+ * which only counts milliseconds.
+ */
+#if defined _POSIX_MONOTONIC_CLOCK && _POSIX_MONOTONIC_CLOCK >= 0
+#define	MONOTONIC_CLOCK
+#endif
+
+/* How long before a tick is due to stop sleeping and start watching
+ * the clock instead, in nanoseconds. Sleeping can overshoot, but
+ * watching the clock cannot. This is only done with the monotonic
+ * clock, since watching a clock that counts milliseconds cannot find
+ * the moment any better than sleeping does.
+ */
+#define	SPINTIME	200000
+
 /* By default, a second of game time lasts for 1000 milliseconds of
- * real time.
+ * real time. A tick need not last a whole number of milliseconds (or
+ * even nanoseconds), as the time of each tick is worked out afresh
+ * from the start of the run, and so the rounding never adds up.
  */
-static int	mspertick = 1000 / TICKS_PER_SECOND;
+static uint64_t	nspersecond = 1000000000;
+
+/* TRUE if the monotonic clock is in use.
+ */
+static int	monotonic = FALSE;
 
 /* The tick counter.
  */
 static int	utick = 0;
 
-/* The time of the next tick.
+/* The state of the timer. While it is running, tick number n of the
+ * current run is due at runstart plus n ticks, where runticks is the
+ * number of the next tick to wait for. While it is stopped, pausedleft
+ * holds the time that was left until the next tick, or is negative if
+ * the timer has been reset.
  */
-static int	nexttickat = 0;
+static int	running = FALSE;
+static int64_t	runstart = 0;
+static int	runticks = 0;
+static int64_t	pausedleft = -1;
+
+/* The timer can be started and stopped from one thread while another
+ * is waiting for ticks. The above variables are guarded by this lock.
+ */
+static pthread_mutex_t	timerlock = PTHREAD_MUTEX_INITIALIZER;
 
 /* A histogram of how many milliseconds the program spends sleeping
- * per tick.
+ * per tick, and another of how late each tick is handled, in steps of
+ * ten microseconds. Ticks that are later than the second histogram
+ * reaches are counted in its last entry.
  */
 static int	showhistogram = FALSE;
 static unsigned	hist[100];
+static unsigned	latehist[10000];
+static int64_t	latestever = 0;
+
+/* Return the time, in nanoseconds, on a clock that never goes back.
+ */
+static int64_t readclock(void)
+{
+#ifdef MONOTONIC_CLOCK
+    struct timespec	ts;
+
+    if (monotonic) {
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+#endif
+    return (int64_t)TW_GetTicks() * 1000000;
+}
+
+/* Sleep until the clock reads the given time. With the millisecond
+ * clock, the sleep is rounded up to a whole millisecond.
+ */
+static void sleepuntil(int64_t when)
+{
+    int64_t	ms;
+#ifdef MONOTONIC_CLOCK
+    struct timespec	ts;
+
+    if (monotonic) {
+#if defined _POSIX_CLOCK_SELECTION && _POSIX_CLOCK_SELECTION > 0
+	ts.tv_sec = when / 1000000000;
+	ts.tv_nsec = when % 1000000000;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)
+								    == EINTR) ;
+#else
+	when -= readclock();
+	if (when <= 0)
+	    return;
+	ts.tv_sec = when / 1000000000;
+	ts.tv_nsec = when % 1000000000;
+	while (nanosleep(&ts, &ts) && errno == EINTR) ;
+#endif
+	return;
+    }
+#endif
+    ms = (when - readclock() + 999999) / 1000000;
+    if (ms > 0)
+	TW_Delay((uint32_t)ms);
+}
+
+/* Return the time at which tick number n of the current run is due.
+ * The caller must hold timerlock.
+ */
+static int64_t tickdueat(int n)
+{
+    return runstart + (int64_t)(n * nspersecond / TICKS_PER_SECOND);
+}
 
 /* Set the length (in real time) of a second of game time. A value of
- * zero selects the default length of one second.
+ * zero selects the default length of one second. If the timer is
+ * running, the tick that is already due keeps its time, and the new
+ * length applies to the ticks after it.
  */
 void settimersecond(int ms)
 {
-    mspertick = (ms ? ms : 1000) / TICKS_PER_SECOND;
+    pthread_mutex_lock(&timerlock);
+    if (running) {
+	runstart = tickdueat(runticks);
+	runticks = 0;
+    }
+    nspersecond = (uint64_t)(ms ? ms : 1000) * 1000000;
+    pthread_mutex_unlock(&timerlock);
 }
 
 /* Change the current timer setting. If action is positive, the timer
@@ -45,18 +154,31 @@ void settimersecond(int ms)
  */
 void settimer(int action)
 {
+    int64_t	now;
+
+    pthread_mutex_lock(&timerlock);
+    now = readclock();
     if (action < 0) {
-	nexttickat = 0;
+	running = FALSE;
+	pausedleft = -1;
 	utick = 0;
     } else if (action > 0) {
-	if (nexttickat < 0)
-	    nexttickat = TW_GetTicks() - nexttickat;
+	if (!running && pausedleft >= 0)
+	    runstart = now + pausedleft;
 	else
-	    nexttickat = TW_GetTicks() + mspertick;
+	    runstart = now + (int64_t)(nspersecond / TICKS_PER_SECOND);
+	runticks = 0;
+	running = TRUE;
+	pausedleft = -1;
     } else {
-	if (nexttickat > 0)
-	    nexttickat = TW_GetTicks() - nexttickat;
+	if (running) {
+	    pausedleft = tickdueat(runticks) - now;
+	    if (pausedleft < 0)
+		pausedleft = 0;
+	    running = FALSE;
+	}
     }
+    pthread_mutex_unlock(&timerlock);
 }
 
 /* Return the number of ticks since the timer was last reset.
@@ -66,31 +188,62 @@ int gettickcount(void)
     return (int)utick;
 }
 
+/* Record how late a tick was handled, in nanoseconds.
+ */
+static void recordlateness(int64_t late)
+{
+    int64_t	n;
+
+    if (late > latestever)
+	latestever = late;
+    n = late / 10000;
+    if (n >= (int64_t)(sizeof latehist / sizeof *latehist))
+	n = sizeof latehist / sizeof *latehist - 1;
+    ++latehist[n];
+}
+
 /* Put the program to sleep until the next timer tick. If we've
- * already missed a timer tick, then wait for the next one.
+ * already missed a timer tick, then wait for the next one. With the
+ * monotonic clock, the sleep ends a little early, and the rest of the
+ * time is spent watching the clock, so that the tick is not handled
+ * late.
  */
 int waitfortick(void)
 {
-    int	ms;
+    int64_t	when, now;
+    int		ms;
+
+    pthread_mutex_lock(&timerlock);
+    now = readclock();
+    when = running ? tickdueat(runticks++) : now;
+    pthread_mutex_unlock(&timerlock);
 
-    ms = nexttickat - TW_GetTicks();
+    ms = (int)((when - now) / 1000000);
     if (showhistogram)
 	if (ms < (int)(sizeof hist / sizeof *hist))
-	    ++hist[ms >= 0 ? ms + 1 : 0];
+	    ++hist[when > now ? ms + 1 : 0];
 
-    if (ms <= 0) {
+    if (when <= now) {
+	if (showhistogram)
+	    recordlateness(now - when);
 	++utick;
-	nexttickat += mspertick;
 	return FALSE;
     }
 
-    while (ms < 0)
-	ms += mspertick;
-
-    TW_Delay(ms);
+    if (!monotonic) {
+	sleepuntil(when);
+	now = readclock();
+    } else {
+	if (when - now > SPINTIME)
+	    sleepuntil(when - SPINTIME);
+	do
+	    now = readclock();
+	while (now < when);
+    }
+    if (showhistogram)
+	recordlateness(now > when ? now - when : 0);
 
     ++utick;
-    nexttickat += mspertick;
     return TRUE;
 }
 
@@ -101,6 +254,34 @@ int advancetick(void)
     return ++utick;
 }
 
+/* Move the tick counter to an arbitrary point.
+ */
+void settickcount(int tick)
+{
+    utick = tick;
+}
+
+/* Display the given percentile of the lateness histogram.
+ */
+static void printlateness(char const *label, unsigned long total,
+			  double fraction)
+{
+    unsigned long	count, target;
+    int			i;
+
+    target = (unsigned long)(total * fraction);
+    count = 0;
+    for (i = 0 ; i < (int)(sizeof latehist / sizeof *latehist) - 1 ; ++i) {
+	count += latehist[i];
+	if (count > target)
+	    break;
+    }
+    if (i < (int)(sizeof latehist / sizeof *latehist) - 1)
+	printf("%6s: under %.2f ms\n", label, (i + 1) / 100.0);
+    else
+	printf("%6s: %.2f ms or more\n", label, i / 100.0);
+}
+
 /* At shutdown time, display the histogram data on stdout.
  */
 static void shutdown(void)
@@ -122,6 +303,20 @@ static void shutdown(void)
 		if (hist[i])
 		    printf("%3d: %.1f%%\n", i - 1, (hist[i] * 100.0) / n);
 	}
+	n = 0;
+	for (i = 0 ; i < (int)(sizeof latehist / sizeof *latehist) ; ++i)
+	    n += latehist[i];
+	if (n) {
+	    printf("Lateness of ticks (%lu ticks)\n", n);
+	    printlateness("50%", n, 0.50);
+	    printlateness("90%", n, 0.90);
+	    printlateness("99%", n, 0.99);
+	    printlateness("99.9%", n, 0.999);
+	    printf("%6s: %.3f ms\n", "max", latestever / 1000000.0);
+	}
+#ifdef PHASETIMING
+	printphasetimes();
+#endif
     }
 }
 
@@ -129,6 +324,11 @@ static void shutdown(void)
  */
 int _generictimerinitialize(int _showhistogram)
 {
+#ifdef MONOTONIC_CLOCK
+    struct timespec	ts;
+
+    monotonic = clock_gettime(CLOCK_MONOTONIC, &ts) == 0;
+#endif
     showhistogram = _showhistogram;
     atexit(shutdown);
     settimer(-1);
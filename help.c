@@ -19,7 +19,7 @@
 /* Help for command-line options.
  */
 static char const *yowzitch_items[] = {
-    "1-Usage:", "1!tworld [-hvVdlsbtpqrPFa] [-n N] [-DLRS DIR] "
+    "1-Usage:", "1!tworld [-hvVdlsbtpqrPFa] [-n N] [-j N] [-DLRS DIR] "
 		"[NAME] [SNAME] [LEVEL]",
     "1-   -D", "1!Read data files from DIR instead of the default.",
     "1-   -L", "1!Read level sets from DIR instead of the default.",
@@ -36,6 +36,7 @@ static char const *yowzitch_items[] = {
     "1-   -s", "1!Display scores for the selected data file and exit.",
     "1-   -t", "1!Display times for the selected data file and exit.",
     "1-   -b", "1!Batch-verify solutions for the selected data file and exit.",
+    "1-   -j", "1!Use N threads when batch-verifying solutions.",
     "1-   -h", "1!Display this help and exit.",
     "1-   -d", "1!Display default directories and exit.",
     "1-   -v", "1!Display version number and exit.",
@@ -44,7 +45,7 @@ static char const *yowzitch_items[] = {
     "2!LEVEL specifies which level to start at.",
     "2!SNAME specifies an alternate solution file."
 };
-static tablespec const yowzitch_table = { 23, 2, 2, -1, yowzitch_items };
+static tablespec const yowzitch_table = { 24, 2, 2, -1, yowzitch_items };
 tablespec const *yowzitch = &yowzitch_table;
 
 /* Version and license information.
@@ -8,6 +8,14 @@
 #define	HEADER_logic_h_
 
 #include	"state.h"
+#include	"phase.h"
+
+/* The revision of the game logic. This must be increased whenever a
+ * change to either logic module alters the outcome of any game, so
+ * that results recorded under an earlier revision (see verify.c) are
+ * no longer trusted.
+ */
+#define	LOGIC_REVISION	1
 
 /* Turning macros.
  */
@@ -15,16 +23,43 @@
 #define	back(dir)	((((dir) << 2) | ((dir) >> 2)) & 15)
 #define	right(dir)	((((dir) << 3) | ((dir) >> 1)) & 15)
 
-/* One game logic engine.
+/* One game logic engine. Each call to a startup function creates a
+ * separate instance, with the engine's private data allocated along
+ * with it, so that any number of games can be run independently.
+ * The instance is destroyed by calling its shutdown function.
+ *
+ * savestate writes the part of the game in progress that is kept in
+ * the engine's private data to buf, and returns its size in bytes.
+ * Nothing is written if size is smaller than that. restorestate puts
+ * back state written by savestate during the same level, after the
+ * game state itself has been restored, and returns FALSE if the data
+ * is not of the expected size.
+ *
+ * The state ends with the engine's creatures, stored as creature
+ * structs, one for each slot that the change log numbers them by (see
+ * changes.h), in slot order. savestatehead writes just the part that
+ * comes before them, in the same way as savestate, so that a copy of
+ * the state can be brought up to date from the change log without
+ * writing all of it again.
  */
 typedef	struct gamelogic gamelogic;
 struct gamelogic {
     int		ruleset;		  /* the ruleset */
     gamestate  *state;			  /* ptr to the current game state */
+    uint32_t	rndsequence;		  /* shared sequence for fresh PRNGs */
     int	      (*initgame)(gamelogic*);	  /* prepare to play a game */
     int	      (*advancegame)(gamelogic*); /* advance the game one tick */
     int	      (*endgame)(gamelogic*);	  /* clean up after the game is done */
+    int	      (*savestate)(gamelogic*, void*, int);
+					  /* snapshot the engine's state */
+    int	      (*savestatehead)(gamelogic*, void*, int);
+					  /* snapshot all but the creatures */
+    int	      (*restorestate)(gamelogic*, void const*, int);
+					  /* return to a snapshot */
     void      (*shutdown)(gamelogic*);	  /* turn off the logic engine */
+#ifdef PHASETIMING
+    phasetimes	phases;			  /* time spent in each phase */
+#endif
 };
 
 /* The available game logic engines.
@@ -11,6 +11,8 @@
 #include	"state.h"
 #include	"random.h"
 #include	"logic.h"
+#include	"phase.h"
+#include	"changes.h"
 
 /* A number well above the maximum number of creatures that could possibly
  * exist simultaneously.
@@ -53,72 +55,87 @@ enum {
  */
 int			pedanticmode = FALSE;
 
+/* Everything belonging to one instance of the logic engine. A pointer
+ * to this is passed to every function that needs to look at the game
+ * in progress, so that separate instances never share any state.
+ */
+typedef	struct lxengine {
+    gamelogic		logic;		/* the exported interface */
+    gamestate	       *state;		/* the current game state */
+    int			lastrndslidedir; /* last random slide direction */
+    int			laststepping;	/* last used stepping value */
+    creature		creaturearray[MAX_CREATURES + 1];
+					/* memory for the creature list */
+    uint32_t		slots[MAX_CREATURES / 32 + 1];
+					/* which entries are not hidden */
+    uint32_t		staleslots[MAX_CREATURES / 32 + 1];
+					/* entries hidden since last tick */
+    creature	       *occupant[CXGRID * CYGRID];
+					/* the creature at each location */
+    unsigned short	occupancy[CXGRID * CYGRID];
+					/* number of creatures at each */
+    short		trapwiring[CXGRID * CYGRID];
+					/* the trap for each button */
+    short		clonerwiring[CXGRID * CYGRID];
+					/* the cloner for each button */
+    short		teleports[CXGRID * CYGRID];
+					/* teleports in map order */
+    short		teleportcount;
+    short		teleportsbefore[CXGRID * CYGRID];
+					/* teleports preceding each */
+    short		switchwalls[CXGRID * CYGRID];
+					/* where the toggle walls are */
+    short		switchwallcount;
+} lxengine;
+
 /* Declarations of (indirectly recursive) functions.
  */
-static int canmakemove(creature const *cr, int dir, int flags);
-static int advancecreature(creature *cr, int releasing);
+static int canmakemove(lxengine *lx, creature const *cr, int dir, int flags);
+static int advancecreature(lxengine *lx, creature *cr, int releasing);
 
 /* Used to calculate movement offsets.
  */
 static int const	delta[] = { 0, -CXGRID, -1, 0, +CXGRID, 0, 0, 0, +1 };
 
-/* The direction used the last time something stepped onto a random
- * slide floor.
- */
-static int		lastrndslidedir = NORTH;
-
-/* The most recently used stepping phase value.
- */
-static int		laststepping = 0;
-
-/* The memory used to hold the list of creatures.
- */
-static creature	       *creaturearray = NULL;
-
-/* A pointer to the game state, used so that it doesn't have to be
- * passed to every single function.
- */
-static gamestate       *state;
-
 /*
  * Accessor macros for various fields in the game state. Many of the
  * macros can be used as an lvalue.
  */
 
-#define	setstate(p)		(state = (p)->state)
+#define	getengine(p)		((lxengine*)(p))
 
-#define	creaturelist()		(state->creatures)
+#define	creaturelist()		(lx->state->creatures)
 
 #define	getchip()		(creaturelist())
 #define	chippos()		(getchip()->pos)
 #define	chipisalive()		(getchip()->id == Chip)
 
-#define	mainprng()		(&state->mainprng)
+#define	mainprng()		(&lx->state->mainprng)
 
-#define	timelimit()		(state->timelimit)
-#define	timeoffset()		(state->timeoffset)
-#define	currenttime()		(state->currenttime)
-#define	currentinput()		(state->currentinput)
-#define	lastmove()		(state->lastmove)
-#define	stepping()		(state->stepping)
-#define	rndslidedir()		(state->initrndslidedir)
-#define	xviewpos()		(state->xviewpos)
-#define	yviewpos()		(state->yviewpos)
+#define	timelimit()		(lx->state->timelimit)
+#define	timeoffset()		(lx->state->timeoffset)
+#define	currenttime()		(lx->state->currenttime)
+#define	currentinput()		(lx->state->currentinput)
+#define	lastmove()		(lx->state->lastmove)
+#define	stepping()		(lx->state->stepping)
+#define	rndslidedir()		(lx->state->initrndslidedir)
+#define	xviewpos()		(lx->state->xviewpos)
+#define	yviewpos()		(lx->state->yviewpos)
 
-#define	setnosaving()		(state->statusflags |= SF_NOSAVING)
-#define	showhint()		(state->statusflags |= SF_SHOWHINT)
-#define	hidehint()		(state->statusflags &= ~SF_SHOWHINT)
-#define	markinvalid()		(state->statusflags |= SF_INVALID)
-#define	ismarkedinvalid()	(state->statusflags & SF_INVALID)
+#define	setnosaving()		(lx->state->statusflags |= SF_NOSAVING)
+#define	showhint()		(lx->state->statusflags |= SF_SHOWHINT)
+#define	hidehint()		(lx->state->statusflags &= ~SF_SHOWHINT)
+#define	markinvalid()		(lx->state->statusflags |= SF_INVALID)
+#define	ismarkedinvalid()	(lx->state->statusflags & SF_INVALID)
 
-#define	chipsneeded()		(state->chipsneeded)
+#define	chipsneeded()		(lx->state->chipsneeded)
 
-#define	clonerlist()		(state->cloners)
-#define	clonerlistsize()	(state->clonercount)
-#define	traplist()		(state->traps)
-#define	traplistsize()		(state->trapcount)
+#define	clonerlist()		(lx->state->cloners)
+#define	clonerlistsize()	(lx->state->clonercount)
+#define	traplist()		(lx->state->traps)
+#define	traplistsize()		(lx->state->trapcount)
 
-#define	getlxstate()		(state->lxstate)
+#define	getlxstate()		(lx->state->lxstate)
 
 #define	completed()		(getlxstate().completed)
 #define	togglestate()		(getlxstate().togglestate)
@@ -139,39 +156,44 @@ static gamestate       *state;
 #define	decrendgametimer()	(--getlxstate().endgametimer)
 #define	resetendgametimer()	(getlxstate().endgametimer = 0)
 
-#define	addsoundeffect(sfx)	(state->soundeffects |= 1 << (sfx))
-#define	stopsoundeffect(sfx)	(state->soundeffects &= ~(1 << (sfx)))
+#define	addsoundeffect(sfx)	(lx->state->soundeffects |= 1 << (sfx))
+#define	stopsoundeffect(sfx)	(lx->state->soundeffects &= ~(1 << (sfx)))
+
+#define	changes()		(lx->state->changes)
+#define	cellchanged(pos)	(changes() ? logcellchange(changes(), pos) \
+					   : (void)0)
 
-#define	floorat(pos)		(state->map[pos].top.id)
+#define	floorat(pos)		(lx->state->map[pos].top.id)
+#define	setfloorat(pos, id)	(cellchanged(pos), floorat(pos) = (id))
 
-#define	possession(obj)	(*_possession(obj))
-static short *_possession(int obj)
+#define	possession(obj)	(*_possession(lx, obj))
+static short *_possession(lxengine *lx, int obj)
 {
     switch (obj) {
-      case Key_Red:		return &state->keys[0];
-      case Key_Blue:		return &state->keys[1];
-      case Key_Yellow:		return &state->keys[2];
-      case Key_Green:		return &state->keys[3];
-      case Boots_Ice:		return &state->boots[0];
-      case Boots_Slide:		return &state->boots[1];
-      case Boots_Fire:		return &state->boots[2];
-      case Boots_Water:		return &state->boots[3];
-      case Door_Red:		return &state->keys[0];
-      case Door_Blue:		return &state->keys[1];
-      case Door_Yellow:		return &state->keys[2];
-      case Door_Green:		return &state->keys[3];
-      case Ice:			return &state->boots[0];
-      case IceWall_Northwest:	return &state->boots[0];
-      case IceWall_Northeast:	return &state->boots[0];
-      case IceWall_Southwest:	return &state->boots[0];
-      case IceWall_Southeast:	return &state->boots[0];
-      case Slide_North:		return &state->boots[1];
-      case Slide_West:		return &state->boots[1];
-      case Slide_South:		return &state->boots[1];
-      case Slide_East:		return &state->boots[1];
-      case Slide_Random:	return &state->boots[1];
-      case Fire:		return &state->boots[2];
-      case Water:		return &state->boots[3];
+      case Key_Red:		return &lx->state->keys[0];
+      case Key_Blue:		return &lx->state->keys[1];
+      case Key_Yellow:		return &lx->state->keys[2];
+      case Key_Green:		return &lx->state->keys[3];
+      case Boots_Ice:		return &lx->state->boots[0];
+      case Boots_Slide:		return &lx->state->boots[1];
+      case Boots_Fire:		return &lx->state->boots[2];
+      case Boots_Water:		return &lx->state->boots[3];
+      case Door_Red:		return &lx->state->keys[0];
+      case Door_Blue:		return &lx->state->keys[1];
+      case Door_Yellow:		return &lx->state->keys[2];
+      case Door_Green:		return &lx->state->keys[3];
+      case Ice:			return &lx->state->boots[0];
+      case IceWall_Northwest:	return &lx->state->boots[0];
+      case IceWall_Northeast:	return &lx->state->boots[0];
+      case IceWall_Southwest:	return &lx->state->boots[0];
+      case IceWall_Southeast:	return &lx->state->boots[0];
+      case Slide_North:		return &lx->state->boots[1];
+      case Slide_West:		return &lx->state->boots[1];
+      case Slide_South:		return &lx->state->boots[1];
+      case Slide_East:		return &lx->state->boots[1];
+      case Slide_Random:	return &lx->state->boots[1];
+      case Fire:		return &lx->state->boots[2];
+      case Water:		return &lx->state->boots[3];
     }
     warn("Invalid object %d handed to possession()\n", obj);
     _assert(!"possession() called with an invalid object");
@@ -181,7 +203,7 @@ static short *_possession(int obj)
 /* The pseudorandom number generator, used by walkers and blobs. This
  * exactly matches the PRNG used in the original Lynx game.
  */
-static unsigned char lynx_prng(void)
+static unsigned char lynx_prng(lxengine *lx)
 {
     unsigned char n;
 
@@ -204,18 +226,22 @@ static unsigned char lynx_prng(void)
 
 /* Accessor macros for the floor states.
  */
-#define	claimlocation(pos)	(state->map[pos].top.state |= FS_CLAIMED)
-#define	removeclaim(pos)	(state->map[pos].top.state &= ~FS_CLAIMED)
-#define	islocationclaimed(pos)	(state->map[pos].top.state & FS_CLAIMED)
-#define	markanimated(pos)	(state->map[pos].top.state |= FS_ANIMATED)
-#define	clearanimated(pos)	(state->map[pos].top.state &= ~FS_ANIMATED)
-#define	ismarkedanimated(pos)	(state->map[pos].top.state & FS_ANIMATED)
+#define	claimlocation(pos)	(cellchanged(pos), \
+				 lx->state->map[pos].top.state |= FS_CLAIMED)
+#define	removeclaim(pos)	(cellchanged(pos), \
+				 lx->state->map[pos].top.state &= ~FS_CLAIMED)
+#define	islocationclaimed(pos)	(lx->state->map[pos].top.state & FS_CLAIMED)
+#define	markanimated(pos)	(cellchanged(pos), \
+				 lx->state->map[pos].top.state |= FS_ANIMATED)
+#define	clearanimated(pos)	(cellchanged(pos), \
+				 lx->state->map[pos].top.state &= ~FS_ANIMATED)
+#define	ismarkedanimated(pos)	(lx->state->map[pos].top.state & FS_ANIMATED)
 
 /* Translate a slide floor into the direction it points in. In the
  * case of a random slide floor, if advance is TRUE a new direction
  * shall be selected; otherwise the current direction is used.
  */
-static int getslidedir(int floor, int advance)
+static int getslidedir(lxengine *lx, int floor, int advance)
 {
     switch (floor) {
       case Slide_North:		return NORTH;
@@ -224,8 +250,8 @@ static int getslidedir(int floor, int advance)
       case Slide_East:		return EAST;
       case Slide_Random:
 	if (advance)
-	    lastrndslidedir = right(lastrndslidedir);
-	return lastrndslidedir;
+	    lx->lastrndslidedir = right(lx->lastrndslidedir);
+	return lx->lastrndslidedir;
     }
     warn("Invalid floor %d handed to getslidedir()\n", floor);
     _assert(!"getslidedir() called with an invalid object");
@@ -234,7 +260,7 @@ static int getslidedir(int floor, int advance)
 
 /* Alter a creature's direction if they are at an ice wall.
  */
-static void applyicewallturn(creature *cr)
+static void applyicewallturn(lxengine *lx, creature *cr)
 {
     int	floor, dir;
 
@@ -259,61 +285,89 @@ static void applyicewallturn(creature *cr)
 
 /* Find the location of a beartrap from one of its buttons.
  */
-static int trapfrombutton(int pos)
+static int trapfrombutton(lxengine *lx, int pos)
 {
-    xyconn     *xy;
-    int		i;
+    if (pos < 0 || pos >= CXGRID * CYGRID)
+	return -1;
+    return lx->trapwiring[pos];
+}
 
-    if (pedanticmode) {
-	i = pos;
-	for (;;) {
-	    ++i;
-	    if (i == CXGRID * CYGRID)
-		i = 0;
-	    if (i == pos)
-		break;
-	    if (floorat(i) == Beartrap)
-		return i;
+/* Find the location of a clone machine from one of its buttons.
+ */
+static int clonerfrombutton(lxengine *lx, int pos)
+{
+    if (pos < 0 || pos >= CXGRID * CYGRID)
+	return -1;
+    return lx->clonerwiring[pos];
+}
+
+/* Fill in table with the location of the next tile with the given id
+ * after each location, wrapping around at the end of the map. This
+ * is how buttons find what they are connected to in pedantic mode.
+ */
+static void findnexttiles(lxengine *lx, short *table, int id)
+{
+    int	next, pos, n;
+
+    next = -1;
+    for (n = 0 ; n < 2 ; ++n) {
+	for (pos = CXGRID * CYGRID - 1 ; pos >= 0 ; --pos) {
+	    table[pos] = next == pos ? -1 : next;
+	    if (floorat(pos) == id)
+		next = pos;
 	}
-    } else {
-	for (xy = traplist(), i = traplistsize() ; i ; ++xy, --i)
-	    if (xy->from == pos)
-		return xy->to;
     }
-    return -1;
 }
 
-/* Find the location of a clone machine from one of its buttons.
+/* Draw up the tables that map each button to what it is wired to,
+ * the list of teleports in the order they are searched, and the list
+ * of toggle walls. Neither the wirings nor the beartraps, clone
+ * machines, teleports and toggle walls on the map ever change once
+ * the level begins (apart from the toggling), so the tables stay
+ * valid for the entire game. Where a button appears more than once
+ * in a list, only its first wiring is used, as before.
  */
-static int clonerfrombutton(int pos)
+static void buildwiring(lxengine *lx)
 {
     xyconn     *xy;
-    int		i;
+    int		pos, n;
 
     if (pedanticmode) {
-	i = pos;
-	for (;;) {
-	    ++i;
-	    if (i == CXGRID * CYGRID)
-		i = 0;
-	    if (i == pos)
-		break;
-	    if (floorat(i) == CloneMachine)
-		return i;
-	}
+	findnexttiles(lx, lx->trapwiring, Beartrap);
+	findnexttiles(lx, lx->clonerwiring, CloneMachine);
     } else {
-	for (xy = clonerlist(), i = clonerlistsize() ; i ; ++xy, --i)
-	    if (xy->from == pos)
-		return xy->to;
+	for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos) {
+	    lx->trapwiring[pos] = -1;
+	    lx->clonerwiring[pos] = -1;
+	}
+	for (n = traplistsize() - 1, xy = traplist() + n ; n >= 0 ;
+							   --n, --xy)
+	    if (xy->from >= 0 && xy->from < CXGRID * CYGRID)
+		lx->trapwiring[xy->from] = xy->to;
+	for (n = clonerlistsize() - 1, xy = clonerlist() + n ; n >= 0 ;
+							     --n, --xy)
+	    if (xy->from >= 0 && xy->from < CXGRID * CYGRID)
+		lx->clonerwiring[xy->from] = xy->to;
     }
-    return -1;
+
+    lx->teleportcount = 0;
+    for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos) {
+	lx->teleportsbefore[pos] = lx->teleportcount;
+	if (floorat(pos) == Teleport)
+	    lx->teleports[lx->teleportcount++] = pos;
+    }
+
+    lx->switchwallcount = 0;
+    for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos)
+	if (floorat(pos) == SwitchWall_Open || floorat(pos) == SwitchWall_Closed)
+	    lx->switchwalls[lx->switchwallcount++] = pos;
 }
 
 /* Quell any continuous sound effects coming from what Chip is
  * standing on. If includepushing is TRUE, also quell the sound of any
  * blocks being pushed.
  */
-static void resetfloorsounds(int includepushing)
+static void resetfloorsounds(lxengine *lx, int includepushing)
 {
     stopsoundeffect(SND_SKATING_FORWARD);
     stopsoundeffect(SND_SKATING_TURN);
@@ -342,33 +396,221 @@ static void resetfloorsounds(int includepushing)
 #define	setfdir(cr, d)	((cr)->state = ((cr)->state & ~CS_FDIRMASK) \
 				     | ((d) & CS_FDIRMASK))
 
+/* The occupancy index records which creatures, other than Chip, are
+ * visible at each location on the map. Every change to a creature's
+ * position, visibility, or identity is bracketed by a call to
+ * vacate() and a call to occupy(), so that the index always agrees
+ * with the creature list. When more than one creature shares a
+ * location, the index only keeps the count, and the creature list is
+ * searched as before.
+ */
+#define	isoccupant(cr)	((cr) != creaturelist() && (cr)->id		\
+				&& !(cr)->hidden && !isanimation((cr)->id) \
+				&& (cr)->pos >= 0			\
+				&& (cr)->pos < CXGRID * CYGRID)
+
+/* Add the given creature to the occupancy index.
+ */
+static void occupy(lxengine *lx, creature *cr)
+{
+    if (!isoccupant(cr))
+	return;
+    lx->occupant[cr->pos] = lx->occupancy[cr->pos]++ ? NULL : cr;
+}
+
+/* Remove the given creature from the occupancy index.
+ */
+static void vacate(lxengine *lx, creature *cr)
+{
+    if (!isoccupant(cr))
+	return;
+    _assert(lx->occupancy[cr->pos] > 0);
+    --lx->occupancy[cr->pos];
+    lx->occupant[cr->pos] = NULL;
+}
+
+/* Rebuild the occupancy index from the creature list.
+ */
+static void buildoccupancy(lxengine *lx)
+{
+    creature   *cr;
+
+    memset(lx->occupant, 0, sizeof lx->occupant);
+    memset(lx->occupancy, 0, sizeof lx->occupancy);
+    for (cr = creaturelist() + 1 ; cr->id ; ++cr)
+	occupy(lx, cr);
+}
+
 /* Return the creature located at pos. Ignores Chip unless includechip
  * is TRUE. (This is important in the case when Chip and a second
  * creature are currently occupying a single location.)
  */
-static creature *lookupcreature(int pos, int includechip)
+static creature *lookupcreature(lxengine *lx, int pos, int includechip)
 {
     creature   *cr;
 
     cr = creaturelist();
-    if (!includechip)
-	++cr;
-    for ( ; cr->id ; ++cr)
+    if (includechip) {
+	if (!cr->id)
+	    return NULL;
 	if (cr->pos == pos && !cr->hidden && !isanimation(cr->id))
 	    return cr;
-    return NULL;
+    }
+    ++cr;
+    if (pos >= 0 && pos < CXGRID * CYGRID) {
+	if (!lx->occupancy[pos])
+	    return NULL;
+	if (lx->occupant[pos])
+	    return lx->occupant[pos];
+    }
+    for ( ; cr->id ; ++cr)
+	if (cr->pos == pos && !cr->hidden && !isanimation(cr->id))
+	    break;
+    if (!cr->id)
+	return NULL;
+    if (pos >= 0 && pos < CXGRID * CYGRID && lx->occupancy[pos] == 1)
+	lx->occupant[pos] = cr;
+    return cr;
+}
+
+/* Which entries in the creature list are not hidden is recorded in a
+ * bitmap. Every change to a creature's hidden flag is followed by a
+ * call to updateslot(), so that the map always agrees with the list.
+ * The passes over the creature list use it to skip the hidden entries
+ * (dead creatures, finished animations, failed clones) without
+ * looking at them, and newcreature() uses it to find the first unused
+ * entry. Since the map is consulted afresh at every step, a pass
+ * visits exactly the same entries, in the same order, that it would
+ * by examining each entry in turn, even when entries are reused
+ * partway through the pass. A second bitmap remembers which entries
+ * have been hidden since the last tick began, since the first pass of
+ * each tick clears the pending moves of hidden entries too.
+ */
+#define	slotnum(cr)	((int)((cr) - creaturelist()))
+
+/* Return the index of the first bit at or after n and no later than
+ * last that is set in map (or clear, if flip is all ones), or -1 if
+ * there is none.
+ */
+static int nextbit(uint32_t const *map, uint32_t flip, int n, int last)
+{
+    uint32_t	bits;
+
+    for ( ; n <= last ; n = (n | 31) + 1) {
+	bits = (map[n / 32] ^ flip) >> (n % 32);
+	if (bits) {
+	    for ( ; !(bits & 1) ; bits >>= 1)
+		++n;
+	    return n <= last ? n : -1;
+	}
+    }
+    return -1;
+}
+
+/* Return the index of the last bit at or before n that is set in map,
+ * or -1 if there is none.
+ */
+static int prevbit(uint32_t const *map, int n)
+{
+    uint32_t	bits;
+
+    for ( ; n >= 0 ; n = (n & ~31) - 1) {
+	bits = map[n / 32] << (31 - n % 32);
+	if (bits) {
+	    for ( ; !(bits & 0x80000000UL) ; bits <<= 1)
+		--n;
+	    return n;
+	}
+    }
+    return -1;
 }
 
-/* Return a fresh creature.
+/* Bring the bitmaps up to date with the given creature's hidden flag.
  */
-static creature *newcreature(void)
+static void updateslot(lxengine *lx, creature const *cr)
+{
+    int	n = slotnum(cr);
+
+    if (cr->hidden) {
+	lx->slots[n / 32] &= ~((uint32_t)1 << (n % 32));
+	lx->staleslots[n / 32] |= (uint32_t)1 << (n % 32);
+    } else {
+	lx->slots[n / 32] |= (uint32_t)1 << (n % 32);
+    }
+}
+
+/* Recreate the bitmaps from the creature list.
+ */
+static void buildslots(lxengine *lx)
 {
     creature   *cr;
 
-    for (cr = creaturelist() + 1 ; cr->id ; ++cr) {
-	if (cr->hidden)
-	    return cr;
+    memset(lx->slots, 0, sizeof lx->slots);
+    memset(lx->staleslots, 0, sizeof lx->staleslots);
+    for (cr = creaturelist() ; cr <= creaturelistend() ; ++cr)
+	updateslot(lx, cr);
+}
+
+/* Return the entry in the creature list following cr that is not
+ * hidden, or NULL if there are none. If cr is NULL, the search starts
+ * at the beginning of the list. (As with a search that stops at the
+ * end marker, nothing is found if Chip's entry is the end marker.)
+ */
+static creature *nextcreature(lxengine *lx, creature *cr)
+{
+    int	n;
+
+    if (!creaturelist()->id)
+	return NULL;
+    n = nextbit(lx->slots, 0, cr ? slotnum(cr) + 1 : 0,
+		slotnum(creaturelistend()));
+    return n < 0 ? NULL : creaturelist() + n;
+}
+
+/* Return the entry in the creature list preceding cr that is not
+ * hidden, or NULL if there are none. If cr is NULL, the search starts
+ * at the end of the list.
+ */
+static creature *prevcreature(lxengine *lx, creature *cr)
+{
+    int	n;
+
+    n = prevbit(lx->slots, cr ? slotnum(cr) - 1 : slotnum(creaturelistend()));
+    return n < 0 ? NULL : creaturelist() + n;
+}
+
+/* Clear the pending moves of the entries that have been hidden since
+ * the last time this was done.
+ */
+static void clearstaleslots(lxengine *lx)
+{
+    creature   *cr;
+    int		n;
+
+    for (n = nextbit(lx->staleslots, 0, 0, slotnum(creaturelistend())) ;
+	 n >= 0 ;
+	 n = nextbit(lx->staleslots, 0, n + 1, slotnum(creaturelistend()))) {
+	cr = creaturelist() + n;
+	if (cr->hidden) {
+	    setfdir(cr, NIL);
+	    cr->tdir = NIL;
+	}
     }
+    memset(lx->staleslots, 0, sizeof lx->staleslots);
+}
+
+/* Return a fresh creature. The first hidden entry in the list is
+ * reused if there is one; otherwise the list is lengthened.
+ */
+static creature *newcreature(lxengine *lx)
+{
+    creature   *cr;
+    int		n;
+
+    n = nextbit(lx->slots, ~(uint32_t)0, 1, slotnum(creaturelistend()));
+    if (n >= 0)
+	return creaturelist() + n;
+    cr = creaturelistend() + 1;
     if (cr - creaturelist() >= MAX_CREATURES) {
 	warn("Ran out of room in the creatures array!");
 	return NULL;
@@ -377,6 +619,7 @@ static creature *newcreature(void)
 	return NULL;
 
     cr->hidden = TRUE;
+    updateslot(lx, cr);
     cr[1].id = Nothing;
     creaturelistend() = cr;
     return cr;
@@ -384,13 +627,11 @@ static creature *newcreature(void)
 
 /* Flag all tanks to turn around.
  */
-static void turntanks(void)
+static void turntanks(lxengine *lx)
 {
     creature   *cr;
 
-    for (cr = creaturelist() ; cr->id ; ++cr) {
-	if (cr->hidden)
-	    continue;
+    for (cr = nextcreature(lx, NULL) ; cr ; cr = nextcreature(lx, cr)) {
 	if (cr->id != Tank)
 	    continue;
 	if (floorat(cr->pos) == CloneMachine || isice(floorat(cr->pos)))
@@ -403,8 +644,9 @@ static void turntanks(void)
  * given creature. The creature's slot in the creature list is reused
  * by the animation sequence.
  */
-static void removecreature(creature *cr, int animationid)
+static void removecreature(lxengine *lx, creature *cr, int animationid)
 {
+    vacate(lx, cr);
     if (cr->id != Chip)
 	removeclaim(cr->pos);
     if (cr->state & CS_PUSHED)
@@ -413,6 +655,7 @@ static void removecreature(creature *cr, int animationid)
     cr->frame = ((currenttime() + stepping()) & 1) ? 12 : 11;
     --cr->frame;
     cr->hidden = FALSE;
+    updateslot(lx, cr);
     cr->state = 0;
     cr->tdir = NIL;
     if (cr->moving == 8) {
@@ -425,9 +668,10 @@ static void removecreature(creature *cr, int animationid)
 /* End the given animation sequence (thus removing the final vestige
  * of an ex-creature).
  */
-static void removeanimation(creature *cr)
+static void removeanimation(lxengine *lx, creature *cr)
 {
     cr->hidden = TRUE;
+    updateslot(lx, cr);
     clearanimated(cr->pos);
     if (cr == creaturelistend()) {
 	cr->id = Nothing;
@@ -437,13 +681,14 @@ static void removeanimation(creature *cr)
 
 /* Abort the animation sequence occuring at the given location.
  */
-static int stopanimationat(int pos)
+static int stopanimationat(lxengine *lx, int pos)
 {
     creature   *anim;
 
-    for (anim = creaturelist() ; anim->id ; ++anim) {
-	if (!anim->hidden && anim->pos == pos && isanimation(anim->id)) {
-	    removeanimation(anim);
+    for (anim = nextcreature(lx, NULL) ; anim ;
+					 anim = nextcreature(lx, anim)) {
+	if (anim->pos == pos && isanimation(anim->id)) {
+	    removeanimation(lx, anim);
 	    return TRUE;
 	}
     }
@@ -453,35 +698,35 @@ static int stopanimationat(int pos)
 /* What happens when Chip dies. reason indicates the cause of death.
  * also is either NULL or points to a creature that dies with Chip.
  */
-static void removechip(int reason, creature *also)
+static void removechip(lxengine *lx, int reason, creature *also)
 {
     creature  *chip = getchip();
 
     switch (reason) {
       case CHIP_DROWNED:
 	addsoundeffect(SND_WATER_SPLASH);
-	removecreature(chip, Water_Splash);
+	removecreature(lx, chip, Water_Splash);
 	break;
       case CHIP_BOMBED:
 	addsoundeffect(SND_BOMB_EXPLODES);
-	removecreature(chip, Bomb_Explosion);
+	removecreature(lx, chip, Bomb_Explosion);
 	break;
       case CHIP_OUTOFTIME:
-	removecreature(chip, Entity_Explosion);
+	removecreature(lx, chip, Entity_Explosion);
 	break;
       case CHIP_BURNED:
 	addsoundeffect(SND_CHIP_LOSES);
-	removecreature(chip, Entity_Explosion);
+	removecreature(lx, chip, Entity_Explosion);
 	break;
       case CHIP_COLLIDED:
 	addsoundeffect(SND_CHIP_LOSES);
-	removecreature(chip, Entity_Explosion);
+	removecreature(lx, chip, Entity_Explosion);
 	if (also && also != chip)
-	    removecreature(also, Entity_Explosion);
+	    removecreature(lx, also, Entity_Explosion);
 	break;
     }
 
-    resetfloorsounds(FALSE);
+    resetfloorsounds(lx, FALSE);
     startendgametimer();
     timeoffset() = 1;
 }
@@ -682,13 +927,13 @@ static struct { unsigned char chip, block, creature; } const movelaws[] = {
  * direction. If flags includes CMM_PUSHBLOCKSNOW, then the indicated
  * movement of the block will be initiated.
  */
-static int canpushblock(creature *block, int dir, int flags)
+static int canpushblock(lxengine *lx, creature *block, int dir, int flags)
 {
     _assert(block && block->id == Block);
     _assert(floorat(block->pos) != CloneMachine);
     _assert(dir != NIL);
 
-    if (!canmakemove(block, dir, flags)) {
+    if (!canmakemove(lx, block, dir, flags)) {
 	if (!block->moving && (flags & (CMM_PUSHBLOCKS | CMM_PUSHBLOCKSNOW)))
 	    block->dir = dir;
 	return FALSE;
@@ -698,7 +943,7 @@ static int canpushblock(creature *block, int dir, int flags)
 	block->tdir = dir;
 	block->state |= CS_PUSHED;
 	if (flags & CMM_PUSHBLOCKSNOW)
-	    advancecreature(block, FALSE);
+	    advancecreature(lx, block, FALSE);
     }
 
     return TRUE;
@@ -708,7 +953,7 @@ static int canpushblock(creature *block, int dir, int flags)
  * the given direction. Side effects can and will occur from calling
  * this function, as indicated by flags.
  */
-static int canmakemove(creature const *cr, int dir, int flags)
+static int canmakemove(lxengine *lx, creature const *cr, int dir, int flags)
 {
     creature   *other;
     int		leavingmap = FALSE;
@@ -739,7 +984,7 @@ static int canmakemove(creature const *cr, int dir, int flags)
 	return FALSE;
 
     if (isslide(floorfrom) && (cr->id != Chip || !possession(Boots_Slide)))
-	if (getslidedir(floorfrom, FALSE) == back(dir))
+	if (getslidedir(lx, floorfrom, FALSE) == back(dir))
 	    return FALSE;
 
     if (floorto == SwitchWall_Open || floorto == SwitchWall_Closed)
@@ -760,14 +1005,14 @@ static int canmakemove(creature const *cr, int dir, int flags)
 	    return FALSE;
 	if (ismarkedanimated(to))
 	    return FALSE;
-	other = lookupcreature(to, FALSE);
+	other = lookupcreature(lx, to, FALSE);
 	if (other && other->id == Block) {
-	    if (!canpushblock(other, dir, flags & ~CMM_RELEASING))
+	    if (!canpushblock(lx, other, dir, flags & ~CMM_RELEASING))
 		return FALSE;
 	}
 	if (floorto == HiddenWall_Temp || floorto == BlueWall_Real) {
 	    if (flags & CMM_STARTMOVEMENT)
-		floorat(to) = Wall;
+		setfloorat(to, Wall);
 	    return FALSE;
 	}
     } else if (cr->id == Block) {
@@ -785,7 +1030,7 @@ static int canmakemove(creature const *cr, int dir, int flags)
 	    return FALSE;
 	if (flags & CMM_CLEARANIMATIONS)
 	    if (ismarkedanimated(to))
-		stopanimationat(to);
+		stopanimationat(lx, to);
     } else {
 	if (!(movelaws[floorfrom].creature & DIR_OUT(dir)))
 	    return FALSE;
@@ -801,7 +1046,7 @@ static int canmakemove(creature const *cr, int dir, int flags)
 	    return FALSE;
 	if (flags & CMM_CLEARANIMATIONS)
 	    if (ismarkedanimated(to))
-		stopanimationat(to);
+		stopanimationat(lx, to);
     }
 
     return TRUE;
@@ -815,7 +1060,7 @@ static int canmakemove(creature const *cr, int dir, int flags)
  * Given a creature, this function enumerates its desired direction
  * of movement and selects the first one that is permitted.
  */
-static void choosecreaturemove(creature *cr)
+static void choosecreaturemove(lxengine *lx, creature *cr)
 {
     int		choices[4] = { NIL, NIL, NIL, NIL };
     int		dir, pdir;
@@ -906,7 +1151,7 @@ static void choosecreaturemove(creature *cr)
 
     for (n = 0 ; n < 4 && choices[n] != NIL ; ++n) {
 	if (choices[n] == WALKER_TURN) {
-	    m = lynx_prng() & 3;
+	    m = lynx_prng(lx) & 3;
 	    choices[n] = cr->dir;
 	    while (m--)
 		choices[n] = right(choices[n]);
@@ -915,7 +1160,7 @@ static void choosecreaturemove(creature *cr)
 	    choices[n] = cw[random4(mainprng())];
 	}
 	cr->tdir = choices[n];
-	if (canmakemove(cr, choices[n], CMM_CLEARANIMATIONS))
+	if (canmakemove(lx, cr, choices[n], CMM_CLEARANIMATIONS))
 	    return;
     }
 
@@ -927,7 +1172,7 @@ static void choosecreaturemove(creature *cr)
  * then Chip is not currently permitted to select a direction of
  * movement, and the player's input should not be retained.
  */
-static void choosechipmove(creature *cr, int discard)
+static void choosechipmove(lxengine *lx, creature *cr, int discard)
 {
     int	dir;
     int	f1, f2;
@@ -956,18 +1201,18 @@ static void choosechipmove(creature *cr, int discard)
 
     if (isdiagonal(dir)) {
 	if (cr->dir & dir) {
-	    f1 = canmakemove(cr, cr->dir, CMM_PUSHBLOCKS);
-	    f2 = canmakemove(cr, cr->dir ^ dir, CMM_PUSHBLOCKS);
+	    f1 = canmakemove(lx, cr, cr->dir, CMM_PUSHBLOCKS);
+	    f2 = canmakemove(lx, cr, cr->dir ^ dir, CMM_PUSHBLOCKS);
 	    dir = !f1 && f2 ? dir ^ cr->dir : cr->dir;
 	} else {
-	    if (canmakemove(cr, dir & (EAST | WEST), CMM_PUSHBLOCKS))
+	    if (canmakemove(lx, cr, dir & (EAST | WEST), CMM_PUSHBLOCKS))
 		dir &= EAST | WEST;
 	    else
 		dir &= NORTH | SOUTH;
 	}
 	cr->tdir = dir;
     } else {
-	(void)canmakemove(cr, dir, CMM_PUSHBLOCKS);
+	(void)canmakemove(lx, cr, dir, CMM_PUSHBLOCKS);
     }
 }
 
@@ -979,7 +1224,7 @@ static void choosechipmove(creature *cr, int discard)
  * creature's fdir field, and TRUE is returned unless the creature can
  * override the forced move.
  */
-static int getforcedmove(creature *cr)
+static int getforcedmove(lxengine *lx, creature *cr)
 {
     int	floor;
 
@@ -1000,7 +1245,7 @@ static int getforcedmove(creature *cr)
     } else if (isslide(floor)) {
 	if (cr->id == Chip && possession(Boots_Slide))
 	    return FALSE;
-	setfdir(cr, getslidedir(floor, TRUE));
+	setfdir(cr, getslidedir(lx, floor, TRUE));
 	return !(cr->state & CS_SLIDETOKEN);
     } else if (cr->state & CS_TELEPORTED) {
 	cr->state &= ~CS_TELEPORTED;
@@ -1013,17 +1258,17 @@ static int getforcedmove(creature *cr)
 
 /* Return the move a creature will make on the current tick.
  */
-static int choosemove(creature *cr)
+static int choosemove(lxengine *lx, creature *cr)
 {
     if (cr->id == Chip) {
-	choosechipmove(cr, getforcedmove(cr));
+	choosechipmove(lx, cr, getforcedmove(lx, cr));
 	if (cr->tdir == NIL && getfdir(cr) == NIL)
-	    resetfloorsounds(FALSE);
+	    resetfloorsounds(lx, FALSE);
     } else {
-	if (getforcedmove(cr))
+	if (getforcedmove(lx, cr))
 	    cr->tdir = NIL;
 	else
-	    choosecreaturemove(cr);
+	    choosecreaturemove(lx, cr);
     }
 
     return cr->tdir != NIL || getfdir(cr) != NIL;
@@ -1032,7 +1277,7 @@ static int choosemove(creature *cr)
 /* Update the location that Chip is currently moving into (and reset
  * the pointer to the creature that Chip is colliding with).
  */
-static void checkmovingto(void)
+static void checkmovingto(lxengine *lx)
 {
     creature   *cr;
     int		dir;
@@ -1056,31 +1301,32 @@ static void checkmovingto(void)
 /* Teleport the given creature instantaneously from one teleport tile
  * to another.
  */
-static int teleportcreature(creature *cr)
+static int teleportcreature(lxengine *lx, creature *cr)
 {
-    int pos, origpos;
+    int pos, origpos, i;
 
     _assert(floorat(cr->pos) == Teleport);
 
-    origpos = pos = cr->pos;
+    origpos = cr->pos;
+    i = lx->teleportsbefore[origpos];
 
     for (;;) {
-	--pos;
-	if (pos < 0)
-	    pos += CXGRID * CYGRID;
-	if (floorat(pos) == Teleport) {
-	    if (cr->id != Chip)
-		removeclaim(cr->pos);
-	    cr->pos = pos;
-	    if (!islocationclaimed(pos) && canmakemove(cr, cr->dir, 0))
-		break;
-	    if (pos == origpos) {
-		if (cr->id == Chip)
-		    chipstuck() = TRUE;
-		else
-		    claimlocation(cr->pos);
-		return FALSE;
-	    }
+	if (!i)
+	    i = lx->teleportcount;
+	pos = lx->teleports[--i];
+	if (cr->id != Chip)
+	    removeclaim(cr->pos);
+	vacate(lx, cr);
+	cr->pos = pos;
+	occupy(lx, cr);
+	if (!islocationclaimed(pos) && canmakemove(lx, cr, cr->dir, 0))
+	    break;
+	if (pos == origpos) {
+	    if (cr->id == Chip)
+		chipstuck() = TRUE;
+	    else
+		claimlocation(cr->pos);
+	    return FALSE;
 	}
     }
 
@@ -1095,7 +1341,7 @@ static int teleportcreature(creature *cr)
 /* Release a creature currently inside a clone machine. If the
  * creature successfully exits, a new clone is created to replace it.
  */
-static int activatecloner(int pos)
+static int activatecloner(lxengine *lx, int pos)
 {
     creature   *cr;
     creature   *clone;
@@ -1112,16 +1358,20 @@ static int activatecloner(int pos)
 	     pos % CXGRID, pos / CXGRID);
 	return FALSE;
     }
-    cr = lookupcreature(pos, TRUE);
+    cr = lookupcreature(lx, pos, TRUE);
     if (!cr)
 	return FALSE;
-    clone = newcreature();
+    clone = newcreature(lx);
     if (!clone)
-	return advancecreature(cr, TRUE) != 0;
+	return advancecreature(lx, cr, TRUE) != 0;
 
     *clone = *cr;
-    if (advancecreature(cr, TRUE) <= 0) {
+    updateslot(lx, clone);
+    occupy(lx, clone);
+    if (advancecreature(lx, cr, TRUE) <= 0) {
+	vacate(lx, clone);
 	clone->hidden = TRUE;
+	updateslot(lx, clone);
 	return FALSE;
     }
     return TRUE;
@@ -1129,7 +1379,7 @@ static int activatecloner(int pos)
 
 /* Release any creature on a beartrap at the given location.
  */
-static void springtrap(int pos)
+static void springtrap(lxengine *lx, int pos)
 {
     creature   *cr;
 
@@ -1145,9 +1395,9 @@ static void springtrap(int pos)
 	     pos % CXGRID, pos / CXGRID);
 	return;
     }
-    cr = lookupcreature(pos, TRUE);
+    cr = lookupcreature(lx, pos, TRUE);
     if (cr && cr->dir != NIL)
-	advancecreature(cr, TRUE);
+	advancecreature(lx, cr, TRUE);
 }
 
 /*
@@ -1161,7 +1411,7 @@ static void springtrap(int pos)
  * moving, 0 is returned if the move could not be initiated, and -1 is
  * returned if the creature was killed in the attempt.
  */
-static int startmovement(creature *cr, int releasing)
+static int startmovement(lxengine *lx, creature *cr, int releasing)
 {
     creature   *other;
     int		dir;
@@ -1190,7 +1440,7 @@ static int startmovement(creature *cr, int releasing)
 	}
     }
 
-    if (!canmakemove(cr, dir, CMM_PUSHBLOCKSNOW
+    if (!canmakemove(lx, cr, dir, CMM_PUSHBLOCKSNOW
 					| CMM_CLEARANIMATIONS
 					| CMM_STARTMOVEMENT
 					| (releasing ? CMM_RELEASING : 0))) {
@@ -1203,7 +1453,7 @@ static int startmovement(creature *cr, int releasing)
 	}
 	if (isice(floorfrom) && (cr->id != Chip || !possession(Boots_Ice))) {
 	    cr->dir = back(dir);
-	    applyicewallturn(cr);
+	    applyicewallturn(lx, cr);
 	}
 	return 0;
     }
@@ -1217,25 +1467,27 @@ static int startmovement(creature *cr, int releasing)
 	    chiptocr() = cr;
     } else if (chiptocr() && !chiptocr()->hidden) {
 	chiptocr()->moving = 8;
-	removechip(CHIP_COLLIDED, chiptocr());
+	removechip(lx, CHIP_COLLIDED, chiptocr());
 	return -1;
     }
 
+    vacate(lx, cr);
     cr->pos += delta[dir];
+    occupy(lx, cr);
     if (cr->id != Chip)
 	claimlocation(cr->pos);
 
     cr->moving += 8;
 
     if (cr->id != Chip && cr->pos == chippos() && !getchip()->hidden) {
-	removechip(CHIP_COLLIDED, cr);
+	removechip(lx, CHIP_COLLIDED, cr);
 	return -1;
     }
     if (cr->id == Chip) {
 	couldntmove() = FALSE;
-	other = lookupcreature(cr->pos, FALSE);
+	other = lookupcreature(lx, cr->pos, FALSE);
 	if (other) {
-	    removechip(CHIP_COLLIDED, other);
+	    removechip(lx, CHIP_COLLIDED, other);
 	    return -1;
 	}
     }
@@ -1250,7 +1502,7 @@ static int startmovement(creature *cr, int releasing)
 
 /* Continue the given creature's move.
  */
-static int continuemovement(creature *cr)
+static int continuemovement(lxengine *lx, creature *cr)
 {
     int	floor, speed;
 
@@ -1278,7 +1530,7 @@ static int continuemovement(creature *cr)
  * returned if the creature is removed by the time the function
  * returns.
  */
-static int endmovement(creature *cr)
+static int endmovement(lxengine *lx, creature *cr)
 {
     int	floor;
     int	survived = TRUE;
@@ -1291,29 +1543,29 @@ static int endmovement(creature *cr)
     floor = floorat(cr->pos);
 
     if (cr->id != Chip || !possession(Boots_Ice))
-	applyicewallturn(cr);
+	applyicewallturn(lx, cr);
 
     if (cr->id == Chip) {
 	switch (floor) {
 	  case Water:
 	    if (!possession(Boots_Water)) {
-		removechip(CHIP_DROWNED, NULL);
+		removechip(lx, CHIP_DROWNED, NULL);
 		survived = FALSE;
 	    }
 	    break;
 	  case Fire:
 	    if (!possession(Boots_Fire)) {
-		removechip(CHIP_BURNED, NULL);
+		removechip(lx, CHIP_BURNED, NULL);
 		survived = FALSE;
 	    }
 	    break;
 	  case Dirt:
 	  case BlueWall_Fake:
-	    floorat(cr->pos) = Empty;
+	    setfloorat(cr->pos, Empty);
 	    addsoundeffect(SND_TILE_EMPTIED);
 	    break;
 	  case PopupWall:
-	    floorat(cr->pos) = Wall;
+	    setfloorat(cr->pos, Wall);
 	    addsoundeffect(SND_WALL_CREATED);
 	    break;
 	  case Door_Red:
@@ -1323,7 +1575,7 @@ static int endmovement(creature *cr)
 	    _assert(possession(floor));
 	    if (floor != Door_Green)
 		--possession(floor);
-	    floorat(cr->pos) = Empty;
+	    setfloorat(cr->pos, Empty);
 	    addsoundeffect(SND_DOOR_OPENED);
 	    break;
 	  case Key_Red:
@@ -1339,7 +1591,7 @@ static int endmovement(creature *cr)
 	  case Boots_Fire:
 	  case Boots_Water:
 	    ++possession(floor);
-	    floorat(cr->pos) = Empty;
+	    setfloorat(cr->pos, Empty);
 	    addsoundeffect(SND_ITEM_COLLECTED);
 	    break;
 	  case Burglar:
@@ -1352,16 +1604,17 @@ static int endmovement(creature *cr)
 	  case ICChip:
 	    if (chipsneeded())
 		--chipsneeded();
-	    floorat(cr->pos) = Empty;
+	    setfloorat(cr->pos, Empty);
 	    addsoundeffect(SND_IC_COLLECTED);
 	    break;
 	  case Socket:
 	    _assert(chipsneeded() == 0);
-	    floorat(cr->pos) = Empty;
+	    setfloorat(cr->pos, Empty);
 	    addsoundeffect(SND_SOCKET_OPENED);
 	    break;
 	  case Exit:
 	    cr->hidden = TRUE;
+	    updateslot(lx, cr);
 	    completed() = TRUE;
 	    addsoundeffect(SND_CHIP_WINS);
 	    break;
@@ -1369,13 +1622,13 @@ static int endmovement(creature *cr)
     } else if (cr->id == Block) {
 	switch (floor) {
 	  case Water:
-	    floorat(cr->pos) = Dirt;
+	    setfloorat(cr->pos, Dirt);
 	    addsoundeffect(SND_WATER_SPLASH);
-	    removecreature(cr, Water_Splash);
+	    removecreature(lx, cr, Water_Splash);
 	    survived = FALSE;
 	    break;
 	  case Key_Blue:
-	    floorat(cr->pos) = Empty;
+	    setfloorat(cr->pos, Empty);
 	    break;
 	}
     } else {
@@ -1383,12 +1636,12 @@ static int endmovement(creature *cr)
 	  case Water:
 	    if (cr->id != Glider) {
 		addsoundeffect(SND_WATER_SPLASH);
-		removecreature(cr, Water_Splash);
+		removecreature(lx, cr, Water_Splash);
 		survived = FALSE;
 	    }
 	    break;
 	  case Key_Blue:
-	    floorat(cr->pos) = Empty;
+	    setfloorat(cr->pos, Empty);
 	    break;
 	}
     }
@@ -1398,12 +1651,12 @@ static int endmovement(creature *cr)
 
     switch (floor) {
       case Bomb:
-	floorat(cr->pos) = Empty;
+	setfloorat(cr->pos, Empty);
 	if (cr->id == Chip) {
-	    removechip(CHIP_BOMBED, NULL);
+	    removechip(lx, CHIP_BOMBED, NULL);
 	} else {
 	    addsoundeffect(SND_BOMB_EXPLODES);
-	    removecreature(cr, Bomb_Explosion);
+	    removecreature(lx, cr, Bomb_Explosion);
 	}
 	survived = FALSE;
 	break;
@@ -1411,7 +1664,7 @@ static int endmovement(creature *cr)
 	addsoundeffect(SND_TRAP_ENTERED);
 	break;
       case Button_Blue:
-	turntanks();
+	turntanks(lx);
 	addsoundeffect(SND_BUTTON_PUSHED);
 	break;
       case Button_Green:
@@ -1419,7 +1672,7 @@ static int endmovement(creature *cr)
 	addsoundeffect(SND_BUTTON_PUSHED);
 	break;
       case Button_Red:
-	if (activatecloner(clonerfrombutton(cr->pos)))
+	if (activatecloner(lx, clonerfrombutton(lx, cr->pos)))
 	    addsoundeffect(SND_BUTTON_PUSHED);
 	break;
       case Button_Brown:
@@ -1440,7 +1693,7 @@ static int endmovement(creature *cr)
  * creature tried to move and failed, or -1 if the creature was killed
  * and exists no longer.
  */
-static int advancecreature(creature *cr, int releasing)
+static int advancecreature(lxengine *lx, creature *cr, int releasing)
 {
     char	tdir = NIL;
     int		f;
@@ -1452,7 +1705,7 @@ static int advancecreature(creature *cr, int releasing)
 	    cr->tdir = cr->dir;
 	} else if (cr->tdir == NIL && getfdir(cr) == NIL)
 	    return +1;
-	f = startmovement(cr, releasing);
+	f = startmovement(lx, cr, releasing);
 	if (f < 0)
 	    return f;
 	if (f == 0) {
@@ -1463,8 +1716,8 @@ static int advancecreature(creature *cr, int releasing)
 	cr->tdir = NIL;
     }
 
-    if (!continuemovement(cr)) {
-	if (!endmovement(cr))
+    if (!continuemovement(lx, cr)) {
+	if (!endmovement(lx, cr))
 	    return -1;
     }
 
@@ -1479,16 +1732,17 @@ static int advancecreature(creature *cr, int releasing)
 
 /* Print out a rough image of the level and the list of creatures.
  */
-static void dumpmap(void)
+static void dumpmap(lxengine *lx)
 {
     creature   *cr;
     int		y, x;
 
     for (y = 0 ; y < CXGRID * CYGRID ; y += CXGRID) {
 	for (x = 0 ; x < CXGRID ; ++x)
-	    fprintf(stderr, "%02X%c", state->map[y + x].top.id,
-		    (state->map[y + x].top.state ?
-		     state->map[y + x].top.state & 0x40 ? '*' : '.' : ' '));
+	    fprintf(stderr, "%02X%c", lx->state->map[y + x].top.id,
+		    (lx->state->map[y + x].top.state ?
+		     lx->state->map[y + x].top.state & 0x40 ? '*' : '.'
+							     : ' '));
 	fputc('\n', stderr);
     }
     fputc('\n', stderr);
@@ -1504,24 +1758,24 @@ static void dumpmap(void)
 
 /* Run various sanity checks on the current game state.
  */
-static void verifymap(void)
+static void verifymap(lxengine *lx)
 {
     creature   *cr;
     int		pos;
 
     for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos) {
-	if (state->map[pos].top.id >= 0x40)
+	if (lx->state->map[pos].top.id >= 0x40)
 	    warn("%d: Undefined floor %d at (%d %d)",
-		 currenttime(), state->map[pos].top.id,
+		 currenttime(), lx->state->map[pos].top.id,
 		 pos % CXGRID, pos / CXGRID);
-	if (state->map[pos].top.state & 0x80)
+	if (lx->state->map[pos].top.state & 0x80)
 	    warn("%d: Undefined floor state %02X at (%d %d)",
-		 currenttime(), state->map[pos].top.id,
+		 currenttime(), lx->state->map[pos].top.id,
 		 pos % CXGRID, pos / CXGRID);
     }
 
     for (cr = creaturelist() ; cr->id ; ++cr) {
-	if (isanimation(state->map[cr->pos].top.id)) {
+	if (isanimation(lx->state->map[cr->pos].top.id)) {
 	    if (cr->moving > 12)
 		warn("%d: Too-large animation frame %02X at (%d %d)",
 		     currenttime(), cr->moving,
@@ -1560,19 +1814,19 @@ static void verifymap(void)
 
 /* Actions and checks that occur at the start of every tick.
  */
-static void initialhousekeeping(void)
+static void initialhousekeeping(lxengine *lx)
 {
     creature   *chip;
     creature   *cr;
-    int		pos;
+    int		pos, n;
 
 #ifndef NDEBUG
-    verifymap();
+    verifymap(lx);
 #endif
 
     if (currenttime() == 0) {
-	lastrndslidedir = rndslidedir();
-	laststepping = stepping();
+	lx->lastrndslidedir = rndslidedir();
+	lx->laststepping = stepping();
     }
 
     chip = getchip();
@@ -1584,13 +1838,11 @@ static void initialhousekeeping(void)
 	    startendgametimer();
 	    timeoffset() = 1;
 	} else if (timelimit() && currenttime() >= timelimit()) {
-	    removechip(CHIP_OUTOFTIME, NULL);
+	    removechip(lx, CHIP_OUTOFTIME, NULL);
 	}
     }
 
-    for (cr = creaturelist() ; cr->id ; ++cr) {
-	if (cr->hidden)
-	    continue;
+    for (cr = nextcreature(lx, NULL) ; cr ; cr = nextcreature(lx, cr)) {
 	if (cr->state & CS_REVERSE) {
 	    cr->state &= ~CS_REVERSE;
 	    if (cr->moving <= 0)
@@ -1607,17 +1859,18 @@ static void initialhousekeeping(void)
     }
 
     if (togglestate()) {
-	for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos) {
+	for (n = 0 ; n < lx->switchwallcount ; ++n) {
+	    pos = lx->switchwalls[n];
 	    if (floorat(pos) == SwitchWall_Open
 				|| floorat(pos) == SwitchWall_Closed)
-		floorat(pos) ^= togglestate();
+		setfloorat(pos, floorat(pos) ^ togglestate());
 	}
 	togglestate() = 0;
     }
 
 #ifndef NDEBUG
     if (currentinput() == CmdDebugCmd2) {
-	dumpmap();
+	dumpmap(lx);
 	exit(0);
 	currentinput() = NIL;
     } else if (currentinput() == CmdDebugCmd1) {
@@ -1653,14 +1906,32 @@ static void initialhousekeeping(void)
 
 /* Actions and checks that occur at the end of every tick.
  */
-static void finalhousekeeping(void)
+static void finalhousekeeping(lxengine *lx)
 {
     return;
 }
 
+/* Hand the change log a copy of the creature list, up to and
+ * including the end marker, as it is at the start or the end of a
+ * tick. At the end of the tick the two copies are compared.
+ */
+static void copycreatures(lxengine *lx, int atstart)
+{
+    creature   *copy;
+    int		n;
+
+    n = slotnum(creaturelistend()) + 2;
+    copy = atstart ? creaturesbefore(changes(), n)
+		   : creaturesafter(changes(), n);
+    if (copy)
+	memcpy(copy, creaturelist(), n * sizeof *copy);
+    if (!atstart)
+	logcreaturechanges(changes());
+}
+
 /* Set the state fields specifically used to produce the output.
  */
-static void preparedisplay(void)
+static void preparedisplay(lxengine *lx)
 {
     creature   *chip;
     int		floor;
@@ -1687,7 +1958,7 @@ static void preparedisplay(void)
 	if (chip->id == Chip && chippushing())
 	    chip->id = Pushing_Chip;
 	if (chip->moving) {
-	    resetfloorsounds(FALSE);
+	    resetfloorsounds(lx, FALSE);
 	    floor = floorat(chip->pos);
 	    if (floor == Fire && possession(Boots_Fire))
 		addsoundeffect(SND_FIREWALKING);
@@ -1721,23 +1992,25 @@ static void preparedisplay(void)
  */
 static int initgame(gamelogic *logic)
 {
+    lxengine	       *lx = getengine(logic);
     creature		crtemp;
     creature	       *cr;
     mapcell	       *cell;
     xyconn	       *xy;
     int			pos, num, n;
 
-    setstate(logic);
-    num = state->game->number;
-    creaturelist() = creaturearray + 1;
+    lx->state = logic->state;
+    num = lx->state->game->number;
+    creaturelist() = lx->creaturearray + 1;
     cr = creaturelist();
 
     if (pedanticmode)
-	if (state->statusflags & SF_BADTILES)
+	if (lx->state->statusflags & SF_BADTILES)
 	    markinvalid();
 
     n = -1;
-    for (pos = 0, cell = state->map ; pos < CXGRID * CYGRID ; ++pos, ++cell) {
+    for (pos = 0, cell = lx->state->map ; pos < CXGRID * CYGRID ;
+						       ++pos, ++cell) {
 	if (cell->top.id == Block_Static)
 	    cell->top.id = crtile(Block, NORTH);
 	if (cell->bot.id == Block_Static)
@@ -1808,6 +2081,8 @@ static int initgame(gamelogic *logic)
 	cr[0] = cr[n];
 	cr[n] = crtemp;
     }
+    buildoccupancy(lx);
+    buildslots(lx);
 
     for (xy = traplist(), n = traplistsize() ; n ; --n, ++xy) {
 	if (xy->from >= CXGRID * CYGRID || xy->to >= CXGRID * CYGRID) {
@@ -1835,6 +2110,7 @@ static int initgame(gamelogic *logic)
 	    xy->from = -1;
 	}
     }
+    buildwiring(lx);
 
     possession(Key_Red) = possession(Key_Blue)
 			= possession(Key_Yellow)
@@ -1854,12 +2130,12 @@ static int initgame(gamelogic *logic)
     chiptocr() = NULL;
     prngvalue1() = 0;
     prngvalue2() = 0;
-    rndslidedir() = lastrndslidedir;
-    stepping() = laststepping;
+    rndslidedir() = lx->lastrndslidedir;
+    stepping() = lx->laststepping;
     xviewoffset() = 0;
     yviewoffset() = 0;
 
-    preparedisplay();
+    preparedisplay(lx);
     return !ismarkedinvalid();
 }
 
@@ -1867,63 +2143,69 @@ static int initgame(gamelogic *logic)
  */
 static int advancegame(gamelogic *logic)
 {
+    lxengine   *lx = getengine(logic);
     creature   *cr;
 
-    setstate(logic);
+    lx->state = logic->state;
+    if (changes())
+	copycreatures(lx, TRUE);
 
     mapbreached() = FALSE;
 
-    initialhousekeeping();
+    initialhousekeeping(lx);
 
-    for (cr = creaturelistend() ; cr >= creaturelist() ; --cr) {
+    beginphase(logic, Phase_LxChoose);
+    clearstaleslots(lx);
+    for (cr = prevcreature(lx, NULL) ; cr ; cr = prevcreature(lx, cr)) {
 	setfdir(cr, NIL);
 	cr->tdir = NIL;
-	if (cr->hidden)
-	    continue;
 	if (isanimation(cr->id)) {
 	    --cr->frame;
 	    if (cr->frame < 0)
-		removeanimation(cr);
+		removeanimation(lx, cr);
 	    continue;
 	}
 	if (cr->moving <= 0)
-	    choosemove(cr);
+	    choosemove(lx, cr);
     }
 
     cr = getchip();
     if (getfdir(cr) == NIL && cr->tdir == NIL)
 	couldntmove() = FALSE;
     else
-	checkmovingto();
+	checkmovingto(lx);
+    endphase(logic, Phase_LxChoose);
 
-    for (cr = creaturelistend() ; cr >= creaturelist() ; --cr) {
-	if (cr->hidden)
-	    continue;
-	if (advancecreature(cr, FALSE) < 0)
+    beginphase(logic, Phase_LxAdvance);
+    for (cr = prevcreature(lx, NULL) ; cr ; cr = prevcreature(lx, cr)) {
+	if (advancecreature(lx, cr, FALSE) < 0)
 	    continue;
 	cr->tdir = NIL;
 	setfdir(cr, NIL);
 	if (floorat(cr->pos) == Button_Brown && cr->moving <= 0)
-	    springtrap(trapfrombutton(cr->pos));
+	    springtrap(lx, trapfrombutton(lx, cr->pos));
     }
+    endphase(logic, Phase_LxAdvance);
 
-    for (cr = creaturelistend() ; cr >= creaturelist() ; --cr) {
-	if (cr->hidden)
-	    continue;
+    beginphase(logic, Phase_LxTeleport);
+    for (cr = prevcreature(lx, NULL) ; cr ; cr = prevcreature(lx, cr)) {
 	if (cr->moving)
 	    continue;
 	if (floorat(cr->pos) == Teleport)
-	    teleportcreature(cr);
+	    teleportcreature(lx, cr);
     }
+    endphase(logic, Phase_LxTeleport);
 
-    finalhousekeeping();
+    finalhousekeeping(lx);
 
-    preparedisplay();
+    preparedisplay(lx);
+    if (changes())
+	copycreatures(lx, FALSE);
 
     if (inendgame()) {
 	--timeoffset();
 	if (!decrendgametimer()) {
-	    resetfloorsounds(TRUE);
+	    resetfloorsounds(lx, TRUE);
 	    return completed() ? +1 : -1;
 	}
     }
@@ -1945,33 +2227,99 @@ static int endgame(gamelogic *logic)
     return TRUE;
 }
 
-/* Free all allocated resources for this module.
+/* Write the header of a snapshot to buf: the state of the random
+ * slide floors, the length of the creature list, and the position in
+ * it that Chip's collision refers to.
+ */
+static int savestatehead(gamelogic *logic, void *buf, int size)
+{
+    lxengine   *lx = getengine(logic);
+    int		header[3];
+
+    if ((int)sizeof header > size)
+	return sizeof header;
+    header[0] = lx->lastrndslidedir;
+    header[1] = slotnum(creaturelistend()) + 2;
+    header[2] = chiptocr() ? slotnum(chiptocr()) : -1;
+    memcpy(buf, header, sizeof header);
+    return sizeof header;
+}
+
+/* Write a snapshot of the creature list to buf. The entries are
+ * stored up to and including the end marker, after the header.
+ */
+static int savestate(gamelogic *logic, void *buf, int size)
+{
+    lxengine	       *lx = getengine(logic);
+    unsigned char      *p = buf;
+    int			head, need, n;
+
+    head = savestatehead(logic, NULL, 0);
+    n = slotnum(creaturelistend()) + 2;
+    need = head + n * sizeof(creature);
+    if (need > size)
+	return need;
+
+    savestatehead(logic, p, head);
+    memcpy(p + head, creaturelist(), n * sizeof(creature));
+    return need;
+}
+
+/* Put back the creature list from a snapshot written by savestate(),
+ * and rebuild the indexes of it.
+ */
+static int restorestate(gamelogic *logic, void const *buf, int size)
+{
+    lxengine		       *lx = getengine(logic);
+    unsigned char const	       *p = buf;
+    int				header[3];
+
+    if (size < (int)sizeof header)
+	return FALSE;
+    memcpy(header, p, sizeof header);
+    if (header[1] < 1 || header[1] > MAX_CREATURES
+		      || size != (int)(sizeof header
+						+ header[1] * sizeof(creature)))
+	return FALSE;
+
+    lx->lastrndslidedir = header[0];
+    memcpy(creaturelist(), p + sizeof header, header[1] * sizeof(creature));
+    creaturelistend() = creaturelist() + header[1] - 2;
+    chiptocr() = header[2] < 0 ? NULL : creaturelist() + header[2];
+    buildoccupancy(lx);
+    buildslots(lx);
+    return TRUE;
+}
+
+/* Free all allocated resources for this instance of the module.
  */
 static void shutdown(gamelogic *logic)
 {
-    (void)logic;
-    free(creaturearray);
-    creaturearray = NULL;
+    free(getengine(logic));
 }
 
-/* The exported function: Initialize and return the module's gamelogic
- * structure.
+/* The exported function: Create and return a new instance of the
+ * module's gamelogic structure.
  */
 gamelogic *lynxlogicstartup(void)
 {
-    static gamelogic	logic;
+    lxengine   *lx;
 
-    creaturearray = calloc(MAX_CREATURES + 1, sizeof *creaturearray);
-    if (!creaturearray)
+    lx = calloc(1, sizeof *lx);
+    if (!lx)
 	memerrexit();
-    lastrndslidedir = NORTH;
-    laststepping = 0;
-
-    logic.ruleset = Ruleset_Lynx;
-    logic.initgame = initgame;
-    logic.advancegame = advancegame;
-    logic.endgame = endgame;
-    logic.shutdown = shutdown;
-
-    return &logic;
+    lx->lastrndslidedir = NORTH;
+    lx->laststepping = 0;
+
+    lx->logic.ruleset = Ruleset_Lynx;
+    lx->logic.initgame = initgame;
+    lx->logic.advancegame = advancegame;
+    lx->logic.endgame = endgame;
+    lx->logic.savestate = savestate;
+    lx->logic.savestatehead = savestatehead;
+    lx->logic.restorestate = restorestate;
+    lx->logic.shutdown = shutdown;
+    initprngsequence(&lx->logic.rndsequence);
+
+    return &lx->logic;
 }
@@ -11,6 +11,8 @@
 #include	"state.h"
 #include	"random.h"
 #include	"logic.h"
+#include	"phase.h"
+#include	"changes.h"
 
 #ifdef NDEBUG
 #define	_assert(test)	((void)0)
@@ -28,58 +30,130 @@ enum {
     CHIP_NOTOKAY
 };
 
-/* Forward declaration of a central function.
+/* The data associated with a sliding object.
  */
-static int advancecreature(creature *cr, int dir);
+typedef	struct slipper {
+    creature   *cr;
+    int		dir;
+} slipper;
 
-/* The most recently used stepping phase value.
+/* The size of the lists of trap and cloner wirings.
  */
-static int		laststepping = 0;
+#define	MAX_WIRES	(int)(sizeof ((gamestate*)0)->traps / sizeof(xyconn))
 
-/* A pointer to the game state, used so that it doesn't have to be
- * passed to every single function.
+/* An index of the creatures in a list by their location. For each
+ * location on the map, the number of visible creatures there is
+ * kept, together with the creature itself if there is only one.
  */
-static gamestate       *state;
+typedef struct posindex {
+    creature	       *occupant[CXGRID * CYGRID];
+    unsigned short	count[CXGRID * CYGRID];
+} posindex;
+
+/* The data associated with a deferred button.
+ */
+typedef struct deferredbutton {
+    short pos;
+    unsigned char id;
+} deferredbutton;
+
+/* Everything belonging to one instance of the logic engine. A pointer
+ * to this is passed to every function that needs to look at the game
+ * in progress, so that separate instances never share any state.
+ */
+typedef	struct msengine {
+    gamelogic		logic;			/* the exported interface */
+    gamestate	       *state;			/* the current game state */
+    int			laststepping;		/* last used stepping value */
+    creature		dummycrlist;		/* empty display list */
+
+    creature	       *creaturepool;		/* the creature arena */
+    void	       *creaturepoolend;
+
+    creature	      **creatures;		/* the active creatures */
+    int			creaturecount;
+    int			creaturesallocated;
+
+    creature	      **blocks;			/* the "active" blocks */
+    int			blockcount;
+    int			blocksallocated;
+
+    posindex		crindex;		/* where the creatures are */
+    posindex		blockindex;		/* where the blocks are */
+
+    short		trapwiring[CXGRID * CYGRID];
+						/* the trap for each button */
+    short		clonerwiring[CXGRID * CYGRID];
+						/* the cloner for each button */
+    short		trapbuttons[CXGRID * CYGRID];
+						/* first wire to each trap */
+    short		nexttrapbutton[MAX_WIRES];
+						/* next wire to the same trap */
+    short		teleports[CXGRID * CYGRID];
+						/* teleports in map order */
+    short		teleportcount;
+    short		teleportsbefore[CXGRID * CYGRID];
+						/* teleports preceding each */
+    short		switchwalls[CXGRID * CYGRID];
+						/* where the toggle walls are */
+    short		switchwallcount;
+
+    slipper	       *slips;			/* the sliding creatures */
+    int			slipcount;
+    int			slipsallocated;
+
+    deferredbutton     *defers;			/* deferred button presses */
+    int			defercount;
+    int			defersallocated;
+} msengine;
+
+/* Forward declaration of a central function.
+ */
+static int advancecreature(msengine *ms, creature *cr, int dir);
 
 /*
  * Accessor macros for various fields in the game state. Many of the
  * macros can be used as an lvalue.
  */
 
-#define	setstate(p)		(state = (p)->state)
+#define	getengine(p)		((msengine*)(p))
 
-#define	getchip()		(creatures[0])
+#define	getchip()		(ms->creatures[0])
 #define	chippos()		(getchip()->pos)
 #define	chipdir()		(getchip()->dir)
 
-#define	chipsneeded()		(state->chipsneeded)
+#define	chipsneeded()		(ms->state->chipsneeded)
+
+#define	clonerlist()		(ms->state->cloners)
+#define	clonerlistsize()	(ms->state->clonercount)
+#define	traplist()		(ms->state->traps)
+#define	traplistsize()		(ms->state->trapcount)
 
-#define	clonerlist()		(state->cloners)
-#define	clonerlistsize()	(state->clonercount)
-#define	traplist()		(state->traps)
-#define	traplistsize()		(state->trapcount)
+#define	timelimit()		(ms->state->timelimit)
+#define	timeoffset()		(ms->state->timeoffset)
+#define	stepping()		(ms->state->stepping)
+#define	currenttime()		(ms->state->currenttime)
+#define	currentinput()		(ms->state->currentinput)
+#define	xviewpos()		(ms->state->xviewpos)
+#define	yviewpos()		(ms->state->yviewpos)
 
-#define	timelimit()		(state->timelimit)
-#define	timeoffset()		(state->timeoffset)
-#define	stepping()		(state->stepping)
-#define	currenttime()		(state->currenttime)
-#define	currentinput()		(state->currentinput)
-#define	xviewpos()		(state->xviewpos)
-#define	yviewpos()		(state->yviewpos)
+#define	mainprng()		(&ms->state->mainprng)
 
-#define	mainprng()		(&state->mainprng)
+#define	lastmove()		(ms->state->lastmove)
 
-#define	lastmove()		(state->lastmove)
+#define	addsoundeffect(sfx)	(ms->state->soundeffects |= 1 << (sfx))
 
-#define	addsoundeffect(sfx)	(state->soundeffects |= 1 << (sfx))
+#define	cellat(pos)		(&ms->state->map[pos])
 
-#define	cellat(pos)		(&state->map[pos])
+#define	changes()		(ms->state->changes)
+#define	cellchanged(pos)	(changes() ? logcellchange(changes(), pos) \
+					   : (void)0)
 
-#define	setnosaving()		(state->statusflags |= SF_NOSAVING)
-#define	showhint()		(state->statusflags |= SF_SHOWHINT)
-#define	hidehint()		(state->statusflags &= ~SF_SHOWHINT)
+#define	setnosaving()		(ms->state->statusflags |= SF_NOSAVING)
+#define	showhint()		(ms->state->statusflags |= SF_SHOWHINT)
+#define	hidehint()		(ms->state->statusflags &= ~SF_SHOWHINT)
 
-#define	getmsstate()		(state->msstate)
+#define	getmsstate()		(ms->state->msstate)
 
 #define	completed()		(getmsstate().completed)
 #define	chipstatus()		(getmsstate().chipstatus)
@@ -93,34 +167,34 @@ static gamestate       *state;
 #define	hasgoal()		(goalpos() >= 0)
 #define	cancelgoal()		(goalpos() = -1)
 
-#define	possession(obj)	(*_possession(obj))
-static short *_possession(int obj)
+#define	possession(obj)	(*_possession(ms, obj))
+static short *_possession(msengine *ms, int obj)
 {
     switch (obj) {
-      case Key_Red:		return &state->keys[0];
-      case Key_Blue:		return &state->keys[1];
-      case Key_Yellow:		return &state->keys[2];
-      case Key_Green:		return &state->keys[3];
-      case Boots_Ice:		return &state->boots[0];
-      case Boots_Slide:		return &state->boots[1];
-      case Boots_Fire:		return &state->boots[2];
-      case Boots_Water:		return &state->boots[3];
-      case Door_Red:		return &state->keys[0];
-      case Door_Blue:		return &state->keys[1];
-      case Door_Yellow:		return &state->keys[2];
-      case Door_Green:		return &state->keys[3];
-      case Ice:			return &state->boots[0];
-      case IceWall_Northwest:	return &state->boots[0];
-      case IceWall_Northeast:	return &state->boots[0];
-      case IceWall_Southwest:	return &state->boots[0];
-      case IceWall_Southeast:	return &state->boots[0];
-      case Slide_North:		return &state->boots[1];
-      case Slide_West:		return &state->boots[1];
-      case Slide_South:		return &state->boots[1];
-      case Slide_East:		return &state->boots[1];
-      case Slide_Random:	return &state->boots[1];
-      case Fire:		return &state->boots[2];
-      case Water:		return &state->boots[3];
+      case Key_Red:		return &ms->state->keys[0];
+      case Key_Blue:		return &ms->state->keys[1];
+      case Key_Yellow:		return &ms->state->keys[2];
+      case Key_Green:		return &ms->state->keys[3];
+      case Boots_Ice:		return &ms->state->boots[0];
+      case Boots_Slide:		return &ms->state->boots[1];
+      case Boots_Fire:		return &ms->state->boots[2];
+      case Boots_Water:		return &ms->state->boots[3];
+      case Door_Red:		return &ms->state->keys[0];
+      case Door_Blue:		return &ms->state->keys[1];
+      case Door_Yellow:		return &ms->state->keys[2];
+      case Door_Green:		return &ms->state->keys[3];
+      case Ice:			return &ms->state->boots[0];
+      case IceWall_Northwest:	return &ms->state->boots[0];
+      case IceWall_Northeast:	return &ms->state->boots[0];
+      case IceWall_Southwest:	return &ms->state->boots[0];
+      case IceWall_Southeast:	return &ms->state->boots[0];
+      case Slide_North:		return &ms->state->boots[1];
+      case Slide_West:		return &ms->state->boots[1];
+      case Slide_South:		return &ms->state->boots[1];
+      case Slide_East:		return &ms->state->boots[1];
+      case Slide_Random:	return &ms->state->boots[1];
+      case Fire:		return &ms->state->boots[2];
+      case Water:		return &ms->state->boots[3];
     }
     warn("Invalid object %d handed to possession()", obj);
     _assert(!"possession() called with an invalid object");
@@ -131,105 +205,65 @@ static short *_possession(int obj)
  * Memory allocation functions for the various arenas.
  */
 
-/* The data associated with a sliding object.
- */
-typedef	struct slipper {
-    creature   *cr;
-    int		dir;
-} slipper;
-
-/* The data associated with a deferred button.
- */
-typedef struct deferredbutton {
-    short pos;
-    unsigned char id;
-} deferredbutton;
-
-
-/* The linked list of creature pools, forming the creature arena.
+/* The number of creatures in each chunk of the creature arena.
  */
-static creature	       *creaturepool = NULL;
-static void	       *creaturepoolend = NULL;
 static int const	creaturepoolchunk = 256;
 
-/* The list of active creatures.
- */
-static creature	      **creatures = NULL;
-static int		creaturecount = 0;
-static int		creaturesallocated = 0;
-
-/* The list of "active" blocks.
- */
-static creature	      **blocks = NULL;
-static int		blockcount = 0;
-static int		blocksallocated = 0;
-
-/* The list of sliding creatures.
- */
-static slipper	       *slips = NULL;
-static int		slipcount = 0;
-static int		slipsallocated = 0;
-
-/* The stack of deferred button presses.
- */
-static deferredbutton  *defers = NULL;
-static int     defercount = 0;
-static int     defersallocated = 0;
-
 /* Mark all entries in the creature arena as unused.
  */
-static void resetcreaturepool(void)
+static void resetcreaturepool(msengine *ms)
 {
-    if (!creaturepoolend)
+    if (!ms->creaturepoolend)
 	return;
-    while (creaturepoolend) {
-	creaturepool = creaturepoolend;
-	creaturepoolend = ((creature**)creaturepoolend)[0];
+    while (ms->creaturepoolend) {
+	ms->creaturepool = ms->creaturepoolend;
+	ms->creaturepoolend = ((creature**)ms->creaturepoolend)[0];
     }
-    creaturepoolend = creaturepool;
-    creaturepool = (creature*)creaturepoolend - creaturepoolchunk + 1;
+    ms->creaturepoolend = ms->creaturepool;
+    ms->creaturepool = (creature*)ms->creaturepoolend - creaturepoolchunk + 1;
 }
 
 /* Destroy the creature arena.
  */
-static void freecreaturepool(void)
+static void freecreaturepool(msengine *ms)
 {
-    if (!creaturepoolend)
+    if (!ms->creaturepoolend)
 	return;
     for (;;) {
-	creaturepoolend = ((creature**)creaturepoolend)[1];
-	free(creaturepool);
-	creaturepool = creaturepoolend;
-	if (!creaturepool)
+	ms->creaturepoolend = ((creature**)ms->creaturepoolend)[1];
+	free(ms->creaturepool);
+	ms->creaturepool = ms->creaturepoolend;
+	if (!ms->creaturepool)
 	    break;
-	creaturepoolend = creaturepool + creaturepoolchunk - 1;
+	ms->creaturepoolend = ms->creaturepool + creaturepoolchunk - 1;
     }
 }
 
 /* Return a pointer to a fresh creature.
  */
-static creature *allocatecreature(void)
+static creature *allocatecreature(msengine *ms)
 {
     creature   *cr;
 
-    if (creaturepool == creaturepoolend) {
-	if (creaturepoolend && ((creature**)creaturepoolend)[1]) {
-	    creaturepool = ((creature**)creaturepoolend)[1];
-	    creaturepoolend = creaturepool + creaturepoolchunk - 1;
+    if (ms->creaturepool == ms->creaturepoolend) {
+	if (ms->creaturepoolend && ((creature**)ms->creaturepoolend)[1]) {
+	    ms->creaturepool = ((creature**)ms->creaturepoolend)[1];
+	    ms->creaturepoolend = ms->creaturepool + creaturepoolchunk - 1;
 	} else {
-	    cr = creaturepoolend;
-	    creaturepool = malloc(creaturepoolchunk * sizeof *creaturepool);
-	    if (!creaturepool)
+	    cr = ms->creaturepoolend;
+	    ms->creaturepool = malloc(creaturepoolchunk
+				      * sizeof *ms->creaturepool);
+	    if (!ms->creaturepool)
 		memerrexit();
 	    if (cr)
-		((creature**)cr)[1] = creaturepool;
-	    creaturepoolend = creaturepool + creaturepoolchunk - 1;
-	    ((creature**)creaturepoolend)[0] = cr;
-	    ((creature**)creaturepoolend)[1] = NULL;
+		((creature**)cr)[1] = ms->creaturepool;
+	    ms->creaturepoolend = ms->creaturepool + creaturepoolchunk - 1;
+	    ((creature**)ms->creaturepoolend)[0] = cr;
+	    ((creature**)ms->creaturepoolend)[1] = NULL;
 	}
     }
 
-    cr = creaturepool++;
+    cr = ms->creaturepool++;
     cr->id = Nothing;
     cr->pos = -1;
     cr->dir = NIL;
@@ -238,160 +272,300 @@ static creature *allocatecreature(void)
     cr->frame = 0;
     cr->hidden = FALSE;
     cr->moving = 0;
+    cr->slipindex = -1;
     return cr;
 }
 
+/* Copy every creature in the arena to buf, in the order in which they
+ * were allocated, and return how many there are. If buf is NULL, they
+ * are only counted. A creature's place in this order serves as its
+ * slot number in the change log. Since every creature is added to the
+ * creature list or the block list as soon as it is allocated, and
+ * stays there, each list is in this order as well. (Note that the link
+ * at the end of each chunk points back to the end of the previous
+ * chunk, but forward to the start of the next one.)
+ */
+static int copyarena(msengine const *ms, void *buf)
+{
+    unsigned char      *p = buf;
+    creature	       *start, *end;
+    int			count, n, m;
+
+    start = NULL;
+    count = 0;
+    for (end = ms->creaturepoolend ; end ; end = ((creature**)end)[0]) {
+	start = end - creaturepoolchunk + 1;
+	if (end == ms->creaturepoolend)
+	    count += ms->creaturepool - start;
+	else
+	    count += creaturepoolchunk - 1;
+    }
+    if (!p)
+	return count;
+
+    for (n = 0 ; n < count ; n += m) {
+	end = start + creaturepoolchunk - 1;
+	m = count - n;
+	if (m > creaturepoolchunk - 1)
+	    m = creaturepoolchunk - 1;
+	memcpy(p + n * sizeof(creature), start, m * sizeof(creature));
+	start = ((creature**)end)[1];
+    }
+    return count;
+}
+
+/* Hand the change log a copy of the arena as it is at the start or
+ * the end of a tick. At the end of the tick the two copies are
+ * compared.
+ */
+static void copycreatures(msengine *ms, int atstart)
+{
+    creature   *copy;
+    int		count;
+
+    count = copyarena(ms, NULL);
+    copy = atstart ? creaturesbefore(changes(), count)
+		   : creaturesafter(changes(), count);
+    if (copy)
+	copyarena(ms, copy);
+    if (!atstart)
+	logcreaturechanges(changes());
+}
+
+/* The position indexes record where the visible creatures in the
+ * creature list (other than Chip) and in the block list are. Every
+ * change to such a creature's position or visibility is bracketed by
+ * a call to vacate() and a call to occupy(), so that the indexes
+ * always agree with the lists. When more than one creature shares a
+ * location, the index only keeps the count, and the list is searched
+ * as before.
+ */
+#define	isoccupant(cr)	((cr)->id != Chip && !(cr)->hidden		\
+				&& (cr)->pos >= 0			\
+				&& (cr)->pos < CXGRID * CYGRID)
+
+#define	posindexfor(cr)	(isblock((cr)->id) ? &ms->blockindex : &ms->crindex)
+
+/* Add the given creature to its position index.
+ */
+static void occupy(msengine *ms, creature const *cr)
+{
+    posindex   *index;
+
+    if (!isoccupant(cr))
+	return;
+    index = posindexfor(cr);
+    index->occupant[cr->pos] = index->count[cr->pos]++ ? NULL
+						       : (creature*)cr;
+}
+
+/* Remove the given creature from its position index.
+ */
+static void vacate(msengine *ms, creature const *cr)
+{
+    posindex   *index;
+
+    if (!isoccupant(cr))
+	return;
+    index = posindexfor(cr);
+    _assert(index->count[cr->pos] > 0);
+    --index->count[cr->pos];
+    index->occupant[cr->pos] = NULL;
+}
+
+/* Return the first visible creature located at pos among the count
+ * entries of list, starting at entry n.
+ */
+static creature *lookupposindex(posindex *index, creature **list,
+				int n, int count, int pos)
+{
+    if (pos >= 0 && pos < CXGRID * CYGRID) {
+	if (!index->count[pos])
+	    return NULL;
+	if (index->occupant[pos])
+	    return index->occupant[pos];
+    }
+    for ( ; n < count ; ++n)
+	if (list[n]->pos == pos && !list[n]->hidden)
+	    break;
+    if (n == count)
+	return NULL;
+    if (pos >= 0 && pos < CXGRID * CYGRID && index->count[pos] == 1)
+	index->occupant[pos] = list[n];
+    return list[n];
+}
+
 /* Empty the list of active creatures.
  */
-static void resetcreaturelist(void)
+static void resetcreaturelist(msengine *ms)
 {
-    creaturecount = 0;
+    ms->creaturecount = 0;
+    memset(&ms->crindex, 0, sizeof ms->crindex);
 }
 
 /* Append the given creature to the end of the creature list.
  */
-static creature *addtocreaturelist(creature *cr)
+static creature *addtocreaturelist(msengine *ms, creature *cr)
 {
-    if (creaturecount >= creaturesallocated) {
-	creaturesallocated = creaturesallocated ? creaturesallocated * 2 : 16;
-	creatures = realloc(creatures, creaturesallocated * sizeof *creatures);
-	if (!creatures)
+    if (ms->creaturecount >= ms->creaturesallocated) {
+	ms->creaturesallocated = ms->creaturesallocated ?
+					ms->creaturesallocated * 2 : 16;
+	ms->creatures = realloc(ms->creatures, ms->creaturesallocated
+						* sizeof *ms->creatures);
+	if (!ms->creatures)
 	    memerrexit();
     }
-    creatures[creaturecount++] = cr;
+    ms->creatures[ms->creaturecount++] = cr;
+    occupy(ms, cr);
     return cr;
 }
 
 /* Empty the list of "active" blocks.
  */
-static void resetblocklist(void)
+static void resetblocklist(msengine *ms)
 {
-    blockcount = 0;
+    ms->blockcount = 0;
+    memset(&ms->blockindex, 0, sizeof ms->blockindex);
 }
 
 /* Append the given block to the end of the block list.
  */
-static creature *addtoblocklist(creature *cr)
+static creature *addtoblocklist(msengine *ms, creature *cr)
 {
-    if (blockcount >= blocksallocated) {
-	blocksallocated = blocksallocated ? blocksallocated * 2 : 16;
-	blocks = realloc(blocks, blocksallocated * sizeof *blocks);
-	if (!blocks)
+    if (ms->blockcount >= ms->blocksallocated) {
+	ms->blocksallocated = ms->blocksallocated ?
+					ms->blocksallocated * 2 : 16;
+	ms->blocks = realloc(ms->blocks,
+			     ms->blocksallocated * sizeof *ms->blocks);
+	if (!ms->blocks)
 	    memerrexit();
     }
-    blocks[blockcount++] = cr;
+    ms->blocks[ms->blockcount++] = cr;
+    occupy(ms, cr);
     return cr;
 }
 
 /* Empty the list of sliding creatures.
  */
-static void resetsliplist(void)
+static void resetsliplist(msengine *ms)
 {
-    slipcount = 0;
+    int	n;
+
+    for (n = 0 ; n < ms->slipcount ; ++n)
+	ms->slips[n].cr->slipindex = -1;
+    ms->slipcount = 0;
 }
 
-/* Append the given creature to the end of the slip list.
+/* Append the given creature to the end of the slip list. Each
+ * creature on the list remembers its position in slipindex, so that
+ * it never has to be searched for. (Only Chip is ever added to the
+ * start of the list, so he can only ever be found at the front.)
  */
-static creature *appendtosliplist(creature *cr, int dir)
+static creature *appendtosliplist(msengine *ms, creature *cr, int dir)
 {
-    int	n;
-
-    for (n = 0 ; n < slipcount ; ++n) {
-	if (slips[n].cr == cr) {
-	    slips[n].dir = dir;
-	    return cr;
-	}
+    if (cr->slipindex >= 0) {
+	ms->slips[cr->slipindex].dir = dir;
+	return cr;
     }
 
-    if (slipcount >= slipsallocated) {
-	slipsallocated = slipsallocated ? slipsallocated * 2 : 16;
-	slips = realloc(slips, slipsallocated * sizeof *slips);
-	if (!slips)
+    if (ms->slipcount >= ms->slipsallocated) {
+	ms->slipsallocated = ms->slipsallocated ? ms->slipsallocated * 2 : 16;
+	ms->slips = realloc(ms->slips, ms->slipsallocated * sizeof *ms->slips);
+	if (!ms->slips)
 	    memerrexit();
     }
-    slips[slipcount].cr = cr;
-    slips[slipcount].dir = dir;
-    ++slipcount;
+    ms->slips[ms->slipcount].cr = cr;
+    ms->slips[ms->slipcount].dir = dir;
+    cr->slipindex = ms->slipcount++;
     return cr;
 }
 
 /* Add the given creature to the start of the slip list.
  */
-static creature *prependtosliplist(creature *cr, int dir)
+static creature *prependtosliplist(msengine *ms, creature *cr, int dir)
 {
     int	n;
 
-    if (slipcount && slips[0].cr == cr) {
-	slips[0].dir = dir;
+    if (cr->slipindex == 0) {
+	ms->slips[0].dir = dir;
 	return cr;
     }
+    _assert(cr->slipindex < 0);
 
-    if (slipcount >= slipsallocated) {
-	slipsallocated = slipsallocated ? slipsallocated * 2 : 16;
-	slips = realloc(slips, slipsallocated * sizeof *slips);
-	if (!slips)
+    if (ms->slipcount >= ms->slipsallocated) {
+	ms->slipsallocated = ms->slipsallocated ? ms->slipsallocated * 2 : 16;
+	ms->slips = realloc(ms->slips, ms->slipsallocated * sizeof *ms->slips);
+	if (!ms->slips)
 	    memerrexit();
     }
-    for (n = slipcount ; n ; --n)
-	slips[n] = slips[n - 1];
-    ++slipcount;
-    slips[0].cr = cr;
-    slips[0].dir = dir;
+    for (n = ms->slipcount ; n ; --n) {
+	ms->slips[n] = ms->slips[n - 1];
+	ms->slips[n].cr->slipindex = n;
+    }
+    ++ms->slipcount;
+    ms->slips[0].cr = cr;
+    ms->slips[0].dir = dir;
+    cr->slipindex = 0;
     return cr;
 }
 
 /* Return the sliding direction of a creature on the slip list.
  */
-static int getslipdir(creature *cr)
+static int getslipdir(msengine *ms, creature *cr)
 {
-    int	n;
-
-    for (n = 0 ; n < slipcount ; ++n)
-	if (slips[n].cr == cr)
-	    return slips[n].dir;
-    return NIL;
+    return cr->slipindex >= 0 ? ms->slips[cr->slipindex].dir : NIL;
 }
 
 /* Remove the given creature from the slip list.
  */
-static void removefromsliplist(creature *cr)
+static void removefromsliplist(msengine *ms, creature *cr)
 {
     int	n;
 
-    for (n = 0 ; n < slipcount ; ++n)
-	if (slips[n].cr == cr)
-	    break;
-    if (n == slipcount)
+    n = cr->slipindex;
+    if (n < 0)
 	return;
-    --slipcount;
-    for ( ; n < slipcount ; ++n)
-	slips[n] = slips[n + 1];
+    cr->slipindex = -1;
+    --ms->slipcount;
+    for ( ; n < ms->slipcount ; ++n) {
+	ms->slips[n] = ms->slips[n + 1];
+	ms->slips[n].cr->slipindex = n;
+    }
 }
 
-void resetdeferstack()
+/* Empty the stack of deferred button presses.
+ */
+static void resetdeferstack(msengine *ms)
 {
-    defercount = 0;
+    ms->defercount = 0;
 }
 
-void pushdeferstack(int pos, unsigned char id)
+/* Push a deferred button press onto the stack.
+ */
+static void pushdeferstack(msengine *ms, int pos, unsigned char id)
 {
-    if (defercount >= defersallocated) {
-   defersallocated = defersallocated ? defersallocated * 2 : 16;
-   defers = realloc(defers, defersallocated * sizeof *defers);
-   if (!defers)
-       memerrexit();
+    if (ms->defercount >= ms->defersallocated) {
+	ms->defersallocated = ms->defersallocated ? ms->defersallocated * 2
+						  : 16;
+	ms->defers = realloc(ms->defers,
+			     ms->defersallocated * sizeof *ms->defers);
+	if (!ms->defers)
+	    memerrexit();
     }
-    defers[defercount].pos = pos;
-    defers[defercount].id = id;
-    ++defercount;
+    ms->defers[ms->defercount].pos = pos;
+    ms->defers[ms->defercount].id = id;
+    ++ms->defercount;
 }
 
-deferredbutton *popdeferstack()
+/* Pop the most recent deferred button press off of the stack, or
+ * return NULL if the stack is empty.
+ */
+static deferredbutton *popdeferstack(msengine *ms)
 {
-    if (defercount <= 0)
-   return NULL;
+    if (ms->defercount <= 0)
+	return NULL;
 
-    return &defers[--defercount];
+    return &ms->defers[--ms->defercount];
 }
 
 /*
@@ -408,7 +582,7 @@ deferredbutton *popdeferstack()
 /* Translate a slide floor into the direction it points in. In the
  * case of a random slide floor, a new direction is selected.
  */
-static int getslidedir(int floor)
+static int getslidedir(msengine *ms, int floor)
 {
     switch (floor) {
       case Slide_North:		return NORTH;
@@ -439,35 +613,83 @@ static int icewallturn(int floor, int dir)
 
 /* Find the location of a bear trap from one of its buttons.
  */
-static int trapfrombutton(int pos)
+static int trapfrombutton(msengine *ms, int pos)
 {
-    xyconn     *traps;
-    int		i;
-
-    traps = traplist();
-    for (i = traplistsize() ; i ; ++traps, --i)
-	if (traps->from == pos)
-	    return traps->to;
-    return -1;
+    if (pos < 0 || pos >= CXGRID * CYGRID)
+	return -1;
+    return ms->trapwiring[pos];
 }
 
 /* Find the location of a clone machine from one of its buttons.
  */
-static int clonerfrombutton(int pos)
+static int clonerfrombutton(msengine *ms, int pos)
 {
-    xyconn     *cloners;
-    int		i;
+    if (pos < 0 || pos >= CXGRID * CYGRID)
+	return -1;
+    return ms->clonerwiring[pos];
+}
 
-    cloners = clonerlist();
-    for (i = clonerlistsize() ; i ; ++cloners, --i)
-	if (cloners->from == pos)
-	    return cloners->to;
-    return -1;
+/* Return TRUE if any button is wired to a beartrap at the given
+ * location.
+ */
+static int istrapwired(msengine *ms, int pos)
+{
+    return pos >= 0 && pos < CXGRID * CYGRID && ms->trapbuttons[pos] >= 0;
+}
+
+/* Draw up the tables that map each button to what it is wired to and
+ * each beartrap to its buttons, the list of teleports in the order
+ * they are searched, and the list of locations with toggle walls. The
+ * wirings never change once the level begins, and teleports and
+ * toggle walls are never created (one that is broken or buried is
+ * still on its list, and is skipped over when it is reached), so the
+ * tables stay valid for the entire game. Where a button appears more
+ * than once in a list, only its first wiring is used, as before.
+ */
+static void buildwiring(msengine *ms)
+{
+    mapcell    *cell;
+    xyconn     *xy;
+    int		pos, n;
+
+    for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos) {
+	ms->trapwiring[pos] = -1;
+	ms->clonerwiring[pos] = -1;
+	ms->trapbuttons[pos] = -1;
+    }
+    for (n = traplistsize() - 1, xy = traplist() + n ; n >= 0 ; --n, --xy) {
+	if (xy->from >= 0 && xy->from < CXGRID * CYGRID)
+	    ms->trapwiring[xy->from] = xy->to;
+	if (xy->to >= 0 && xy->to < CXGRID * CYGRID) {
+	    ms->nexttrapbutton[n] = ms->trapbuttons[xy->to];
+	    ms->trapbuttons[xy->to] = n;
+	}
+    }
+    for (n = clonerlistsize() - 1, xy = clonerlist() + n ; n >= 0 ; --n, --xy)
+	if (xy->from >= 0 && xy->from < CXGRID * CYGRID)
+	    ms->clonerwiring[xy->from] = xy->to;
+
+    ms->teleportcount = 0;
+    for (pos = 0, cell = ms->state->map ; pos < CXGRID * CYGRID ;
+						       ++pos, ++cell) {
+	ms->teleportsbefore[pos] = ms->teleportcount;
+	if (cell->top.id == Teleport || cell->bot.id == Teleport)
+	    ms->teleports[ms->teleportcount++] = pos;
+    }
+
+    ms->switchwallcount = 0;
+    for (pos = 0, cell = ms->state->map ; pos < CXGRID * CYGRID ;
+						       ++pos, ++cell) {
+	if (cell->top.id == SwitchWall_Open || cell->top.id == SwitchWall_Closed
+					    || cell->bot.id == SwitchWall_Open
+					    || cell->bot.id == SwitchWall_Closed)
+	    ms->switchwalls[ms->switchwallcount++] = pos;
+    }
 }
 
 /* Return the floor tile found at the given location.
  */
-static int floorat(int pos)
+static int floorat(msengine *ms, int pos)
 {
     mapcell    *cell;
 
@@ -484,7 +706,7 @@ static int floorat(int pos)
 /* Return a pointer to the tile that forms the floor at the given
  * location.
  */
-static maptile *getfloorat(int pos)
+static maptile *getfloorat(msengine *ms, int pos)
 {
     mapcell    *cell;
 
@@ -501,7 +723,7 @@ static maptile *getfloorat(int pos)
 /* Return TRUE if the brown button at the give location is currently
  * held down.
  */
-static int istrapbuttondown(int pos)
+static int istrapbuttondown(msengine *ms, int pos)
 {
     return pos >= 0 && pos < CXGRID * CYGRID
 		    && cellat(pos)->top.id != Button_Brown;
@@ -510,10 +732,11 @@ static int istrapbuttondown(int pos)
 /* Place a new tile at the given location, causing the current upper
  * tile to become the lower tile.
  */
-static void pushtile(int pos, maptile tile)
+static void pushtile(msengine *ms, int pos, maptile tile)
 {
     mapcell    *cell;
 
+    cellchanged(pos);
     cell = cellat(pos);
     cell->bot = cell->top;
     cell->top = tile;
@@ -522,11 +745,12 @@ static void pushtile(int pos, maptile tile)
 /* Remove the upper tile from the given location, causing the current
  * lower tile to become uppermost.
  */
-static maptile poptile(int pos)
+static maptile poptile(msengine *ms, int pos)
 {
     maptile	tile;
     mapcell    *cell;
 
+    cellchanged(pos);
     cell = cellat(pos);
     tile = cell->top;
     cell->top = cell->bot;
@@ -537,28 +761,30 @@ static maptile poptile(int pos)
 
 /* Return TRUE if a bear trap is currently passable.
  */
-static int istrapopen(int pos, int skippos)
+static int istrapopen(msengine *ms, int pos, int skippos)
 {
     xyconn     *traps;
-    int		i;
+    int		n;
 
+    if (pos < 0 || pos >= CXGRID * CYGRID)
+	return FALSE;
     traps = traplist();
-    for (i = traplistsize() ; i ; ++traps, --i)
-	if (traps->to == pos && traps->from != skippos
-			     && istrapbuttondown(traps->from))
+    for (n = ms->trapbuttons[pos] ; n >= 0 ; n = ms->nexttrapbutton[n])
+	if (traps[n].from != skippos && istrapbuttondown(ms, traps[n].from))
 	    return TRUE;
     return FALSE;
 }
 
 /* Flip-flop the state of any toggle walls.
  */
-static void togglewalls(void)
+static void togglewalls(msengine *ms)
 {
     mapcell    *cell;
-    int		pos;
+    int		n;
 
-    for (pos = 0 ; pos < CXGRID * CYGRID ; ++pos) {
-	cell = cellat(pos);
+    for (n = 0 ; n < ms->switchwallcount ; ++n) {
+	cellchanged(ms->switchwalls[n]);
+	cell = cellat(ms->switchwalls[n]);
 	if ((cell->top.id == SwitchWall_Open
 				|| cell->top.id == SwitchWall_Closed)
 			&& !(cell->top.state & FS_BROKEN))
@@ -588,20 +814,14 @@ static void togglewalls(void)
 /* Return the creature located at pos. Ignores Chip unless includechip
  * is TRUE. Return NULL if no such creature is present.
  */
-static creature *lookupcreature(int pos, int includechip)
+static creature *lookupcreature(msengine *ms, int pos, int includechip)
 {
-    int	n;
-
-    if (!creatures)
+    if (!ms->creatures || !ms->creaturecount)
 	return NULL;
-    for (n = 0 ; n < creaturecount ; ++n) {
-	if (creatures[n]->hidden)
-	    continue;
-	if (creatures[n]->pos == pos)
-	    if (creatures[n]->id != Chip || includechip)
-		return creatures[n];
-    }
-    return NULL;
+    if (includechip && getchip()->pos == pos && !getchip()->hidden)
+	return getchip();
+    return lookupposindex(&ms->crindex, ms->creatures,
+			  1, ms->creaturecount, pos);
 }
 
 /* Return the block located at pos. If the block in question is not
@@ -609,18 +829,16 @@ static creature *lookupcreature(int pos, int includechip)
  * list. (Why is a block on a beartrap automatically released? Or
  * rather, why is this done in this function? I don't know.)
  */
-static creature *lookupblock(int pos)
+static creature *lookupblock(msengine *ms, int pos)
 {
     creature   *cr;
-    int		id, n;
+    int		id;
 
-    if (blocks) {
-	for (n = 0 ; n < blockcount ; ++n)
-	    if (blocks[n]->pos == pos && !blocks[n]->hidden)
-		return blocks[n];
-    }
+    cr = lookupposindex(&ms->blockindex, ms->blocks, 0, ms->blockcount, pos);
+    if (cr)
+	return cr;
 
-    cr = allocatecreature();
+    cr = allocatecreature(ms);
     cr->id = Block;
     cr->pos = pos;
     id = cellat(pos)->top.id;
@@ -639,28 +857,23 @@ static creature *lookupblock(int pos)
     else
 	_assert(!"lookupblock() called on blockless location");
 
-    if (cellat(pos)->bot.id == Beartrap) {
-	for (n = 0 ; n < traplistsize() ; ++n) {
-	    if (traplist()[n].to == cr->pos) {
-		cr->state |= CS_RELEASED;
-		break;
-	    }
-	}
-    }
+    if (cellat(pos)->bot.id == Beartrap && istrapwired(ms, cr->pos))
+	cr->state |= CS_RELEASED;
 
-    return addtoblocklist(cr);
+    return addtoblocklist(ms, cr);
 }
 
 /* Update the given creature's tile on the map to reflect its current
  * state.
  */
-static void updatecreature(creature const *cr)
+static void updatecreature(msengine *ms, creature const *cr)
 {
     maptile    *tile;
     int		id, dir;
 
     if (cr->hidden)
 	return;
+    cellchanged(cr->pos);
     tile = &cellat(cr->pos)->top;
     id = cr->id;
     if (id == Block) {
@@ -692,19 +905,19 @@ static void updatecreature(creature const *cr)
 
 /* Add the given creature's tile to the map.
  */
-static void addcreaturetomap(creature const *cr)
+static void addcreaturetomap(msengine *ms, creature const *cr)
 {
     static maptile const dummy = { Empty, 0 };
 
     if (cr->hidden)
 	return;
-    pushtile(cr->pos, dummy);
-    updatecreature(cr);
+    pushtile(ms, cr->pos, dummy);
+    updatecreature(ms, cr);
 }
 
 /* Enervate an inert creature.
  */
-static creature *awakencreature(int pos)
+static creature *awakencreature(msengine *ms, int pos)
 {
     creature   *new;
     int		tileid;
@@ -712,16 +925,17 @@ static creature *awakencreature(int pos)
     tileid = cellat(pos)->top.id;
     if (!iscreature(tileid) || creatureid(tileid) == Chip)
 	return NULL;
-    new = allocatecreature();
+    new = allocatecreature(ms);
     new->id = creatureid(tileid);
     new->dir = creaturedirid(tileid);
     new->pos = pos;
-    return isblock(new->id) ? addtoblocklist(new) : addtocreaturelist(new);
+    return isblock(new->id) ? addtoblocklist(ms, new)
+			    : addtocreaturelist(ms, new);
 }
 
 /* Mark a creature as dead.
  */
-static void removecreature(creature *cr)
+static void removecreature(msengine *ms, creature *cr)
 {
     cr->state &= ~(CS_SLIP | CS_SLIDE);
     if (cr->id == Chip) {
@@ -730,33 +944,35 @@ static void removecreature(creature *cr)
             warn("lolwut");
 	    chipstatus() = CHIP_NOTOKAY;
         }
-    } else
+    } else {
+	vacate(ms, cr);
 	cr->hidden = TRUE;
+    }
 }
 
 /* Turn around any and all tanks. (A tank that is halfway through the
  * process of moving at the time is given special treatment.)
  */
-static void turntanks(creature const *inmidmove)
+static void turntanks(msengine *ms, creature const *inmidmove)
 {
     int	n;
 
-    for (n = 0 ; n < creaturecount ; ++n) {
-	if (creatures[n]->hidden || creatures[n]->id != Tank)
+    for (n = 0 ; n < ms->creaturecount ; ++n) {
+	if (ms->creatures[n]->hidden || ms->creatures[n]->id != Tank)
 	    continue;
-	creatures[n]->dir = back(creatures[n]->dir);
-	if (!(creatures[n]->state & CS_TURNING))
-	    creatures[n]->state |= CS_TURNING | CS_HASMOVED;
-	if (creatures[n] != inmidmove) {
-	    if (creatureid(cellat(creatures[n]->pos)->top.id) == Tank) {
-		updatecreature(creatures[n]);
+	ms->creatures[n]->dir = back(ms->creatures[n]->dir);
+	if (!(ms->creatures[n]->state & CS_TURNING))
+	    ms->creatures[n]->state |= CS_TURNING | CS_HASMOVED;
+	if (ms->creatures[n] != inmidmove) {
+	    if (creatureid(cellat(ms->creatures[n]->pos)->top.id) == Tank) {
+		updatecreature(ms, ms->creatures[n]);
 	    } else {
-		if (creatures[n]->state & CS_TURNING) {
-		    creatures[n]->state &= ~CS_TURNING;
-		    updatecreature(creatures[n]);
-		    creatures[n]->state |= CS_TURNING;
+		if (ms->creatures[n]->state & CS_TURNING) {
+		    ms->creatures[n]->state &= ~CS_TURNING;
+		    updatecreature(ms, ms->creatures[n]);
+		    ms->creatures[n]->state |= CS_TURNING;
 		}
-		creatures[n]->dir = back(creatures[n]->dir);
+		ms->creatures[n]->dir = back(ms->creatures[n]->dir);
 	    }
 	}
     }
@@ -769,7 +985,7 @@ static void turntanks(creature const *inmidmove)
 /* Add the given creature to the slip list if it is not already on it
  * (assuming that the given floor is a kind that causes slipping).
  */
-static void startfloormovement(creature *cr, int floor)
+static void startfloormovement(msengine *ms, creature *cr, int floor)
 {
     int	dir;
 
@@ -778,7 +994,7 @@ static void startfloormovement(creature *cr, int floor)
     if (isice(floor))
 	dir = icewallturn(floor, cr->dir);
     else if (isslide(floor))
-	dir = getslidedir(floor);
+	dir = getslidedir(ms, floor);
     else if (floor == Teleport)
 	dir = cr->dir;
     else if (floor == Beartrap && isblock(cr->id))
@@ -788,32 +1004,32 @@ static void startfloormovement(creature *cr, int floor)
 
     if (cr->id == Chip) {
 	cr->state |= isslide(floor) ? CS_SLIDE : CS_SLIP;
-	prependtosliplist(cr, dir);
+	prependtosliplist(ms, cr, dir);
 	cr->dir = dir;
-	updatecreature(cr);
+	updatecreature(ms, cr);
     } else {
 	cr->state |= CS_SLIP;
-	appendtosliplist(cr, dir);
+	appendtosliplist(ms, cr, dir);
     }
 }
 
 /* Remove the given creature from the slip list.
  */
-static void endfloormovement(creature *cr)
+static void endfloormovement(msengine *ms, creature *cr)
 {
     cr->state &= ~(CS_SLIP | CS_SLIDE);
-    removefromsliplist(cr);
+    removefromsliplist(ms, cr);
 }
 
 /* Clean out deadwood entries in the slip list.
  */
-static void updatesliplist()
+static void updatesliplist(msengine *ms)
 {
     int	n;
 
-    for (n = slipcount - 1 ; n >= 0 ; --n)
-	if (!(slips[n].cr->state & (CS_SLIP | CS_SLIDE)))
-	    endfloormovement(slips[n].cr);
+    for (n = ms->slipcount - 1 ; n >= 0 ; --n)
+	if (!(ms->slips[n].cr->state & (CS_SLIP | CS_SLIDE)))
+	    endfloormovement(ms, ms->slips[n].cr);
 }
 
 /*
@@ -927,7 +1143,7 @@ static struct { unsigned char chip, block, creature; } const movelaws[] = {
 /* Move a block at the given position forward in the given direction.
  * FALSE is returned if the block cannot be pushed.
  */
-static int pushblock(int pos, int dir, int flags)
+static int pushblock(msengine *ms, int pos, int dir, int flags)
 {
     creature   *cr;
     int		slipdir, r;
@@ -935,13 +1151,13 @@ static int pushblock(int pos, int dir, int flags)
     _assert(cellat(pos)->top.id == Block_Static || cellat(pos)->top.id == IceBlock_Static);
     _assert(dir != NIL);
 
-    cr = lookupblock(pos);
+    cr = lookupblock(ms, pos);
     if (!cr) {
 	warn("%d: attempt to push disembodied block!", currenttime());
 	return FALSE;
     }
     if (cr->state & (CS_SLIP | CS_SLIDE)) {
-	slipdir = getslipdir(cr);
+	slipdir = getslipdir(ms, cr);
 	if (dir == slipdir || dir == back(slipdir))
 	    if (!(flags & CMM_TELEPORTPUSH))
 		return FALSE;
@@ -950,11 +1166,13 @@ static int pushblock(int pos, int dir, int flags)
     if (flags & CMM_NOPUSHING)
 	return FALSE;
 
-    if (!(flags & CMM_TELEPORTPUSH) && (cellat(pos)->bot.id == Block_Static || cellat(pos)->bot.id == IceBlock_Static))
+    if (!(flags & CMM_TELEPORTPUSH) && (cellat(pos)->bot.id == Block_Static || cellat(pos)->bot.id == IceBlock_Static)) {
+	cellchanged(pos);
 	cellat(pos)->bot.id = Empty;
+    }
     if (!(flags & CMM_NODEFERBUTTONS))
 	cr->state |= CS_DEFERPUSH;
-    r = advancecreature(cr, dir);
+    r = advancecreature(ms, cr, dir);
     if (!(flags & CMM_NODEFERBUTTONS))
 	cr->state &= ~CS_DEFERPUSH;
     if (!r)
@@ -966,7 +1184,7 @@ static int pushblock(int pos, int dir, int flags)
  * the given direction. Side effects can and will occur from calling
  * this function, as indicated by flags.
  */
-static int canmakemove(creature const *cr, int dir, int flags)
+static int canmakemove(msengine *ms, creature const *cr, int dir, int flags)
 {
     int		to;
     int		floor;
@@ -1000,7 +1218,7 @@ static int canmakemove(creature const *cr, int dir, int flags)
 	}
     }
 
-    floor = floorat(to);
+    floor = floorat(ms, to);
     if (isanimation(floor))
 	warn("What the hell is going on here? animation %02X at (%d %d)",
 	     floor, to % CXGRID, to / CXGRID);
@@ -1008,7 +1226,7 @@ static int canmakemove(creature const *cr, int dir, int flags)
 	return FALSE;
 
     if (cr->id == Chip) {
-	floor = floorat(to);
+	floor = floorat(ms, to);
 	if (!(movelaws[floor].chip & dir))
 	    return FALSE;
 	if (floor == Socket && chipsneeded() > 0)
@@ -1021,29 +1239,31 @@ static int canmakemove(creature const *cr, int dir, int flags)
 		return FALSE;
 	}
 	if (floor == HiddenWall_Temp || floor == BlueWall_Real) {
-	    if (!(flags & CMM_NOEXPOSEWALLS))
-		getfloorat(to)->id = Wall;
+	    if (!(flags & CMM_NOEXPOSEWALLS)) {
+		cellchanged(to);
+		getfloorat(ms, to)->id = Wall;
+	    }
 	    return FALSE;
 	}
 	if (floor == Block_Static) {
-	    if (!pushblock(to, dir, flags))
+	    if (!pushblock(ms, to, dir, flags))
 		return FALSE;
 	    else if (flags & CMM_NOPUSHING)
 		return TRUE;
-	    if ((flags & CMM_TELEPORTPUSH) && floorat(to) == Block_Static
+	    if ((flags & CMM_TELEPORTPUSH) && floorat(ms, to) == Block_Static
 					   && cellat(to)->bot.id == Empty)
 		    return TRUE;
-	    return canmakemove(cr, dir, flags | CMM_NOPUSHING);
+	    return canmakemove(ms, cr, dir, flags | CMM_NOPUSHING);
 	}
 	if (floor == IceBlock_Static) {
-	    if (!pushblock(to, dir, flags))
+	    if (!pushblock(ms, to, dir, flags))
 	        return FALSE;
 	    else if (flags & CMM_NOPUSHING)
 		return TRUE;
-	    if ((flags & CMM_TELEPORTPUSH) && floorat(to) == IceBlock_Static
+	    if ((flags & CMM_TELEPORTPUSH) && floorat(ms, to) == IceBlock_Static
 					   && cellat(to)->bot.id == Empty)
 		return TRUE;
-	    return canmakemove(cr, dir, flags | CMM_NOPUSHING);
+	    return canmakemove(ms, cr, dir, flags | CMM_NOPUSHING);
 	}
     } else if (cr->id == Block) {
 	floor = cellat(to)->top.id;
@@ -1063,11 +1283,11 @@ static int canmakemove(creature const *cr, int dir, int flags)
 	    return id == Chip || id == Swimming_Chip;
 	}
 	if (floor == IceBlock_Static) {
-	    if (!pushblock(to, dir, flags))
+	    if (!pushblock(ms, to, dir, flags))
 		return FALSE;
 	    else if (flags & CMM_NOPUSHING)
 		return TRUE;
-	    return canmakemove(cr, dir, flags | CMM_NOPUSHING);
+	    return canmakemove(ms, cr, dir, flags | CMM_NOPUSHING);
 	}
 	if (floor == Dirt) {
 	    return TRUE;
@@ -1095,11 +1315,11 @@ static int canmakemove(creature const *cr, int dir, int flags)
 	if (floor == IceBlock_Static && (cr->id == Teeth || (cr->id == Tank))) {
 	    //if (flags & CMM_CLONECANTBLOCK)
 	    //return FALSE; // Ice Blocks block clone machines
-	    if (!pushblock(to, dir, flags))
+	    if (!pushblock(ms, to, dir, flags))
 		return FALSE;
 	    else if (flags & CMM_NOPUSHING)
 		return TRUE;
-	    return canmakemove(cr, dir, flags | CMM_NOPUSHING);
+	    return canmakemove(ms, cr, dir, flags | CMM_NOPUSHING);
 	}
 	if (!(movelaws[floor].creature & dir))
 	    return FALSE;
@@ -1124,7 +1344,7 @@ static int canmakemove(creature const *cr, int dir, int flags)
  * calling this function also updates the current controller
  * direction.
  */
-static void choosecreaturemove(creature *cr)
+static void choosecreaturemove(msengine *ms, creature *cr)
 {
     int		choices[4] = { NIL, NIL, NIL, NIL };
     int		dir, pdir;
@@ -1145,7 +1365,7 @@ static void choosecreaturemove(creature *cr)
     }
     if (cr->state & CS_TURNING) {
 	cr->state &= ~(CS_TURNING | CS_HASMOVED);
-	updatecreature(cr);
+	updatecreature(ms, cr);
     }
     if (cr->state & CS_HASMOVED) {
 	controllerdir() = NIL;
@@ -1154,7 +1374,7 @@ static void choosecreaturemove(creature *cr)
     if (cr->state & (CS_SLIP | CS_SLIDE))
 	return;
 
-    floor = floorat(cr->pos);
+    floor = floorat(ms, cr->pos);
 
     pdir = dir = cr->dir;
 
@@ -1261,7 +1481,7 @@ static void choosecreaturemove(creature *cr)
     for (n = 0 ; n < 4 && choices[n] != NIL ; ++n) {
 	cr->tdir = choices[n];
 	controllerdir() = cr->tdir;
-	if (canmakemove(cr, choices[n], 0))
+	if (canmakemove(ms, cr, choices[n], 0))
 	    return;
     }
 
@@ -1276,7 +1496,7 @@ static void choosecreaturemove(creature *cr)
 
 /* Select a direction for Chip to move towards the goal position.
  */
-static int chipmovetogoalpos(void)
+static int chipmovetogoalpos(msengine *ms)
 {
     creature   *cr;
     int		dir, d1, d2;
@@ -1304,7 +1524,7 @@ static int chipmovetogoalpos(void)
 	d2 = dir;
     }
     if (d1 != NIL && d2 != NIL)
-	dir = canmakemove(cr, d1, 0) ? d1 : d2;
+	dir = canmakemove(ms, cr, d1, 0) ? d1 : d2;
     else
 	dir = d2 == NIL ? d1 : d2;
 
@@ -1313,7 +1533,7 @@ static int chipmovetogoalpos(void)
 
 /* Translate a map position into a packed location relative to Chip.
  */
-static int makemouserelative(int abspos)
+static int makemouserelative(msengine *ms, int abspos)
 {
     int	x, y;
 
@@ -1326,7 +1546,7 @@ static int makemouserelative(int abspos)
 
 /* Unpack a Chip-relative map location.
  */
-static int makemouseabsolute(int relpos)
+static int makemouseabsolute(msengine *ms, int relpos)
 {
     int	x, y;
 
@@ -1339,7 +1559,7 @@ static int makemouseabsolute(int relpos)
  * then Chip is not currently permitted to select a direction of
  * movement, and the player's input should not be retained.
  */
-static void choosechipmove(creature *cr, int discard)
+static void choosechipmove(msengine *ms, creature *cr, int discard)
 {
     int	dir;
 
@@ -1368,11 +1588,11 @@ static void choosechipmove(creature *cr, int discard)
 
     if (dir >= CmdAbsMouseMoveFirst && dir <= CmdAbsMouseMoveLast) {
 	goalpos() = dir - CmdAbsMouseMoveFirst;
-	lastmove() = CmdMouseMoveFirst + makemouserelative(goalpos());
+	lastmove() = CmdMouseMoveFirst + makemouserelative(ms, goalpos());
 	dir = NIL;
     } else if (dir >= CmdMouseMoveFirst && dir <= CmdMouseMoveLast) {
 	lastmove() = dir;
-	goalpos() = makemouseabsolute(dir - CmdMouseMoveFirst);
+	goalpos() = makemouseabsolute(ms, dir - CmdMouseMoveFirst);
 	dir = NIL;
     } else {
 	if ((dir & (NORTH | SOUTH)) && (dir & (EAST | WEST)))
@@ -1381,18 +1601,20 @@ static void choosechipmove(creature *cr, int discard)
     }
 
     if (dir == NIL && hasgoal() && (currenttime() & 3) == 2)
-	dir = chipmovetogoalpos();
+	dir = chipmovetogoalpos(ms);
 
     cr->tdir = dir;
 }
 
 /* Teleport the given creature instantaneously from the teleport tile
- * at start to another teleport tile (if possible).
+ * at start to another teleport tile (if possible). The teleports are
+ * tried in reverse order of their location on the map, beginning with
+ * the one just before start.
  */
-static int teleportcreature(creature *cr, int start)
+static int teleportcreature(msengine *ms, creature *cr, int start)
 {
     maptile    *tile;
-    int		dest, origpos, f;
+    int		dest, origpos, f, i, n;
 
     _assert(!cr->hidden);
     if (cr->dir == NIL) {
@@ -1403,68 +1625,74 @@ static int teleportcreature(creature *cr, int start)
 
     origpos = cr->pos;
     dest = start;
+    i = ms->teleportsbefore[start];
 
-    for (;;) {
-	--dest;
-	if (dest < 0)
-	    dest += CXGRID * CYGRID;
+    for (n = ms->teleportcount ; n ; --n) {
+	if (!i)
+	    i = ms->teleportcount;
+	dest = ms->teleports[--i];
 	if (dest == start)
 	    break;
 	tile = &cellat(dest)->top;
 	if (tile->id != Teleport || (tile->state & FS_BROKEN))
 	    continue;
+	vacate(ms, cr);
 	cr->pos = dest;
-	f = canmakemove(cr, cr->dir, CMM_NOLEAVECHECK | CMM_NOEXPOSEWALLS
+	occupy(ms, cr);
+	f = canmakemove(ms, cr, cr->dir, CMM_NOLEAVECHECK | CMM_NOEXPOSEWALLS
 						      | CMM_NODEFERBUTTONS
 						      | CMM_TELEPORTPUSH);
+	vacate(ms, cr);
 	cr->pos = origpos;
+	occupy(ms, cr);
 	if (f)
-	    break;
+	    return dest;
     }
 
-    return dest;
+    return start;
 }
 
 /* Determine the move(s) a creature will make on the current tick.
  */
-static void choosemove(creature *cr)
+static void choosemove(msengine *ms, creature *cr)
 {
     if (cr->id == Chip) {
-	choosechipmove(cr, cr->state & CS_SLIP);
+	choosechipmove(ms, cr, cr->state & CS_SLIP);
     } else {
 	if (cr->state & CS_SLIP)
 	    cr->tdir = NIL;
 	else
-	    choosecreaturemove(cr);
+	    choosecreaturemove(ms, cr);
     }
 }
 
 /* Initiate the cloning of a creature.
  */
-static void activatecloner(int buttonpos)
+static void activatecloner(msengine *ms, int buttonpos)
 {
     creature	dummy;
     creature   *cr;
     int		pos, tileid;
 
-    pos = clonerfrombutton(buttonpos);
+    pos = clonerfrombutton(ms, buttonpos);
     if (pos < 0 || pos >= CXGRID * CYGRID)
 	return;
     tileid = cellat(pos)->top.id;
     if (!iscreature(tileid) || creatureid(tileid) == Chip)
 	return;
     if (creatureid(tileid) == Block) {
-	cr = lookupblock(pos);
+	cr = lookupblock(ms, pos);
 	if (cr->dir != NIL)
-	    advancecreature(cr, cr->dir);
+	    advancecreature(ms, cr, cr->dir);
     } else if (creatureid(tileid) == IceBlock) {
 	if (cellat(pos)->bot.state & FS_CLONING)
 	    return;
-	cr = lookupblock(pos);
+	cr = lookupblock(ms, pos);
 	if (cr->dir != NIL) {
+	    cellchanged(pos);
 	    if (cellat(pos)->bot.id == CloneMachine)
 		cellat(pos)->bot.state |= FS_CLONING;
-	    advancecreature(cr, cr->dir);
+	    advancecreature(ms, cr, cr->dir);
 	    if (cellat(pos)->bot.id == CloneMachine)
 		cellat(pos)->bot.state &= ~FS_CLONING;
 	}
@@ -1475,12 +1703,14 @@ static void activatecloner(int buttonpos)
 	dummy.id = creatureid(tileid);
 	dummy.dir = creaturedirid(tileid);
 	dummy.pos = pos;
-	if (!canmakemove(&dummy, dummy.dir, CMM_CLONECANTBLOCK | CMM_NOPUSHING))
+	if (!canmakemove(ms, &dummy, dummy.dir,
+			 CMM_CLONECANTBLOCK | CMM_NOPUSHING))
 	    return;
-	cr = awakencreature(pos);
+	cr = awakencreature(ms, pos);
 	if (!cr)
 	    return;
 	cr->state |= CS_CLONING;
+	cellchanged(pos);
 	if (cellat(pos)->bot.id == CloneMachine)
 	    cellat(pos)->bot.state |= FS_CLONING;
     }
@@ -1488,12 +1718,12 @@ static void activatecloner(int buttonpos)
 
 /* Open a bear trap. Any creature already in the trap is released.
  */
-static void springtrap(int buttonpos)
+static void springtrap(msengine *ms, int buttonpos)
 {
     creature   *cr;
     int		pos, id;
 
-    pos = trapfrombutton(buttonpos);
+    pos = trapfrombutton(ms, buttonpos);
     if (pos < 0)
 	return;
     if (pos >= CXGRID * CYGRID) {
@@ -1504,11 +1734,11 @@ static void springtrap(int buttonpos)
     id = cellat(pos)->top.id;
     if (id == Block_Static || id == IceBlock_Static
 			    || (cellat(pos)->bot.state & FS_HASMUTANT)) {
-	cr = lookupblock(pos);
+	cr = lookupblock(ms, pos);
 	if (cr)
 	    cr->state |= CS_RELEASED;
     } else if (iscreature(id)) {
-	cr = lookupcreature(pos, TRUE);
+	cr = lookupcreature(ms, pos, TRUE);
 	if (cr)
 	    cr->state |= CS_RELEASED;
     }
@@ -1516,32 +1746,32 @@ static void springtrap(int buttonpos)
 
 /* Mark all buttons everywhere as having been handled.
  */
-static void resetbuttons(void)
+static void resetbuttons(msengine *ms)
 {
-    resetdeferstack();
+    resetdeferstack(ms);
 }
 
 /* Apply the effects of all deferred button presses, if any.
  */
-static void handlebuttons(void)
+static void handlebuttons(msengine *ms)
 {
     deferredbutton *button;
 
-    while ((button = popdeferstack()) != NULL) {
+    while ((button = popdeferstack(ms)) != NULL) {
 	switch (button->id) {
 	  case Button_Blue:
 	    addsoundeffect(SND_BUTTON_PUSHED);
-	    turntanks(NULL);
+	    turntanks(ms, NULL);
 	    break;
 	  case Button_Green:
-	    togglewalls();
+	    togglewalls(ms);
 	    break;
 	  case Button_Red:
-	    activatecloner(button->pos);
+	    activatecloner(ms, button->pos);
 	    addsoundeffect(SND_BUTTON_PUSHED);
 	    break;
 	  case Button_Brown:
-	    springtrap(button->pos);
+	    springtrap(ms, button->pos);
 	    addsoundeffect(SND_BUTTON_PUSHED);
 	    break;
 	  default:
@@ -1559,26 +1789,28 @@ static void handlebuttons(void)
  * Return FALSE if the creature cannot initiate the indicated move
  * (side effects may still occur).
  */
-static int startmovement(creature *cr, int dir)
+static int startmovement(msengine *ms, creature *cr, int dir)
 {
     int	floor;
 
     _assert(dir != NIL);
 
     floor = cellat(cr->pos)->bot.id;
-    if (!canmakemove(cr, dir, 0)) {
+    if (!canmakemove(ms, cr, dir, 0)) {
 	if (cr->id == Chip || (floor != Beartrap && floor != CloneMachine
 						 && !(cr->state & CS_SLIP))) {
 	    cr->dir = dir;
-	    updatecreature(cr);
+	    updatecreature(ms, cr);
 	}
 	return FALSE;
     }
 
     if (floor == Beartrap) {
 	_assert(cr->state & CS_RELEASED);
-	if (cr->state & CS_MUTANT)
+	if (cr->state & CS_MUTANT) {
+	    cellchanged(cr->pos);
 	    cellat(cr->pos)->bot.state &= ~FS_HASMUTANT;
+	}
     }
     cr->state &= ~CS_RELEASED;
 
@@ -1592,7 +1824,7 @@ static int startmovement(creature *cr, int dir)
  * is also the only place where a creature can be added to the slip
  * list.
  */
-static void endmovement(creature *cr, int dir)
+static void endmovement(msengine *ms, creature *cr, int dir)
 {
     static int const delta[] = { 0, -CXGRID, -1, 0, +CXGRID, 0, 0, 0, +1 };
     mapcell    *cell;
@@ -1604,6 +1836,8 @@ static void endmovement(creature *cr, int dir)
 
     oldpos = cr->pos;
     newpos = cr->pos + delta[dir];
+    cellchanged(oldpos);
+    cellchanged(newpos);
 
     cell = cellat(newpos);
     tile = &cell->top;
@@ -1611,7 +1845,7 @@ static void endmovement(creature *cr, int dir)
     if (cr->id == Chip) {
 	switch (floor) {
 	  case Empty:
-	    poptile(newpos);
+	    poptile(ms, newpos);
 	    break;
 	  case Water:
 	    if (!possession(Boots_Water))
@@ -1622,10 +1856,10 @@ static void endmovement(creature *cr, int dir)
 		chipstatus() = CHIP_BURNED;
 	    break;
 	  case Dirt:
-	    poptile(newpos);
+	    poptile(ms, newpos);
 	    break;
 	  case BlueWall_Fake:
-	    poptile(newpos);
+	    poptile(ms, newpos);
 	    break;
 	  case PopupWall:
 	    tile->id = Wall;
@@ -1637,7 +1871,7 @@ static void endmovement(creature *cr, int dir)
 	    _assert(possession(floor));
 	    if (floor != Door_Green)
 		--possession(floor);
-	    poptile(newpos);
+	    poptile(ms, newpos);
 	    addsoundeffect(SND_DOOR_OPENED);
 	    break;
 	  case Boots_Ice:
@@ -1651,7 +1885,7 @@ static void endmovement(creature *cr, int dir)
 	    if (iscreature(cell->bot.id))
 		chipstatus() = CHIP_COLLIDED;
 	    ++possession(floor);
-	    poptile(newpos);
+	    poptile(ms, newpos);
 	    addsoundeffect(SND_ITEM_COLLECTED);
 	    break;
 	  case Burglar:
@@ -1664,12 +1898,12 @@ static void endmovement(creature *cr, int dir)
 	  case ICChip:
 	    if (chipsneeded())
 		--chipsneeded();
-	    poptile(newpos);
+	    poptile(ms, newpos);
 	    addsoundeffect(SND_IC_COLLECTED);
 	    break;
 	  case Socket:
 	    _assert(chipsneeded() == 0);
-	    poptile(newpos);
+	    poptile(ms, newpos);
 	    addsoundeffect(SND_SOCKET_OPENED);
 	    break;
 	  case Bomb:
@@ -1684,7 +1918,7 @@ static void endmovement(creature *cr, int dir)
     } else if (cr->id == Block) {
 	switch (floor) {
 	  case Empty:
-	    poptile(newpos);
+	    poptile(ms, newpos);
 	    break;
 	  case Water:
 	    tile->id = Dirt;
@@ -1698,13 +1932,13 @@ static void endmovement(creature *cr, int dir)
 	    break;
 	  case Teleport:
 	    if (!(tile->state & FS_BROKEN))
-		newpos = teleportcreature(cr, newpos);
+		newpos = teleportcreature(ms, cr, newpos);
 	    break;
 	}
     } else if (cr->id == IceBlock) {
 	switch (floor) {
 	  case Empty:
-	    poptile(newpos);
+	    poptile(ms, newpos);
 	    break;
 	  case Fire:
 	    tile->id = Water;
@@ -1716,7 +1950,7 @@ static void endmovement(creature *cr, int dir)
 	    addsoundeffect(SND_WATER_SPLASH);
 	    break;
 	  case Dirt:
-	    poptile(newpos);
+	    poptile(ms, newpos);
 	    break;
 	  case Bomb:
 	    tile->id = Empty;
@@ -1724,11 +1958,11 @@ static void endmovement(creature *cr, int dir)
 	    addsoundeffect(SND_BOMB_EXPLODES);
 	    break;
 	  case IceBlock_Static:
-	    endmovement(lookupblock(newpos), dir);
+	    endmovement(ms, lookupblock(ms, newpos), dir);
 	    break;
 	  case Teleport:
 	    if (!(tile->state & FS_BROKEN))
-	    newpos = teleportcreature(cr, newpos);
+	    newpos = teleportcreature(ms, cr, newpos);
 	    break;
 	}
     } else {
@@ -1752,15 +1986,15 @@ static void endmovement(creature *cr, int dir)
 	    break;
 	  case Teleport:
 	    if (!(tile->state & FS_BROKEN))
-		newpos = teleportcreature(cr, newpos);
+		newpos = teleportcreature(ms, cr, newpos);
 	    break;
 	}
     }
 
     if (cellat(oldpos)->bot.id != CloneMachine || cr->id == Chip)
-	poptile(oldpos);
+	poptile(ms, oldpos);
     if (dead) {
-	removecreature(cr);
+	removecreature(ms, cr);
 	if (cellat(oldpos)->bot.id == CloneMachine)
 	    cellat(oldpos)->bot.state &= ~FS_CLONING;
 	return;
@@ -1768,13 +2002,14 @@ static void endmovement(creature *cr, int dir)
 
     if (cr->id == Chip && floor == Teleport && !(tile->state & FS_BROKEN)) {
 	i = newpos;
-	newpos = teleportcreature(cr, newpos);
+	newpos = teleportcreature(ms, cr, newpos);
 	if (newpos != i) {
 	    addsoundeffect(SND_TELEPORTING);
-	    if (floorat(newpos) == Block_Static) {
+	    if (floorat(ms, newpos) == Block_Static) {
 		if (lastslipdir() == NIL) {
 		    cr->dir = NORTH;
-		    lookupblock(newpos)->state |= CS_MUTANT;
+		    lookupblock(ms, newpos)->state |= CS_MUTANT;
+		    cellchanged(newpos);
 		    cellat(newpos)->top.id = crtile(Chip, NORTH);
 		    floor = Empty;
 		} else {
@@ -1784,58 +2019,60 @@ static void endmovement(creature *cr, int dir)
 	}
     }
 
+    vacate(ms, cr);
     cr->pos = newpos;
-    addcreaturetomap(cr);
+    occupy(ms, cr);
+    addcreaturetomap(ms, cr);
+    vacate(ms, cr);
     cr->pos = oldpos;
+    occupy(ms, cr);
 
     tile = &cell->bot;
     switch (floor) {
       case Button_Blue:
 	if (cr->state & CS_DEFERPUSH)
-	    pushdeferstack(newpos, floor);
+	    pushdeferstack(ms, newpos, floor);
 	else
-	    turntanks(cr);
+	    turntanks(ms, cr);
 	addsoundeffect(SND_BUTTON_PUSHED);
 	break;
       case Button_Green:
 	if (cr->state & CS_DEFERPUSH)
-	    pushdeferstack(newpos, floor);
+	    pushdeferstack(ms, newpos, floor);
 	else
-	    togglewalls();
+	    togglewalls(ms);
 	break;
       case Button_Red:
-	if (cellat(clonerfrombutton(newpos))->bot.state & FS_CLONING)
+	if (cellat(clonerfrombutton(ms, newpos))->bot.state & FS_CLONING)
 	    break;
 	if (cr->state & CS_DEFERPUSH)
-	    pushdeferstack(newpos, floor);
+	    pushdeferstack(ms, newpos, floor);
 	else
-	    activatecloner(newpos);
+	    activatecloner(ms, newpos);
 	addsoundeffect(SND_BUTTON_PUSHED);
 	break;
       case Button_Brown:
 	if (cr->state & CS_DEFERPUSH)
-	    pushdeferstack(newpos, floor);
+	    pushdeferstack(ms, newpos, floor);
 	else
-	    springtrap(newpos);
+	    springtrap(ms, newpos);
 	addsoundeffect(SND_BUTTON_PUSHED);
 	break;
     }
 
+    vacate(ms, cr);
     cr->pos = newpos;
+    occupy(ms, cr);
 
     if (cellat(oldpos)->bot.id == CloneMachine)
 	cellat(oldpos)->bot.state &= ~FS_CLONING;
 
     if (floor == Beartrap) {
-	if (istrapopen(newpos, oldpos))
+	if (istrapopen(ms, newpos, oldpos))
 	    cr->state |= CS_RELEASED;
     } else if (cellat(newpos)->bot.id == Beartrap) {
-	for (i = 0 ; i < traplistsize() ; ++i) {
-	    if (traplist()[i].to == newpos) {
-		cr->state |= CS_RELEASED;
-		break;
-	    }
-	}
+	if (istrapwired(ms, newpos))
+	    cr->state |= CS_RELEASED;
     }
 
     if (cr->id == Chip) {
@@ -1860,25 +2097,25 @@ static void endmovement(creature *cr, int dir)
     wasslipping = cr->state & (CS_SLIP | CS_SLIDE);
 
     if (floor == Teleport)
-	startfloormovement(cr, floor);
+	startfloormovement(ms, cr, floor);
     else if (isice(floor) && (cr->id != Chip || !possession(Boots_Ice)))
-	startfloormovement(cr, floor);
+	startfloormovement(ms, cr, floor);
     else if (isslide(floor) && (cr->id != Chip || !possession(Boots_Slide)))
-	startfloormovement(cr, floor);
+	startfloormovement(ms, cr, floor);
     else if (floor == Beartrap && isblock(cr->id) && wasslipping) {
-	startfloormovement(cr, floor);
+	startfloormovement(ms, cr, floor);
 	if (cr->state & CS_MUTANT)
 	    cell->bot.state |= FS_HASMUTANT;
     } else
 	cr->state &= ~(CS_SLIP | CS_SLIDE);
 
     if (!wasslipping && (cr->state & (CS_SLIP | CS_SLIDE)) && cr->id != Chip)
-	controllerdir() = getslipdir(cr);
+	controllerdir() = getslipdir(ms, cr);
 }
 
 /* Move the given creature in the given direction.
  */
-static int advancecreature(creature *cr, int dir)
+static int advancecreature(msengine *ms, creature *cr, int dir)
 {
     if (dir == NIL)
 	return TRUE;
@@ -1886,25 +2123,25 @@ static int advancecreature(creature *cr, int dir)
     if (cr->id == Chip)
 	chipwait() = 0;
 
-    if (!startmovement(cr, dir)) {
+    if (!startmovement(ms, cr, dir)) {
 	if (cr->id == Chip) {
 	    addsoundeffect(SND_CANT_MOVE);
-	    resetbuttons();
+	    resetbuttons(ms);
 	    cancelgoal();
 	}
 	return FALSE;
     }
 
-    endmovement(cr, dir);
+    endmovement(ms, cr, dir);
     if (!(cr->state & CS_DEFERPUSH))
-	handlebuttons();
+	handlebuttons(ms);
 
     return TRUE;
 }
 
 /* Return TRUE if gameplay is over.
  */
-static int checkforending(void)
+static int checkforending(msengine *ms)
 {
     if (chipstatus() != CHIP_OKAY) {
 	addsoundeffect(SND_CHIP_LOSES);
@@ -1923,21 +2160,21 @@ static int checkforending(void)
 
 /* Execute all forced moves for creatures on the slip list.
  */
-static void floormovements(void)
+static void floormovements(msengine *ms)
 {
     creature   *cr;
     int		floor, slipdir;
     int		savedcount, n;
 
-    for (n = 0 ; n < slipcount ; ++n) {
-	savedcount = slipcount;
-	cr = slips[n].cr;
-	if (!(slips[n].cr->state & (CS_SLIP | CS_SLIDE)))
+    for (n = 0 ; n < ms->slipcount ; ++n) {
+	savedcount = ms->slipcount;
+	cr = ms->slips[n].cr;
+	if (!(ms->slips[n].cr->state & (CS_SLIP | CS_SLIDE)))
 	    continue;
-	slipdir = getslipdir(cr);
+	slipdir = getslipdir(ms, cr);
 	if (slipdir == NIL)
 	    continue;
-	if (advancecreature(cr, slipdir)) {
+	if (advancecreature(ms, cr, slipdir)) {
 	    if (cr->id == Chip) {
 		cr->state &= ~CS_HASMOVED;
 		lastslipdir() = slipdir;
@@ -1946,7 +2183,7 @@ static void floormovements(void)
 	    floor = cellat(cr->pos)->bot.id;
 	    if (isice(floor) || (floor == Teleport && cr->id == Chip)) {
 		slipdir = icewallturn(floor, back(slipdir));
-		if (advancecreature(cr, slipdir)) {
+		if (advancecreature(ms, cr, slipdir)) {
 		    if (cr->id == Chip)
 			cr->state &= ~CS_HASMOVED;
 		}
@@ -1955,25 +2192,25 @@ static void floormovements(void)
 		    cr->state &= ~CS_HASMOVED;
 	    }
 	    if (cr->state & (CS_SLIP | CS_SLIDE)) {
-		endfloormovement(cr);
-		startfloormovement(cr, cellat(cr->pos)->bot.id);
+		endfloormovement(ms, cr);
+		startfloormovement(ms, cr, cellat(cr->pos)->bot.id);
 	    }
 	}
-	if (checkforending())
+	if (checkforending(ms))
 	    return;
 	if (!(cr->state & (CS_SLIP | CS_SLIDE)) && cr->id != Chip
-						&& slipcount == savedcount + 1)
+					    && ms->slipcount == savedcount + 1)
 	    ++n;
     }
 }
 
-static void createclones(void)
+static void createclones(msengine *ms)
 {
     int	n;
 
-    for (n = 0 ; n < creaturecount ; ++n)
-	if (creatures[n]->state & CS_CLONING)
-	    creatures[n]->state &= ~CS_CLONING;
+    for (n = 0 ; n < ms->creaturecount ; ++n)
+	if (ms->creatures[n]->state & CS_CLONING)
+	    ms->creatures[n]->state &= ~CS_CLONING;
 }
 
 #ifndef NDEBUG
@@ -1984,7 +2221,7 @@ static void createclones(void)
 
 /* Print out a rough image of the level and the list of creatures.
  */
-static void dumpmap(void)
+static void dumpmap(msengine *ms)
 {
     creature   *cr;
     int		y, x;
@@ -1999,13 +2236,13 @@ static void dumpmap(void)
 	fputc('\n', stderr);
     }
     fputc('\n', stderr);
-    for (y = 0 ; y < creaturecount ; ++y) {
-	cr = creatures[y];
+    for (y = 0 ; y < ms->creaturecount ; ++y) {
+	cr = ms->creatures[y];
 	fprintf(stderr, "%02X%c (%d %d)",
 			cr->id, "-^<?v?\?\?>"[(int)cr->dir],
 			cr->pos % CXGRID, cr->pos / CXGRID);
-	for (x = 0 ; x < slipcount ; ++x) {
-	    if (cr == slips[x].cr) {
+	for (x = 0 ; x < ms->slipcount ; ++x) {
+	    if (cr == ms->slips[x].cr) {
 		fprintf(stderr, " [%d]", x + 1);
 		break;
 	    }
@@ -2020,17 +2257,17 @@ static void dumpmap(void)
 			cr->state & CS_SLIDE ? " sliding" : "",
 			cr->state & CS_DEFERPUSH ? " deferred-push" : "",
 			cr->state & CS_MUTANT ? " mutant" : "");
-	if (x < slipcount)
-	    fprintf(stderr, " %c", "-^<?v?\?\?>"[(int)slips[x].dir]);
+	if (x < ms->slipcount)
+	    fprintf(stderr, " %c", "-^<?v?\?\?>"[(int)ms->slips[x].dir]);
 	fputc('\n', stderr);
     }
-    for (y = 0 ; y < blockcount ; ++y) {
-	cr = blocks[y];
+    for (y = 0 ; y < ms->blockcount ; ++y) {
+	cr = ms->blocks[y];
 	fprintf(stderr, "block %d: (%d %d) %c", y,
 			cr->pos % CXGRID, cr->pos / CXGRID,
 			"-^<?v?\?\?>"[(int)cr->dir]);
-	for (x = 0 ; x < slipcount ; ++x) {
-	    if (cr == slips[x].cr) {
+	for (x = 0 ; x < ms->slipcount ; ++x) {
+	    if (cr == ms->slips[x].cr) {
 		fprintf(stderr, " [%d]", x + 1);
 		break;
 	    }
@@ -2045,32 +2282,32 @@ static void dumpmap(void)
 			cr->state & CS_SLIDE ? " sliding" : "",
 			cr->state & CS_DEFERPUSH ? " deferred-push" : "",
 			cr->state & CS_MUTANT ? " mutant" : "");
-	if (x < slipcount)
-	    fprintf(stderr, " %c", "-^<?v?\?\?>"[(int)slips[x].dir]);
+	if (x < ms->slipcount)
+	    fprintf(stderr, " %c", "-^<?v?\?\?>"[(int)ms->slips[x].dir]);
 	fputc('\n', stderr);
     }
 }
 
 /* Run various sanity checks on the current game state.
  */
-static void verifymap(void)
+static void verifymap(msengine *ms)
 {
     creature   *cr;
     int		n;
 
-    for (n = 0 ; n < creaturecount ; ++n) {
-	cr = creatures[n];
+    for (n = 0 ; n < ms->creaturecount ; ++n) {
+	cr = ms->creatures[n];
 	if (cr->id < 0x40 || cr->id >= 0x80)
 	    warn("%d: Undefined creature %02X at (%d %d)",
-		 state->currenttime, cr->id,
+		 ms->state->currenttime, cr->id,
 		 cr->pos % CXGRID, cr->pos / CXGRID);
 	if (!cr->hidden && (cr->pos < 0 || cr->pos >= CXGRID * CYGRID))
 	    warn("%d: Creature %02X has left the map: (%d %d)",
-		 state->currenttime, cr->id,
+		 ms->state->currenttime, cr->id,
 		 cr->pos % CXGRID, cr->pos / CXGRID);
 	if (cr->dir > EAST && (cr->dir != NIL || !isblock(cr->id)))
 	    warn("%d: Creature %d lacks direction (%d)",
-		 state->currenttime, cr->id, cr->dir);
+		 ms->state->currenttime, cr->id, cr->dir);
     }
 }
 
@@ -2082,20 +2319,20 @@ static void verifymap(void)
 
 /* Actions and checks that occur at the start of a tick.
  */
-static void initialhousekeeping(void)
+static void initialhousekeeping(msengine *ms)
 {
     int	n;
 
 #ifndef NDEBUG
     if (currentinput() == CmdDebugCmd2) {
-	dumpmap();
+	dumpmap(ms);
 	exit(0);
     } else if (currentinput() == CmdDebugCmd1) {
 	static int mark = 0;
 	warn("Mark %d (%d).", ++mark, currenttime());
 	currentinput() = NIL;
     }
-    verifymap();
+    verifymap(ms);
 
     if (currentinput() >= CmdCheatNorth && currentinput() <= CmdCheatICChip) {
 	switch (currentinput()) {
@@ -2120,32 +2357,32 @@ static void initialhousekeeping(void)
 #endif
 
     if (currenttime() == 0)
-	laststepping = stepping();
+	ms->laststepping = stepping();
 
     if (!(currenttime() & 3)) {
-	for (n = 1 ; n < creaturecount ; ++n) {
-	    if (creatures[n]->state & CS_TURNING) {
-		creatures[n]->state &= ~(CS_TURNING | CS_HASMOVED);
-		updatecreature(creatures[n]);
+	for (n = 1 ; n < ms->creaturecount ; ++n) {
+	    if (ms->creatures[n]->state & CS_TURNING) {
+		ms->creatures[n]->state &= ~(CS_TURNING | CS_HASMOVED);
+		updatecreature(ms, ms->creatures[n]);
 	    }
 	}
 	++chipwait();
 	if (chipwait() > 3) {
 	    chipwait() = 3;
 	    getchip()->dir = SOUTH;
-	    updatecreature(getchip());
+	    updatecreature(ms, getchip());
 	}
     }
 }
 
 /* Actions and checks that occur at the end of a tick.
  */
-static void finalhousekeeping(void)
+static void finalhousekeeping(msengine *ms)
 {
     return;
 }
 
-static void preparedisplay(void)
+static void preparedisplay(msengine *ms)
 {
     int	pos;
 
@@ -2171,19 +2408,20 @@ static void preparedisplay(void)
  */
 static int initgame(gamelogic *logic)
 {
-    static creature	dummycrlist;
+    msengine	       *ms = getengine(logic);
     mapcell	       *cell;
     xyconn	       *xy;
     creature	       *cr;
     creature	       *chip;
     int			pos, num, n;
 
-    setstate(logic);
-    num = state->game->number;
-    state->statusflags &= ~SF_BADTILES;
-    state->statusflags |= SF_NOANIMATION;
+    ms->state = logic->state;
+    num = ms->state->game->number;
+    ms->state->statusflags &= ~SF_BADTILES;
+    ms->state->statusflags |= SF_NOANIMATION;
 
-    for (pos = 0, cell = state->map ; pos < CXGRID * CYGRID ; ++pos, ++cell) {
+    for (pos = 0, cell = ms->state->map ; pos < CXGRID * CYGRID ;
+						       ++pos, ++cell) {
 	if (isfloor(cell->top.id) || creatureid(cell->top.id) == Chip
 				  || creatureid(cell->top.id) == Block)
 	    if (cell->bot.id == Teleport || cell->bot.id == SwitchWall_Open
@@ -2191,7 +2429,8 @@ static int initgame(gamelogic *logic)
 		cell->bot.state |= FS_BROKEN;
     }
 
-    for (pos = 0, cell = state->map ; pos < CXGRID * CYGRID ; ++pos, ++cell) {
+    for (pos = 0, cell = ms->state->map ; pos < CXGRID * CYGRID ;
+						       ++pos, ++cell) {
 	if (creatureid(cell->bot.id) == Block
 		       && cell->top.id == IceBlock_Static) {
 	    cell->top.id = crtile(IceBlock, creaturedirid(cell->bot.id));
@@ -2199,13 +2438,13 @@ static int initgame(gamelogic *logic)
 	}
     }
 
-    chip = allocatecreature();
+    chip = allocatecreature(ms);
     chip->pos = 0;
     chip->id = Chip;
     chip->dir = SOUTH;
-    addtocreaturelist(chip);
-    for (n = 0 ; n < state->crlistcount ; ++n) {
-	pos = state->crlist[n];
+    addtocreaturelist(ms, chip);
+    for (n = 0 ; n < ms->state->crlistcount ; ++n) {
+	pos = ms->state->crlist[n];
 	if (pos < 0 || pos >= CXGRID * CYGRID) {
 	    warn("level %d: invalid creature location (%d %d)",
 		 num, pos % CXGRID, pos / CXGRID);
@@ -2219,11 +2458,11 @@ static int initgame(gamelogic *logic)
 	}
 	if (!isblock(creatureid(cell->top.id))
 				&& cell->bot.id != CloneMachine) {
-	    cr = allocatecreature();
+	    cr = allocatecreature(ms);
 	    cr->pos = pos;
 	    cr->id = creatureid(cell->top.id);
 	    cr->dir = creaturedirid(cell->top.id);
-	    addtocreaturelist(cr);
+	    addtocreaturelist(ms, cr);
 	    if (iscreature(cell->bot.id) && creatureid(cell->bot.id) == Chip) {
 		chip->pos = pos;
 		chip->dir = creaturedirid(cell->bot.id);
@@ -2231,7 +2470,8 @@ static int initgame(gamelogic *logic)
 	}
 	cell->top.state |= FS_MARKER;
     }
-    for (pos = 0, cell = state->map ; pos < CXGRID * CYGRID ; ++pos, ++cell) {
+    for (pos = 0, cell = ms->state->map ; pos < CXGRID * CYGRID ;
+						       ++pos, ++cell) {
 	if (cell->top.state & FS_MARKER) {
 	    cell->top.state &= ~FS_MARKER;
 	} else if (iscreature(cell->top.id)
@@ -2241,9 +2481,9 @@ static int initgame(gamelogic *logic)
 	}
     }
 
-    dummycrlist.id = 0;
-    state->creatures = &dummycrlist;
-    state->initrndslidedir = NORTH;
+    ms->dummycrlist.id = 0;
+    ms->state->creatures = &ms->dummycrlist;
+    ms->state->initrndslidedir = NORTH;
 
     possession(Key_Red) = possession(Key_Blue)
 			= possession(Key_Yellow)
@@ -2252,22 +2492,24 @@ static int initgame(gamelogic *logic)
 			  = possession(Boots_Fire)
 			  = possession(Boots_Water) = 0;
 
+    buildwiring(ms);
+
     xy = traplist();
     for (n = traplistsize(), xy = traplist() ; n ; --n, ++xy)
-	if (istrapbuttondown(xy->from) || xy->to == chippos())
-	    springtrap(xy->from);
+	if (istrapbuttondown(ms, xy->from) || xy->to == chippos())
+	    springtrap(ms, xy->from);
 
     chipwait() = 0;
     completed() = FALSE;
     chipstatus() = CHIP_OKAY;
     controllerdir() = NIL;
     lastslipdir() = NIL;
-    stepping() = laststepping;
+    stepping() = ms->laststepping;
     cancelgoal();
     xviewoffset() = 0;
     yviewoffset() = 0;
 
-    preparedisplay();
+    preparedisplay(ms);
     return TRUE;
 }
 
@@ -2275,113 +2517,245 @@ static int initgame(gamelogic *logic)
  */
 static int advancegame(gamelogic *logic)
 {
+    msengine   *ms = getengine(logic);
     creature   *cr;
     int		r = 0;
     int		n;
 
-    setstate(logic);
+    ms->state = logic->state;
+    if (changes())
+	copycreatures(ms, TRUE);
 
     timeoffset() = -1;
-    initialhousekeeping();
+    initialhousekeeping(ms);
 
     if (currenttime() && !(currenttime() & 1)) {
 	controllerdir() = NIL;
-	for (n = 0 ; n < creaturecount ; ++n) {
-	    cr = creatures[n];
+	beginphase(logic, Phase_MSCreatures);
+	for (n = 0 ; n < ms->creaturecount ; ++n) {
+	    cr = ms->creatures[n];
 	    if (cr->hidden || (cr->state & CS_CLONING) || cr->id == Chip)
 		continue;
-	    choosemove(cr);
+	    choosemove(ms, cr);
 	    if (cr->tdir != NIL)
-		advancecreature(cr, cr->tdir);
+		advancecreature(ms, cr, cr->tdir);
 	}
-	if ((r = checkforending()))
+	endphase(logic, Phase_MSCreatures);
+	if ((r = checkforending(ms)))
 	    goto done;
     }
 
     if (currenttime() && !(currenttime() & 1)) {
-	floormovements();
-	if ((r = checkforending()))
+	beginphase(logic, Phase_MSFloor);
+	floormovements(ms);
+	endphase(logic, Phase_MSFloor);
+	if ((r = checkforending(ms)))
 	    goto done;
     }
-    updatesliplist();
+    beginphase(logic, Phase_MSSlipList);
+    updatesliplist(ms);
+    endphase(logic, Phase_MSSlipList);
 
     timeoffset() = 0;
     if (timelimit()) {
 	if (currenttime() >= timelimit()) {
 	    chipstatus() = CHIP_OUTOFTIME;
 	    addsoundeffect(SND_TIME_OUT);
+	    if (changes())
+		copycreatures(ms, FALSE);
 	    return -1;
 	} else if (timelimit() - currenttime() <= 15 * TICKS_PER_SECOND
 				&& currenttime() % TICKS_PER_SECOND == 0)
 	    addsoundeffect(SND_TIME_LOW);
     }
 
+    beginphase(logic, Phase_MSChip);
     cr = getchip();
-    choosemove(cr);
+    choosemove(ms, cr);
     if (cr->tdir != NIL) {
-	if (advancecreature(cr, cr->tdir))
-	    if ((r = checkforending()))
-		goto done;
-	cr->state |= CS_HASMOVED;
+	if (advancecreature(ms, cr, cr->tdir))
+	    r = checkforending(ms);
+	if (!r)
+	    cr->state |= CS_HASMOVED;
     }
-    updatesliplist();
-    createclones();
+    endphase(logic, Phase_MSChip);
+    if (r)
+	goto done;
+    beginphase(logic, Phase_MSSlipList);
+    updatesliplist(ms);
+    endphase(logic, Phase_MSSlipList);
+    beginphase(logic, Phase_MSClones);
+    createclones(ms);
+    endphase(logic, Phase_MSClones);
 
   done:
-    finalhousekeeping();
-    preparedisplay();
+    finalhousekeeping(ms);
+    preparedisplay(ms);
+    if (changes())
+	copycreatures(ms, FALSE);
     return r;
 }
 
+/* Write the part of a snapshot that comes before the creatures to
+ * buf: the lengths of the lists, the slip list's directions, and the
+ * deferred buttons.
+ */
+static int savestatehead(gamelogic *logic, void *buf, int size)
+{
+    msengine	       *ms = getengine(logic);
+    unsigned char      *p = buf;
+    int			counts[4];
+    int			need, n;
+
+    counts[0] = ms->creaturecount;
+    counts[1] = ms->blockcount;
+    counts[2] = ms->slipcount;
+    counts[3] = ms->defercount;
+    need = sizeof counts + counts[2] * sizeof(int)
+			 + counts[3] * sizeof(deferredbutton);
+    if (need > size)
+	return need;
+
+    memcpy(p, counts, sizeof counts);
+    p += sizeof counts;
+    for (n = 0 ; n < ms->slipcount ; ++n, p += sizeof(int))
+	memcpy(p, &ms->slips[n].dir, sizeof(int));
+    memcpy(p, ms->defers, counts[3] * sizeof(deferredbutton));
+    return need;
+}
+
+/* Write a snapshot of the creature list, the block list, the slip
+ * list and the deferred buttons to buf. Only the creatures themselves
+ * are stored, in the order of the arena, after the head; each
+ * creature's id says which list it is on, and its slipindex says
+ * where it goes on the slip list. (A creature that is sliding is
+ * always on one of the other two lists.)
+ */
+static int savestate(gamelogic *logic, void *buf, int size)
+{
+    msengine	       *ms = getengine(logic);
+    unsigned char      *p = buf;
+    int			head, need;
+
+    head = savestatehead(logic, NULL, 0);
+    need = head + copyarena(ms, NULL) * sizeof(creature);
+    if (need > size)
+	return need;
+
+    savestatehead(logic, p, head);
+    copyarena(ms, p + head);
+    return need;
+}
+
+/* Recreate the lists from a snapshot written by savestate(). The
+ * creatures are reallocated from the start of the arena in the same
+ * order, and the position indexes are rebuilt as they are added to
+ * their lists.
+ */
+static int restorestate(gamelogic *logic, void const *buf, int size)
+{
+    msengine		       *ms = getengine(logic);
+    unsigned char const	       *p = buf;
+    creature		       *cr;
+    int				counts[4];
+    int				n;
+
+    if (size < (int)sizeof counts)
+	return FALSE;
+    memcpy(counts, p, sizeof counts);
+    p += sizeof counts;
+    if (size != (int)(sizeof counts
+				+ counts[2] * sizeof(int)
+				+ counts[3] * sizeof(deferredbutton)
+				+ (counts[0] + counts[1]) * sizeof(creature)))
+	return FALSE;
+
+    resetcreaturepool(ms);
+    resetcreaturelist(ms);
+    resetblocklist(ms);
+    if (counts[2] > ms->slipsallocated) {
+	ms->slipsallocated = counts[2];
+	ms->slips = realloc(ms->slips, ms->slipsallocated * sizeof *ms->slips);
+	if (!ms->slips)
+	    memerrexit();
+    }
+    if (counts[3] > ms->defersallocated) {
+	ms->defersallocated = counts[3];
+	ms->defers = realloc(ms->defers,
+			     ms->defersallocated * sizeof *ms->defers);
+	if (!ms->defers)
+	    memerrexit();
+    }
+
+    ms->slipcount = counts[2];
+    for (n = 0 ; n < ms->slipcount ; ++n, p += sizeof(int))
+	memcpy(&ms->slips[n].dir, p, sizeof(int));
+    ms->defercount = counts[3];
+    memcpy(ms->defers, p, counts[3] * sizeof(deferredbutton));
+    p += counts[3] * sizeof(deferredbutton);
+    for (n = 0 ; n < counts[0] + counts[1] ; ++n, p += sizeof(creature)) {
+	cr = allocatecreature(ms);
+	memcpy(cr, p, sizeof(creature));
+	if (isblock(cr->id))
+	    addtoblocklist(ms, cr);
+	else
+	    addtocreaturelist(ms, cr);
+	if (cr->slipindex >= ms->slipcount)
+	    return FALSE;
+	if (cr->slipindex >= 0)
+	    ms->slips[cr->slipindex].cr = cr;
+    }
+    return ms->creaturecount == counts[0] && ms->blockcount == counts[1];
+}
+
 /* Free resources associated with the current game state.
  */
 static int endgame(gamelogic *logic)
 {
-    (void)logic;
-    resetcreaturepool();
-    resetcreaturelist();
-    resetblocklist();
-    resetsliplist();
+    msengine   *ms = getengine(logic);
+
+    resetcreaturepool(ms);
+    resetcreaturelist(ms);
+    resetblocklist(ms);
+    resetsliplist(ms);
     return TRUE;
 }
 
-/* Free all allocated resources for this module.
+/* Free all allocated resources for this instance of the module.
  */
 static void shutdown(gamelogic *logic)
 {
-    (void)logic;
+    msengine   *ms = getengine(logic);
 
-    free(creatures);
-    creatures = NULL;
-    creaturecount = 0;
-    creaturesallocated = 0;
-    free(blocks);
-    blocks = NULL;
-    blockcount = 0;
-    blocksallocated = 0;
-    free(slips);
-    slips = NULL;
-    slipcount = 0;
-    slipsallocated = 0;
-
-    resetcreaturepool();
-    freecreaturepool();
-    creaturepool = NULL;
-    creaturepoolend = NULL;
+    free(ms->creatures);
+    free(ms->blocks);
+    free(ms->slips);
+    free(ms->defers);
+    resetcreaturepool(ms);
+    freecreaturepool(ms);
+    free(ms);
 }
 
-/* The exported function: Initialize and return the module's gamelogic
- * structure.
+/* The exported function: Create and return a new instance of the
+ * module's gamelogic structure.
  */
 gamelogic *mslogicstartup(void)
 {
-    static gamelogic	logic;
+    msengine   *ms;
+
+    ms = calloc(1, sizeof *ms);
+    if (!ms)
+	memerrexit();
 
-    logic.ruleset = Ruleset_MS;
-    logic.initgame = initgame;
-    logic.advancegame = advancegame;
-    logic.endgame = endgame;
-    logic.shutdown = shutdown;
+    ms->logic.ruleset = Ruleset_MS;
+    ms->logic.initgame = initgame;
+    ms->logic.advancegame = advancegame;
+    ms->logic.endgame = endgame;
+    ms->logic.savestate = savestate;
+    ms->logic.savestatehead = savestatehead;
+    ms->logic.restorestate = restorestate;
+    ms->logic.shutdown = shutdown;
+    initprngsequence(&ms->logic.rndsequence);
 
-    return &logic;
+    return &ms->logic;
 }
@@ -0,0 +1,143 @@
+/* nullhw.c: A do-nothing OS/hardware layer for programs without a UI.
+ *
+ * Copyright (C) 2001-2014 by Brian Raiter, Madhav Shanbhag, and Eric Schmidt,
+ * under the GNU General Public License. No warranty. See COPYING for details.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	"defs.h"
+#include	"oshw.h"
+#include	"res.h"
+
+/* This module supplies the parts of the OS/hardware layer (and of the
+ * resource module that sits on top of it) that the core modules call
+ * upon. Nothing is ever displayed or played, and time passes only when
+ * the program asks for it to, so that a program linked with this
+ * module needs neither a display nor any of the libraries that the
+ * real layers depend on.
+ */
+
+/* The tick counter.
+ */
+static int	utick = 0;
+
+/* The directory containing all the resource files. Only the list of
+ * unsolvable levels is ever read from it.
+ */
+char	       *resdir = NULL;
+
+/*
+ * Timer functions.
+ */
+
+void settimer(int action)
+{
+    if (action < 0)
+	utick = 0;
+}
+
+void settimersecond(int ms)
+{
+}
+
+int gettickcount(void)
+{
+    return utick;
+}
+
+int waitfortick(void)
+{
+    ++utick;
+    return FALSE;
+}
+
+int advancetick(void)
+{
+    return ++utick;
+}
+
+void settickcount(int tick)
+{
+    utick = tick;
+}
+
+/*
+ * Keyboard input functions.
+ */
+
+int setkeyboardrepeat(int enable)
+{
+    return TRUE;
+}
+
+int setkeyboardarrowsrepeat(int enable)
+{
+    return TRUE;
+}
+
+int setkeyboardinputmode(int enable)
+{
+    return TRUE;
+}
+
+/*
+ * Video and sound output functions.
+ */
+
+int loadgameresources(int ruleset)
+{
+    return TRUE;
+}
+
+int creategamedisplay(void)
+{
+    return TRUE;
+}
+
+int displaygame(struct gamestate const *state, int timeleft, int besttime)
+{
+    return TRUE;
+}
+
+int setdisplaymsg(char const *msg, int msecs, int bold)
+{
+    return TRUE;
+}
+
+void playsoundeffects(unsigned long sfx)
+{
+}
+
+void setsoundeffects(int action)
+{
+}
+
+/*
+ * Miscellaneous functions.
+ */
+
+/* Messages are always written to stderr.
+ */
+void usermessage(int action, char const *prefix,
+		 char const *cfile, unsigned long lineno,
+		 char const *fmt, va_list args)
+{
+    fprintf(stderr, "%s: ", action == NOTIFY_DIE ? "FATAL" :
+			    action == NOTIFY_ERR ? "error" : "warning");
+    if (prefix)
+	fprintf(stderr, "%s: ", prefix);
+    if (fmt)
+	vfprintf(stderr, fmt, args);
+    if (cfile)
+	fprintf(stderr, " [%s:%lu] ", cfile, lineno);
+    fputc('\n', stderr);
+    fflush(stderr);
+}
+
+/* Read any additional data for the series.
+ */
+void readextensions(struct gameseries *series)
+{
+    /* Not implemented. */
+}
@@ -583,6 +583,19 @@ int TileWorldMainWnd::AdvanceTick()
 	return ++m_nTickCount;
 }
 
+
+/* Set the tick counter, as when play resumes from an earlier point.
+ */
+void settickcount(int tick)
+{
+	g_pMainWnd->SetTickCount(tick);
+}
+
+void TileWorldMainWnd::SetTickCount(int nTick)
+{
+	m_nTickCount = nTick;
+}
+
 #endif
 
 
@@ -634,6 +647,7 @@ bool TileWorldMainWnd::CreateGameDisplay()
 	m_pObjectsWidget->setFixedSize(m_pInvSurface->GetPixmap().size());
 
 	geng.screen = m_pSurface;
+	geng.mapvieworigin = -1;
 	m_disploc = TW_Rect(0, 0, w, h);
 	geng.maploc = m_pGameWidget->geometry();
 	
@@ -724,6 +738,7 @@ bool TileWorldMainWnd::DisplayGame(const gamestate* pState, int nTimeLeft, int n
 			
 		m_pSldSeek->setValue(0);
 		bool bHasSolution = hassolution(pState->game);
+		int nLength = getplaybacklength();
 		m_pControlsFrame->setVisible(bHasSolution);
 		
 		menu_Game->setEnabled(true);
@@ -750,7 +765,7 @@ bool TileWorldMainWnd::DisplayGame(const gamestate* pState, int nTimeLeft, int n
 			else
 			{
 				m_pPrgTime->setFormat("(" + QString::number(nBestTime) + a + ") / ---");
-				m_pSldSeek->setMaximum(999-nBestTime);
+				m_pSldSeek->setMaximum(nLength >= 0 ? nLength / TICKS_PER_SECOND : 999-nBestTime);
 			}
 			m_pPrgTime->setMaximum(999);
 			m_pPrgTime->setValue(999);
@@ -765,7 +780,7 @@ bool TileWorldMainWnd::DisplayGame(const gamestate* pState, int nTimeLeft, int n
 			{
 				m_pPrgTime->setFormat(QString::number(nBestTime) + a + " / %v");
 				m_pPrgTime->setPar(nBestTime);
-				m_pSldSeek->setMaximum(nTimeLeft-nBestTime);
+				m_pSldSeek->setMaximum(nLength >= 0 ? nLength / TICKS_PER_SECOND : nTimeLeft-nBestTime);
 			}
 			m_pPrgTime->setMaximum(pState->game->time);
 			m_pPrgTime->setValue(nTimeLeft);
@@ -831,6 +846,11 @@ bool TileWorldMainWnd::DisplayGame(const gamestate* pState, int nTimeLeft, int n
 	if (m_bReplay && !m_pSldSeek->isSliderDown())
 	{
 		m_pSldSeek->blockSignals(true);
+		// The exact length becomes known once the solution has been
+		// played through in the background
+		int nLength = getplaybacklength();
+		if (nLength >= 0)
+			m_pSldSeek->setMaximum(nLength / TICKS_PER_SECOND);
 		m_pSldSeek->setValue(pState->currenttime / TICKS_PER_SECOND);
 		m_pSldSeek->blockSignals(false);
 	}
@@ -54,6 +54,7 @@ public:
 	int GetTickCount();
 	bool WaitForTick();
 	int AdvanceTick();
+	void SetTickCount(int nTick);
 #endif
 
 	bool SetKeyboardRepeat(bool bEnable);
@@ -344,12 +344,14 @@ static char const *decimal(long number, int places)
     return dest;
 }
 
-/* Display an empty map view.
+/* Display an empty map view. The map view will have to be redrawn in
+ * full afterwards.
  */
 static void displayshutter(void)
 {
     SDL_Rect	rect;
 
+    geng.mapvieworigin = -1;
     rect = displayloc;
     SDL_FillRect(geng.screen, &rect, halfcolor(sdlg.dimtextclr));
     ++rect.x;
@@ -66,6 +66,10 @@ OSHW_EXTERN int waitfortick(void);
  */
 OSHW_EXTERN int advancetick(void);
 
+/* Set the tick counter, as when play resumes from an earlier point.
+ */
+OSHW_EXTERN void settickcount(int tick);
+
 /*
  * Keyboard input functions.
  */
@@ -0,0 +1,92 @@
+/* phase.c: Optional timing of the phases of the game logic.
+ *
+ * Copyright (C) 2001-2014 by Brian Raiter, Madhav Shanbhag, and Eric Schmidt,
+ * under the GNU General Public License. No warranty. See COPYING for details.
+ */
+
+#include	"phase.h"
+
+#ifdef PHASETIMING
+
+#include	<stdio.h>
+#include	<time.h>
+
+/* The names of the phases, as displayed.
+ */
+static char const *phasenames[Phase_Count] = {
+    "MS creatures", "MS slide floors", "MS slip list", "MS Chip",
+    "MS clones", "Lynx choose", "Lynx advance", "Lynx teleport"
+};
+
+/* The figures of the instances no longer displayed, and the instance
+ * whose figures are displayed.
+ */
+static phasetimes		totals;
+static phasetimes const	       *shown = NULL;
+
+#if !(defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)))
+
+/* Return the time in nanoseconds.
+ */
+uint64_t readphaseclock(void)
+{
+    struct timespec	ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#endif
+
+/* Add the figures of the instance being displayed to the totals, and
+ * display the given instance's from now on.
+ */
+void showphasetimes(phasetimes const *times)
+{
+    int	i;
+
+    if (shown) {
+	for (i = 0 ; i < Phase_Count ; ++i) {
+	    totals.clocks[i] += shown->clocks[i];
+	    totals.count[i] += shown->count[i];
+	}
+    }
+    shown = times;
+}
+
+/* Display the number of times each phase was run, the total and mean
+ * time spent in it, and its share of the time spent in all phases.
+ */
+void printphasetimes(void)
+{
+    uint64_t		phaseclocks[Phase_Count];
+    unsigned long	phasecount[Phase_Count];
+    uint64_t		total;
+    int			i;
+
+    total = 0;
+    for (i = 0 ; i < Phase_Count ; ++i) {
+	phaseclocks[i] = totals.clocks[i];
+	phasecount[i] = totals.count[i];
+	if (shown) {
+	    phaseclocks[i] += shown->clocks[i];
+	    phasecount[i] += shown->count[i];
+	}
+	total += phaseclocks[i];
+    }
+    if (!total)
+	return;
+
+    printf("Time spent in each phase of the game logic (%s)\n",
+	   PHASECLOCKUNITS);
+    for (i = 0 ; i < Phase_Count ; ++i) {
+	if (!phasecount[i])
+	    continue;
+	printf("%-16s %10lu runs %14.0f total %10.1f mean %5.1f%%\n",
+	       phasenames[i], phasecount[i], (double)phaseclocks[i],
+	       (double)phaseclocks[i] / phasecount[i],
+	       (phaseclocks[i] * 100.0) / total);
+    }
+}
+
+#endif
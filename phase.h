@@ -0,0 +1,79 @@
+/* phase.h: Optional timing of the phases of the game logic.
+ *
+ * Copyright (C) 2001-2014 by Brian Raiter, Madhav Shanbhag, and Eric Schmidt,
+ * under the GNU General Public License. No warranty. See COPYING for details.
+ */
+
+#ifndef	HEADER_phase_h_
+#define	HEADER_phase_h_
+
+/* When the program is compiled with PHASETIMING defined, the logic
+ * modules count and time each phase of a tick, and the totals are
+ * displayed along with the -H histogram. Otherwise the macros below
+ * expand to nothing. The figures are kept by each instance of a logic
+ * module, so that the instances on other threads (presimulation and
+ * batch verification) neither disturb them nor are counted.
+ */
+#ifdef PHASETIMING
+
+#include	<stdint.h>
+
+/* The phases of a tick that are timed.
+ */
+enum {
+    Phase_MSCreatures,		/* moving the creatures other than Chip */
+    Phase_MSFloor,		/* forced movement on slide floors */
+    Phase_MSSlipList,		/* updating the slip list */
+    Phase_MSChip,		/* moving Chip */
+    Phase_MSClones,		/* creating new clones */
+    Phase_LxChoose,		/* choosing every creature's move */
+    Phase_LxAdvance,		/* moving every creature */
+    Phase_LxTeleport,		/* teleporting creatures */
+    Phase_Count
+};
+
+/* A cheap clock for timing the phases. On x86 the processor's cycle
+ * counter is read directly; elsewhere a monotonic clock is used.
+ */
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define	readphaseclock()	((uint64_t)__builtin_ia32_rdtsc())
+#define	PHASECLOCKUNITS		"cycles"
+#else
+extern uint64_t readphaseclock(void);
+#define	PHASECLOCKUNITS		"ns"
+#endif
+
+/* The start of the phase in progress, the total time spent in each
+ * phase, and the number of times each phase was run.
+ */
+typedef struct phasetimes {
+    uint64_t		start[Phase_Count];
+    uint64_t		clocks[Phase_Count];
+    unsigned long	count[Phase_Count];
+} phasetimes;
+
+/* Time a phase of a tick run by the given logic module instance.
+ */
+#define	beginphase(lg, p)	((lg)->phases.start[p] = readphaseclock())
+#define	endphase(lg, p)		((lg)->phases.clocks[p] += readphaseclock() \
+						  - (lg)->phases.start[p], \
+				 ++(lg)->phases.count[p])
+
+/* Make the figures of the given instance the ones that are displayed,
+ * in place of those of the previous instance, which are kept as part
+ * of the totals. NULL may be passed when the instance is shut down.
+ */
+extern void showphasetimes(phasetimes const *times);
+
+/* Display the totals for each phase on stdout.
+ */
+extern void printphasetimes(void);
+
+#else
+
+#define	beginphase(lg, p)	((void)0)
+#define	endphase(lg, p)		((void)0)
+
+#endif
+
+#endif
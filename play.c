@@ -5,7 +5,10 @@
  */
 
 #include	<stdlib.h>
+#include	<stddef.h>
 #include	<string.h>
+#include	<pthread.h>
+#include	<sched.h>
 #include	"defs.h"
 #include	"err.h"
 #include	"state.h"
@@ -14,8 +17,10 @@
 #include	"res.h"
 #include	"logic.h"
 #include	"random.h"
+#include	"series.h"
 #include	"solution.h"
 #include	"unslist.h"
+#include	"changes.h"
 #include	"play.h"
 
 /* The current state of the current game.
@@ -34,6 +39,21 @@ int			batchmode = FALSE;
  */
 static int		mudsucking = 1;
 
+/* Functions that manage the keyframes (see below).
+ */
+static void clearkeyframes(void);
+static void checkkeyframes(void);
+static int iskeyframesource(gamestate const *st);
+static int recordkeyframe(gamestate const *st, gamelogic *lg);
+static void setplaybacklength(int length);
+static void stoppresimulation(void);
+
+/* Functions that manage the rewind history (see below).
+ */
+static void clearrewind(void);
+static void recordrewind(void);
+static void freerewind(void);
+
 /* Turn on the pedantry.
  */
 void setpedanticmode(void)
@@ -57,38 +77,44 @@ int setmudsuckingfactor(int mud)
  */
 static int setrulesetbehavior(int ruleset)
 {
+    uint32_t	rndsequence;
+
     if (logic) {
 	if (ruleset == logic->ruleset)
 	    return TRUE;
+	rndsequence = logic->rndsequence;
+#ifdef PHASETIMING
+	showphasetimes(NULL);
+#endif
 	(*logic->shutdown)(logic);
 	logic = NULL;
+    } else {
+	initprngsequence(&rndsequence);
     }
     if (ruleset == Ruleset_None)
 	return TRUE;
 
     switch (ruleset) {
-      case Ruleset_Lynx:
-	logic = lynxlogicstartup();
-	if (!logic)
-	    return FALSE;
-	if (!batchmode)
-	    setkeyboardarrowsrepeat(TRUE);
-	settimersecond(1000 * mudsucking);
-	break;
-      case Ruleset_MS:
-	logic = mslogicstartup();
-	if (!logic)
-	    return FALSE;
-	if (!batchmode)
-	    setkeyboardarrowsrepeat(FALSE);
-	settimersecond(1100 * mudsucking);
-	break;
+      case Ruleset_Lynx:	logic = lynxlogicstartup();	break;
+      case Ruleset_MS:		logic = mslogicstartup();	break;
       default:
 	errmsg(NULL, "unknown ruleset requested (ruleset=%d)", ruleset);
 	return FALSE;
     }
+    if (!logic)
+	return FALSE;
 
+    /* Nothing in the OS/hardware layer needs to change when running
+     * without a user interface.
+     */
     if (!batchmode) {
+	if (ruleset == Ruleset_Lynx) {
+	    setkeyboardarrowsrepeat(TRUE);
+	    settimersecond(1000 * mudsucking);
+	} else {
+	    setkeyboardarrowsrepeat(FALSE);
+	    settimersecond(1100 * mudsucking);
+	}
 	if (!loadgameresources(ruleset) || !creategamedisplay()) {
 	    die("unable to proceed due to previous errors.");
 	    return FALSE;
@@ -96,9 +122,44 @@ static int setrulesetbehavior(int ruleset)
     }
 
     logic->state = &state;
+    logic->rndsequence = rndsequence;	/* keep the same random sequence */
+#ifdef PHASETIMING
+    showphasetimes(&logic->phases);
+#endif
     return TRUE;
 }
 
+/* Initialize a game state to the starting position of the given
+ * level, using the given logic module.
+ */
+static int resetgamestate(gamestate *st, gamelogic *lg,
+			  gamesetup *game, int ruleset)
+{
+    memset(st->map, 0, sizeof st->map);
+    st->game = game;
+    st->ruleset = ruleset;
+    st->replay = -1;
+    st->currenttime = -1;
+    st->timeoffset = 0;
+    st->currentinput = NIL;
+    st->lastmove = NIL;
+    st->initrndslidedir = NIL;
+    st->stepping = -1;
+    st->statusflags = 0;
+    st->soundeffects = 0;
+    readleveldetails(game);
+    st->timelimit = game->time * TICKS_PER_SECOND;
+    initmovelist(&st->moves);
+    resetprng(&st->mainprng, &lg->rndsequence);
+    if (st->changes)
+	st->changes->all = TRUE;
+
+    if (!expandleveldata(st))
+	return FALSE;
+
+    return (*lg->initgame)(lg);
+}
+
 /* Initialize the current state to the starting position of the
  * given level.
  */
@@ -107,47 +168,519 @@ int initgamestate(gamesetup *game, int ruleset)
     if (!setrulesetbehavior(ruleset))
 	die("unable to initialize the system for the requested ruleset");
 
-    memset(state.map, 0, sizeof state.map);
-    state.game = game;
-    state.ruleset = ruleset;
-    state.replay = -1;
-    state.currenttime = -1;
-    state.timeoffset = 0;
-    state.currentinput = NIL;
-    state.lastmove = NIL;
-    state.initrndslidedir = NIL;
-    state.stepping = -1;
-    state.statusflags = 0;
-    state.soundeffects = 0;
-    state.timelimit = game->time * TICKS_PER_SECOND;
-    initmovelist(&state.moves);
-    resetprng(&state.mainprng);
+    clearrewind();
+    return resetgamestate(&state, logic, game, ruleset);
+}
+
+/*
+ * Snapshots of a game in progress.
+ */
 
-    if (!expandleveldata(&state))
+/* The values of a game in progress that can change once it has
+ * begun, apart from the map and the logic module's own state. The
+ * parts of the game state that are fixed for the level (the wirings,
+ * the hint text, and the move list, of which only the length is kept)
+ * are not stored. Nothing here is a pointer: the level is identified
+ * by its number and hash, the replay position and the PRNG by their
+ * values, and the pointers that the Lynx logic keeps in the game
+ * state are left out, to be rebuilt from the logic module's state.
+ */
+typedef struct gamevalues {
+    int			levelnumber;		/* the level being played */
+    uint32_t		levelhash;		/*   and its data's hash */
+    int			ruleset;		/* the ruleset for the game */
+    int			movecount;		/* length of the move list */
+    int			replay;			/* playback move index */
+    int			replayoffset;		/* where the next move to */
+    int			replaypacked;		/*   replay is found in the */
+    action		replaynext;		/*   level's solution data */
+    int			replaymore;		/*   (see solutioncursor) */
+    int			timelimit;		/* maximum time permitted */
+    int			currenttime;		/* the current tick count */
+    int			timeoffset;		/* offset for displayed time */
+    short		currentinput;		/* the current keystroke */
+    short		chipsneeded;		/* no. of chips still needed */
+    short		xviewpos;		/* the visible part of the */
+    short		yviewpos;		/*   map (ie, where Chip is) */
+    short		keys[4];		/* keys collected */
+    short		boots[4];		/* boots collected */
+    short		statusflags;		/* flags */
+    short		lastmove;		/* most recent move */
+    unsigned char	initrndslidedir;	/* initial random-slide dir */
+    signed char		stepping;		/* initial timer offset 0-7 */
+    unsigned long	soundeffects;		/* the latest sound effects */
+    uint32_t		rndinitial;		/* the main PRNG's seed */
+    uint32_t		rndvalue;		/*   and its latest value */
+    int			rndshared;		/* TRUE if it uses rndsequence */
+    uint32_t		rndsequence;		/* the PRNG's shared value */
+    struct msstate_	msstate;		/* MS-specific state */
+    struct lxstate_	lxstate;		/* Lynx-specific state */
+} gamevalues;
+
+/* Everything about a game in progress that can change once it has
+ * begun, so a snapshot is a little over the size of the map, plus
+ * whatever the logic module has of its own. A snapshot is one block
+ * of memory, with the logic module's state kept at the end of it.
+ */
+struct gamesnapshot {
+    int			allocated;		/* size of the memory block */
+    gamevalues		values;			/* the game's values */
+    mapcell		map[CXGRID * CYGRID];	/* the game's map */
+    int			enginesize;		/* size of the logic's state */
+    int			enginehead;		/* size of its head */
+    unsigned char	engine[1];		/* the logic module's state */
+};
+
+/* Copy the values of a game state into vals.
+ */
+static void savegamevalues(gamevalues *vals, gamestate const *st,
+			   gamelogic const *lg)
+{
+    vals->levelnumber = st->game->number;
+    vals->levelhash = st->game->levelhash;
+    vals->ruleset = st->ruleset;
+    vals->movecount = st->moves.count;
+    vals->replay = st->replay;
+    vals->replayoffset = st->replaycursor.offset;
+    vals->replaypacked = st->replaycursor.packed;
+    vals->replaynext = st->replaycursor.next;
+    vals->replaymore = st->replaycursor.more;
+    vals->timelimit = st->timelimit;
+    vals->currenttime = st->currenttime;
+    vals->timeoffset = st->timeoffset;
+    vals->currentinput = st->currentinput;
+    vals->chipsneeded = st->chipsneeded;
+    vals->xviewpos = st->xviewpos;
+    vals->yviewpos = st->yviewpos;
+    memcpy(vals->keys, st->keys, sizeof vals->keys);
+    memcpy(vals->boots, st->boots, sizeof vals->boots);
+    vals->statusflags = st->statusflags;
+    vals->lastmove = st->lastmove;
+    vals->initrndslidedir = st->initrndslidedir;
+    vals->stepping = st->stepping;
+    vals->soundeffects = st->soundeffects;
+    vals->rndinitial = st->mainprng.initial;
+    vals->rndvalue = st->mainprng.value;
+    vals->rndshared = st->mainprng.shared != NULL;
+    vals->rndsequence = lg->rndsequence;
+    vals->msstate = st->msstate;
+    vals->lxstate = st->lxstate;
+    vals->lxstate.chiptocr = NULL;
+    vals->lxstate.crend = NULL;
+}
+
+/* Put back the values of a game state from vals. FALSE is returned
+ * if vals belongs to a different level or ruleset, or if the moves
+ * made before it was taken have since been discarded.
+ */
+static int applygamevalues(gamevalues const *vals, gamestate *st,
+			   gamelogic *lg)
+{
+    if (vals->levelnumber != st->game->number
+			|| vals->levelhash != st->game->levelhash
+			|| vals->ruleset != st->ruleset
+			|| vals->ruleset != lg->ruleset
+			|| vals->movecount > st->moves.count)
 	return FALSE;
 
-    return (*logic->initgame)(logic);
+    st->moves.count = vals->movecount;
+    st->replay = vals->replay;
+    st->replaycursor.offset = vals->replayoffset;
+    st->replaycursor.packed = vals->replaypacked;
+    st->replaycursor.next = vals->replaynext;
+    st->replaycursor.more = vals->replaymore;
+    st->timelimit = vals->timelimit;
+    st->currenttime = vals->currenttime;
+    st->timeoffset = vals->timeoffset;
+    st->currentinput = vals->currentinput;
+    st->chipsneeded = vals->chipsneeded;
+    st->xviewpos = vals->xviewpos;
+    st->yviewpos = vals->yviewpos;
+    memcpy(st->keys, vals->keys, sizeof st->keys);
+    memcpy(st->boots, vals->boots, sizeof st->boots);
+    st->statusflags = vals->statusflags;
+    st->lastmove = vals->lastmove;
+    st->initrndslidedir = vals->initrndslidedir;
+    st->stepping = vals->stepping;
+    st->soundeffects = vals->soundeffects;
+    st->mainprng.initial = vals->rndinitial;
+    st->mainprng.value = vals->rndvalue;
+    st->mainprng.shared = vals->rndshared ? &lg->rndsequence : NULL;
+    if (vals->rndshared)
+	lg->rndsequence = vals->rndsequence;
+    st->msstate = vals->msstate;
+    st->lxstate = vals->lxstate;
+    return TRUE;
 }
 
-/* Change the current state to run from the recorded solution.
+/* Make sure that snap has room for enginesize bytes of the logic
+ * module's state, allocating or moving it as needed. If snap is NULL,
+ * a new snapshot is allocated. The snapshot is returned.
  */
-int prepareplayback(void)
+static gamesnapshot *growsnapshot(gamesnapshot *snap, int enginesize)
+{
+    int	n;
+
+    n = (int)offsetof(gamesnapshot, engine) + enginesize;
+    if (!snap || n > snap->allocated) {
+	snap = realloc(snap, n);
+	if (!snap)
+	    memerrexit();
+	snap->allocated = n;
+    }
+    return snap;
+}
+
+/* Copy a game state and its logic module's state into snap, which is
+ * enlarged (and so possibly moved) if the logic's state does not fit.
+ * If snap is NULL, a new snapshot is allocated. The snapshot is
+ * returned.
+ */
+static gamesnapshot *takesnapshot(gamesnapshot *snap, gamestate const *st,
+				  gamelogic *lg)
+{
+    snap = growsnapshot(snap, (*lg->savestate)(lg, NULL, 0));
+    savegamevalues(&snap->values, st, lg);
+    memcpy(snap->map, st->map, sizeof snap->map);
+    snap->enginesize = (*lg->savestate)(lg, snap->engine,
+				snap->allocated - offsetof(gamesnapshot, engine));
+    snap->enginehead = (*lg->savestatehead)(lg, NULL, 0);
+    return snap;
+}
+
+/* Return a game state and its logic module to the state recorded in
+ * snap. FALSE is returned if snap cannot be used with the game state.
+ */
+static int applysnapshot(gamesnapshot const *snap, gamestate *st,
+			 gamelogic *lg)
+{
+    if (!applygamevalues(&snap->values, st, lg))
+	return FALSE;
+    memcpy(st->map, snap->map, sizeof st->map);
+    if (st->changes)
+	st->changes->all = TRUE;
+
+    return (*lg->restorestate)(lg, snap->engine, snap->enginesize);
+}
+
+/* Record the current state of the game in progress.
+ */
+gamesnapshot *savegamesnapshot(gamesnapshot *snap)
+{
+    if (!logic)
+	return NULL;
+    return takesnapshot(snap, &state, logic);
+}
+
+/* Return the current game to a recorded state, and set the timer to
+ * continue from there.
+ */
+int restoregamesnapshot(gamesnapshot const *snap)
+{
+    clearrewind();
+    if (!logic || !applysnapshot(snap, &state, logic))
+	return FALSE;
+    settickcount(state.currenttime + 1);
+    return TRUE;
+}
+
+/* Return the tick count at which a snapshot was taken.
+ */
+int gamesnapshottime(gamesnapshot const *snap)
+{
+    return snap->values.currenttime;
+}
+
+/* Free a snapshot.
+ */
+void freegamesnapshot(gamesnapshot *snap)
+{
+    free(snap);
+}
+
+/*
+ * Rewinding the game in progress.
+ */
+
+/* The number of ticks of history kept for rewinding.
+ */
+#define	REWIND_TICKS	(60 * TICKS_PER_SECOND)
+
+/* A map cell as it was before a tick changed it.
+ */
+typedef struct rewindcell {
+    short		pos;		/* the cell's location */
+    mapcell		cell;		/* what it held */
+} rewindcell;
+
+/* What one tick changed, recorded backwards: the game's values, the
+ * map cells that the change log lists for the tick, and the logic
+ * module's state, all as they were before the tick. Of the logic's
+ * state, only its head and the creature slots that the log lists are
+ * kept (see logic.h), unless whole is TRUE, in which case engine
+ * holds all of it.
+ */
+typedef	struct tickdelta {
+    gamevalues		values;		/* the values before the tick */
+    rewindcell	       *cells;		/* the changed cells before it */
+    int			cellcount;
+    int			cellsallocated;
+    unsigned char      *engine;		/* the logic's state before it */
+    int			whole;		/* TRUE if engine has all of it */
+    int			enginesize;	/* the size of the whole state */
+    int			enginehead;	/* the size of its head */
+    int			engineallocated;
+    int		       *slots;		/* the creature slots in engine */
+    int			slotcount;
+    int			slotsallocated;
+} tickdelta;
+
+/* The rewind history of the game in progress: a ring buffer of the
+ * deltas of the most recent ticks, and a snapshot of the game as it
+ * stands after the latest one. Each delta is made from the change
+ * log, which is cleared after every tick while the history is kept,
+ * so recording a tick and stepping back over it cost in proportion to
+ * the cells and creatures that the tick changed, plus the head of the
+ * logic's state. The exception is a tick that changes the length of
+ * one of the logic's lists, or the size of the head, as the logic's
+ * state is then copied whole. The history is only kept when there is
+ * a user to ask for it.
+ * rewindrestored is TRUE when the game has just been stepped back, as
+ * the change log is then marked as having changed entirely while its
+ * list of cells remains good.
+ */
+static tickdelta	rewindring[REWIND_TICKS];
+static int		rewindhead = 0;
+static int		rewindcount = 0;
+static int		rewindvalid = FALSE;
+static int		rewindrestored = FALSE;
+static gamesnapshot    *rewindcur = NULL;
+
+/* Forget the rewind history. This is done whenever the game state is
+ * changed other than by playing a tick.
+ */
+static void clearrewind(void)
+{
+    rewindvalid = FALSE;
+    rewindrestored = FALSE;
+    rewindcount = 0;
+}
+
+/* Record in delta the cells listed in the change log as they were
+ * before the tick, and bring the snapshot's map up to date.
+ */
+static void rewindcells(tickdelta *delta, changelog const *log)
+{
+    int	pos, n;
+
+    if (log->cellcount > delta->cellsallocated) {
+	delta->cellsallocated = log->cellcount + 64;
+	x_alloc(delta->cells, delta->cellsallocated * sizeof *delta->cells);
+    }
+    for (n = 0 ; n < log->cellcount ; ++n) {
+	pos = log->cells[n];
+	delta->cells[n].pos = pos;
+	delta->cells[n].cell = rewindcur->map[pos];
+	rewindcur->map[pos] = state.map[pos];
+    }
+    delta->cellcount = log->cellcount;
+}
+
+/* Record in delta the logic module's state as it was before the tick,
+ * and bring the snapshot's copy up to date. As long as the sizes of
+ * the state and of its head are unchanged, only the head and the
+ * creature slots listed in the change log are copied, with the
+ * creatures as they are now being taken from the log. If whole is
+ * TRUE, or the sizes have changed, the state is copied whole.
+ */
+static void rewindengine(tickdelta *delta, changelog const *log, int whole)
+{
+    unsigned char      *p, *cr;
+    int			size, head, n;
+
+    size = (*logic->savestate)(logic, NULL, 0);
+    head = (*logic->savestatehead)(logic, NULL, 0);
+    delta->enginesize = rewindcur->enginesize;
+    delta->enginehead = rewindcur->enginehead;
+    delta->whole = whole || !log->haveafter
+			 || size != rewindcur->enginesize
+			 || head != rewindcur->enginehead
+			 || log->aftercount * (int)sizeof(creature)
+							!= size - head;
+    if (delta->whole) {
+	if (rewindcur->enginesize > delta->engineallocated) {
+	    delta->engineallocated = rewindcur->enginesize + 256;
+	    x_alloc(delta->engine, delta->engineallocated);
+	}
+	memcpy(delta->engine, rewindcur->engine, rewindcur->enginesize);
+	rewindcur = growsnapshot(rewindcur, size);
+	rewindcur->enginesize = (*logic->savestate)(logic, rewindcur->engine,
+						    size);
+	rewindcur->enginehead = head;
+	return;
+    }
+
+    n = head + log->slotcount * sizeof(creature);
+    if (n > delta->engineallocated) {
+	delta->engineallocated = n + 256;
+	x_alloc(delta->engine, delta->engineallocated);
+    }
+    if (log->slotcount > delta->slotsallocated) {
+	delta->slotsallocated = log->slotcount + 64;
+	x_alloc(delta->slots, delta->slotsallocated * sizeof *delta->slots);
+    }
+    memcpy(delta->engine, rewindcur->engine, head);
+    (*logic->savestatehead)(logic, rewindcur->engine, head);
+    p = delta->engine + head;
+    for (n = 0 ; n < log->slotcount ; ++n, p += sizeof(creature)) {
+	delta->slots[n] = log->slots[n].slot;
+	cr = rewindcur->engine + head + delta->slots[n] * sizeof(creature);
+	memcpy(p, cr, sizeof(creature));
+	memcpy(cr, log->after + delta->slots[n], sizeof(creature));
+    }
+    delta->slotcount = log->slotcount;
+}
+
+/* Add the tick just played to the rewind history, and clear the
+ * change log for the next one. If the history does not lead up to the
+ * tick, or the log does not cover it, the history is started over
+ * from here.
+ */
+static void recordrewind(void)
+{
+    tickdelta  *delta;
+    changelog  *log;
+
+    if (batchmode)
+	return;
+    if (!state.changes)
+	setchangelogging(TRUE);
+    log = state.changes;
+    if (!rewindvalid || (log->all && !rewindrestored)
+		     || rewindcur->values.currenttime != state.currenttime - 1) {
+	rewindcur = takesnapshot(rewindcur, &state, logic);
+	rewindcount = 0;
+	rewindvalid = TRUE;
+	rewindrestored = FALSE;
+	clearchangelog(log);
+	return;
+    }
+
+    delta = rewindring + rewindhead;
+    delta->values = rewindcur->values;
+    savegamevalues(&rewindcur->values, &state, logic);
+    rewindcells(delta, log);
+    rewindengine(delta, log, rewindrestored);
+    rewindhead = (rewindhead + 1) % REWIND_TICKS;
+    if (rewindcount < REWIND_TICKS)
+	++rewindcount;
+    rewindrestored = FALSE;
+    clearchangelog(log);
+}
+
+/* Free the memory used by the rewind history.
+ */
+static void freerewind(void)
+{
+    int	n;
+
+    clearrewind();
+    for (n = 0 ; n < REWIND_TICKS ; ++n) {
+	free(rewindring[n].cells);
+	rewindring[n].cells = NULL;
+	rewindring[n].cellsallocated = 0;
+	free(rewindring[n].engine);
+	rewindring[n].engine = NULL;
+	rewindring[n].engineallocated = 0;
+	free(rewindring[n].slots);
+	rewindring[n].slots = NULL;
+	rewindring[n].slotsallocated = 0;
+    }
+    freegamesnapshot(rewindcur);
+    rewindcur = NULL;
+}
+
+/* Take the game in progress back by up to the given number of ticks,
+ * and set the timer to continue from there. Each delta is undone on
+ * the snapshot of the latest tick, which is then restored. During
+ * live play, the moves made in the ticks taken back are dropped from
+ * the move list, so that it remains a solution for the game as it now
+ * stands. The return value is the number of ticks actually taken
+ * back.
+ */
+int rewindgame(int ticks)
+{
+    tickdelta const	       *delta;
+    unsigned char const	       *p;
+    int				n, i;
+
+    if (!logic || !rewindvalid)
+	return 0;
+    for (n = 0 ; n < ticks && rewindcount ; ++n) {
+	rewindhead = (rewindhead + REWIND_TICKS - 1) % REWIND_TICKS;
+	--rewindcount;
+	delta = rewindring + rewindhead;
+	rewindcur->values = delta->values;
+	for (i = delta->cellcount - 1 ; i >= 0 ; --i)
+	    rewindcur->map[delta->cells[i].pos] = delta->cells[i].cell;
+	if (delta->whole) {
+	    rewindcur = growsnapshot(rewindcur, delta->enginesize);
+	    memcpy(rewindcur->engine, delta->engine, delta->enginesize);
+	} else {
+	    p = delta->engine;
+	    memcpy(rewindcur->engine, p, delta->enginehead);
+	    p += delta->enginehead;
+	    for (i = 0 ; i < delta->slotcount ; ++i, p += sizeof(creature))
+		memcpy(rewindcur->engine + delta->enginehead
+					 + delta->slots[i] * sizeof(creature),
+		       p, sizeof(creature));
+	}
+	rewindcur->enginesize = delta->enginesize;
+	rewindcur->enginehead = delta->enginehead;
+    }
+    if (!n)
+	return 0;
+    if (!applysnapshot(rewindcur, &state, logic)) {
+	clearrewind();
+	return 0;
+    }
+    rewindrestored = TRUE;
+    settickcount(state.currenttime + 1);
+    return n;
+}
+
+/* Change a game state to run from its level's recorded solution. The
+ * moves are decoded from the solution data one at a time as they come
+ * due, rather than being expanded into the state's move list.
+ */
+static int loadplayback(gamestate *st)
 {
     solutioninfo	solution;
+    solutioncursor	cursor;
 
-    if (!state.game->solutionsize)
+    if (!st->game->solutionsize)
 	return FALSE;
-    solution.moves.list = NULL;
-    solution.moves.allocated = 0;
-    if (!expandsolution(&solution, state.game) || !solution.moves.count)
+    if (!opensolution(&solution, &cursor, st->game) || !cursor.more)
 	return FALSE;
 
-    destroymovelist(&state.moves);
-    state.moves = solution.moves;
-    restartprng(&state.mainprng, solution.rndseed);
-    state.initrndslidedir = solution.rndslidedir;
-    state.stepping = solution.stepping;
-    state.replay = 0;
+    initmovelist(&st->moves);
+    st->replaycursor = cursor;
+    restartprng(&st->mainprng, solution.rndseed);
+    st->initrndslidedir = solution.rndslidedir;
+    st->stepping = solution.stepping;
+    st->replay = 0;
+    return TRUE;
+}
+
+/* Change the current state to run from the recorded solution.
+ */
+int prepareplayback(void)
+{
+    if (!loadplayback(&state))
+	return FALSE;
+    clearrewind();
+    checkkeyframes();
+    recordkeyframe(&state, logic);
     return TRUE;
 }
 
@@ -257,62 +790,106 @@ void advanceinitrandomff(int display)
     }
 }
 
-/* Advance the game one tick and update the game state. cmd is the
- * current keyboard command supplied by the user. The return value is
- * positive if the game was completed successfully, negative if the
- * game ended unsuccessfully, and zero otherwise.
+/* Advance a game state by one tick, the tick count having already
+ * been stored in currenttime. cmd is the current keyboard command
+ * supplied by the user. The return value is positive if the game was
+ * completed successfully, negative if the game ended unsuccessfully,
+ * and zero otherwise.
  */
-int doturn(int cmd)
+static int advancestate(gamestate *st, gamelogic *lg, int cmd)
 {
     action	act;
     int		n;
 
-    state.soundeffects &= ~((1 << SND_ONESHOT_COUNT) - 1);
-    state.currenttime = gettickcount();
-    if (state.currenttime >= MAXIMUM_TICK_COUNT) {
+    st->soundeffects &= ~((1 << SND_ONESHOT_COUNT) - 1);
+    if (st->currenttime >= MAXIMUM_TICK_COUNT) {
 	errmsg(NULL, "timer reached its maximum of %d.%d hours; quitting now",
 		     MAXIMUM_TICK_COUNT / (TICKS_PER_SECOND * 3600),
 		     (MAXIMUM_TICK_COUNT / (TICKS_PER_SECOND * 360)) % 10);
 	return -1;
     }
-    if (state.replay < 0) {
+    if (st->replay < 0) {
 	if (cmd != CmdPreserve)
-	    state.currentinput = cmd;
+	    st->currentinput = cmd;
     } else {
-	if (state.replay < state.moves.count) {
-	    if (state.currenttime > state.moves.list[state.replay].when)
+	if (st->replaycursor.more) {
+	    if (st->currenttime > st->replaycursor.next.when)
 		warn("Replay: Got ahead of saved solution: %d > %d!",
-		     state.currenttime, state.moves.list[state.replay].when);
-	    if (state.currenttime == state.moves.list[state.replay].when) {
-		state.currentinput = state.moves.list[state.replay].dir;
-		++state.replay;
+		     st->currenttime, st->replaycursor.next.when);
+	    if (st->currenttime == st->replaycursor.next.when) {
+		st->currentinput = st->replaycursor.next.dir;
+		++st->replay;
+		nextsolutionmove(&st->replaycursor, st->game);
 	    }
 	} else {
-	    n = state.currenttime + state.timeoffset - 1;
-	    if (n > state.game->besttime)
+	    n = st->currenttime + st->timeoffset - 1;
+	    if (n > st->game->besttime)
 		return -1;
 	}
     }
 
-    n = (*logic->advancegame)(logic);
+    n = (*lg->advancegame)(lg);
 
-    if (state.replay < 0 && state.lastmove) {
-	act.when = state.currenttime;
-	act.dir = state.lastmove;
-	addtomovelist(&state.moves, act);
-	state.lastmove = NIL;
+    if (st->replay < 0 && st->lastmove) {
+	act.when = st->currenttime;
+	act.dir = st->lastmove;
+	addtomovelist(&st->moves, act);
+	st->lastmove = NIL;
     }
 
     return n;
 }
 
+/* Advance the game one tick and update the game state. cmd is the
+ * current keyboard command supplied by the user. The return value is
+ * positive if the game was completed successfully, negative if the
+ * game ended unsuccessfully, and zero otherwise.
+ */
+int doturn(int cmd)
+{
+    int	n;
+
+    state.currenttime = gettickcount();
+    n = advancestate(&state, logic, cmd);
+    if (state.replay >= 0 && iskeyframesource(&state)) {
+	if (!n)
+	    recordkeyframe(&state, logic);
+	else
+	    setplaybacklength(state.currenttime);
+    }
+    recordrewind();
+    return n;
+}
+
+/* Work out the time left and the best time to display for the given
+ * game state.
+ */
+static void getdisplaytimes(gamestate const *st, int *timeleft,
+			    int *besttime)
+{
+    int	currenttime;
+
+    currenttime = st->currenttime + st->timeoffset;
+    if (hassolution(st->game))
+	*besttime = (st->game->time ? st->game->time : 999)
+				- st->game->besttime / TICKS_PER_SECOND;
+    else
+	*besttime = TIME_NIL;
+
+    *timeleft = TIME_NIL;
+    if (st->game->time) {
+	*timeleft = st->game->time - currenttime / TICKS_PER_SECOND;
+	if (*timeleft < 0)
+	    *timeleft = 0;
+    }
+}
+
 /* Update the display to show the current game state (including sound
  * effects, if any). If showframe is FALSE, then nothing is actually
  * displayed.
  */
 int drawscreen(int showframe)
 {
-    int	currenttime;
     int timeleft, besttime;
 
     playsoundeffects(state.soundeffects);
@@ -320,23 +897,33 @@ int drawscreen(int showframe)
     if (!showframe)
 	return TRUE;
 
-    currenttime = state.currenttime + state.timeoffset;
-    if (hassolution(state.game))
-	besttime = (state.game->time ? state.game->time : 999)
-				- state.game->besttime / TICKS_PER_SECOND;
-    else
-	besttime = TIME_NIL;
-
-    timeleft = TIME_NIL;
-    if (state.game->time) {
-	timeleft = state.game->time - currenttime / TICKS_PER_SECOND;
-	if (timeleft <= 0) {
-	    timeleft = 0;
-	    setdisplaymsg("Out of time", 2, 2);
-	}
+    getdisplaytimes(&state, &timeleft, &besttime);
+    if (timeleft == 0)
+	setdisplaymsg("Out of time", 2, 2);
+    return displaygame(&state, timeleft, besttime);
+}
+
+/* Start or stop keeping a log of the changes made to the current game
+ * state. The log is kept across games, and marked as having changed
+ * completely whenever a new game begins.
+ */
+int setchangelogging(int enable)
+{
+    if (enable) {
+	if (!state.changes)
+	    state.changes = newchangelog();
+    } else if (state.changes) {
+	freechangelog(state.changes);
+	state.changes = NULL;
     }
+    return TRUE;
+}
 
-    return displaygame(&state, timeleft, besttime);
+/* Return the log of changes made to the current game state.
+ */
+struct changelog *getchangelog(void)
+{
+    return state.changes;
 }
 
 /* Stop game play and clean up.
@@ -352,6 +939,9 @@ int quitgamestate(void)
  */
 int endgamestate(void)
 {
+    stopplaythread();
+    stoppresimulation();
+    clearrewind();
     setsoundeffects(-1);
     return (*logic->endgame)(logic);
 }
@@ -360,6 +950,9 @@ int endgamestate(void)
  */
 void shutdowngamestate(void)
 {
+    clearkeyframes();
+    freerewind();
+    setchangelogging(FALSE);
     setrulesetbehavior(Ruleset_None);
     destroymovelist(&state.moves);
 }
@@ -381,6 +974,229 @@ void setenddisplay(void)
     (*logic->initgame)(logic);
 }
 
+/*
+ * Running the game on a separate thread.
+ */
+
+/* A copy of the parts of one tick of the game that are displayed:
+ * the map, the creatures, the inventory and the times. The display
+ * only ever sees one of these while the play thread is running, never
+ * the game state itself.
+ */
+typedef struct gameview {
+    gamestate		state;		/* the displayed parts of the game */
+    creature	       *creatures;	/* the copy of the creature list */
+    int			crallocated;	/* room in the creature list */
+    int			timeleft;	/* the time left to display */
+    int			besttime;	/* the best time to display */
+    int			status;		/* the result of the tick */
+} gameview;
+
+/* The views are triple-buffered. The play thread fills in the back
+ * view and then swaps it with the ready view, and the display swaps
+ * the ready view with the front view before drawing it. Thus neither
+ * side ever waits for the other to finish with a view, and the
+ * display always draws the latest tick. The indexes, viewready,
+ * playthreadstop and playthreadcmd are guarded by viewlock.
+ */
+static gameview		views[3];
+static int		backview = 0;
+static int		readyview = 1;
+static int		frontview = 2;
+static int		viewready = FALSE;
+static pthread_mutex_t	viewlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	viewposted = PTHREAD_COND_INITIALIZER;
+
+/* The play thread, which runs the current game in real time.
+ * playthreadcmd holds the latest command from the user that the
+ * thread has yet to act on, or CmdPreserve if there is none.
+ */
+static pthread_t	playthread;
+static int		playthreadrunning = FALSE;
+static int		playthreadstop = FALSE;
+static int		playthreadcmd = CmdPreserve;
+static int		playthreadfirstcmd = CmdNone;
+
+/* Copy the displayed parts of the current game state into a view.
+ */
+static void copygameview(gameview *view, int status)
+{
+    gamestate  *st = &view->state;
+    int		n;
+
+    st->game = state.game;
+    st->ruleset = state.ruleset;
+    st->replay = state.replay;
+    st->timelimit = state.timelimit;
+    st->currenttime = state.currenttime;
+    st->timeoffset = state.timeoffset;
+    st->currentinput = state.currentinput;
+    st->chipsneeded = state.chipsneeded;
+    st->xviewpos = state.xviewpos;
+    st->yviewpos = state.yviewpos;
+    memcpy(st->keys, state.keys, sizeof st->keys);
+    memcpy(st->boots, state.boots, sizeof st->boots);
+    st->statusflags = state.statusflags;
+    st->lastmove = state.lastmove;
+    st->initrndslidedir = state.initrndslidedir;
+    st->stepping = state.stepping;
+    st->soundeffects = state.soundeffects;
+    memcpy(st->hinttext, state.hinttext, sizeof st->hinttext);
+    memcpy(st->map, state.map, sizeof st->map);
+
+    for (n = 0 ; state.creatures[n].id ; ++n) ;
+    if (n + 1 > view->crallocated) {
+	view->crallocated = n + 1 + 64;
+	x_alloc(view->creatures, view->crallocated * sizeof *view->creatures);
+    }
+    memcpy(view->creatures, state.creatures, (n + 1) * sizeof *state.creatures);
+    st->creatures = view->creatures;
+
+    getdisplaytimes(&state, &view->timeleft, &view->besttime);
+    view->status = status;
+}
+
+/* Make the back view the ready view. If the display never drew the
+ * previous ready view, its one-shot sound effects are passed on, so
+ * that they are still heard.
+ */
+static void postgameview(void)
+{
+    unsigned long	oneshots = (1UL << SND_ONESHOT_COUNT) - 1;
+    int			n;
+
+    pthread_mutex_lock(&viewlock);
+    if (viewready)
+	views[backview].state.soundeffects |=
+			views[readyview].state.soundeffects & oneshots;
+    n = readyview;
+    readyview = backview;
+    backview = n;
+    viewready = TRUE;
+    pthread_cond_signal(&viewposted);
+    pthread_mutex_unlock(&viewlock);
+}
+
+/* The play thread. Each tick is run as soon as it is due, and then
+ * posted to the display. The thread ends when the game does, or
+ * when it is told to stop. The stop request is only looked at once
+ * the next tick is due, so that the timer is never left part-way
+ * through a tick.
+ */
+static void *runplaythread(void *data)
+{
+    int	cmd, stop, n;
+
+    cmd = playthreadfirstcmd;
+    for (;;) {
+	n = doturn(cmd);
+	copygameview(views + backview, n);
+	postgameview();
+	if (n)
+	    break;
+	waitfortick();
+	pthread_mutex_lock(&viewlock);
+	stop = playthreadstop;
+	cmd = playthreadcmd;
+	playthreadcmd = CmdPreserve;
+	pthread_mutex_unlock(&viewlock);
+	if (stop)
+	    break;
+    }
+    return data;
+}
+
+/* Start running the current game on the play thread, beginning with
+ * a tick that uses the given command.
+ */
+int startplaythread(int cmd)
+{
+    if (playthreadrunning)
+	return TRUE;
+    pthread_mutex_lock(&viewlock);
+    viewready = FALSE;
+    playthreadstop = FALSE;
+    playthreadcmd = CmdPreserve;
+    pthread_mutex_unlock(&viewlock);
+    playthreadfirstcmd = cmd;
+    if (pthread_create(&playthread, NULL, runplaythread, NULL)) {
+	warn("unable to start play thread");
+	return FALSE;
+    }
+    playthreadrunning = TRUE;
+    return TRUE;
+}
+
+/* Draw the given view, if there is one to draw, and return the
+ * result of its tick.
+ */
+static int drawgameview(int ready)
+{
+    gameview   *view;
+    int		n;
+
+    if (!ready)
+	return 0;
+    pthread_mutex_lock(&viewlock);
+    n = frontview;
+    frontview = readyview;
+    readyview = n;
+    viewready = FALSE;
+    pthread_mutex_unlock(&viewlock);
+
+    view = views + frontview;
+    playsoundeffects(view->state.soundeffects);
+    if (view->timeleft == 0)
+	setdisplaymsg("Out of time", 2, 2);
+    displaygame(&view->state, view->timeleft, view->besttime);
+    return view->status;
+}
+
+/* Wait for the play thread to post a tick that has not been drawn
+ * yet, and draw it.
+ */
+int drawplaythread(void)
+{
+    if (!playthreadrunning)
+	return 0;
+    pthread_mutex_lock(&viewlock);
+    while (!viewready)
+	pthread_cond_wait(&viewposted, &viewlock);
+    pthread_mutex_unlock(&viewlock);
+    return drawgameview(TRUE);
+}
+
+/* Pass a command from the user to the play thread.
+ */
+void sendplaythread(int cmd)
+{
+    pthread_mutex_lock(&viewlock);
+    if (cmd != CmdPreserve)
+	playthreadcmd = cmd;
+    pthread_mutex_unlock(&viewlock);
+}
+
+/* Tell the play thread to stop, wait for it to do so, and then draw
+ * the last tick it ran if the display has not already done so.
+ */
+int stopplaythread(void)
+{
+    int	ready;
+
+    if (!playthreadrunning)
+	return 0;
+    pthread_mutex_lock(&viewlock);
+    playthreadstop = TRUE;
+    pthread_mutex_unlock(&viewlock);
+    pthread_join(playthread, NULL);
+    playthreadrunning = FALSE;
+    pthread_mutex_lock(&viewlock);
+    ready = viewready;
+    pthread_mutex_unlock(&viewlock);
+    drawgameview(ready);
+    return views[frontview].status;
+}
+
 /*
  * Solution handling functions.
  */
@@ -416,6 +1232,7 @@ int replacesolution(void)
     solution.flags = 0;
     solution.rndslidedir = state.initrndslidedir;
     solution.stepping = state.stepping;
+    clearkeyframes();
     if (!contractsolution(&solution, state.game))
 	return FALSE;
 
@@ -429,40 +1246,374 @@ int deletesolution(void)
 {
     if (!hassolution(state.game))
 	return FALSE;
+    clearkeyframes();
     state.game->besttime = TIME_NIL;
     state.game->sgflags &= ~SGF_REPLACEABLE;
-    free(state.game->solutiondata);
-    state.game->solutionsize = 0;
-    state.game->solutiondata = NULL;
+    freesolutiondata(state.game);
     return TRUE;
 }
 
-/* Double-checks the timing for a solution that has just been played
- * back. If the timing is off, and the cause of the discrepancy can be
- * reasonably ascertained to be benign, the timing will be corrected
- * and TRUE is returned.
+/* Double-checks the timing for a solution that took currenttime
+ * ticks to play back. If the timing is off, and the cause of the
+ * discrepancy can be reasonably ascertained to be benign, the timing
+ * will be corrected and TRUE is returned.
  */
-int checksolution(void)
+static int checkreplaytime(gamesetup *game, int currenttime, int timeoffset)
 {
-    int	currenttime;
+    int	playtime;
 
-    if (!hassolution(state.game))
+    if (!hassolution(game))
 	return FALSE;
-    currenttime = state.currenttime + state.timeoffset;
-    if (currenttime == state.game->besttime)
+    playtime = currenttime + timeoffset;
+    if (playtime == game->besttime)
 	return FALSE;
     warn("saved game has solution time of %d ticks, but replay took %d ticks",
-	 state.game->besttime, currenttime);
-    if (state.game->besttime == state.currenttime) {
+	 game->besttime, playtime);
+    if (game->besttime == currenttime) {
 	warn("difference matches clock offset; fixing.");
-	state.game->besttime = currenttime;
+	game->besttime = playtime;
 	return TRUE;
-    } else if (currenttime - state.game->besttime == 1) {
+    } else if (playtime - game->besttime == 1) {
 	warn("difference matches pre-0.10.1 error; fixing.");
-	state.game->besttime = currenttime;
+	game->besttime = playtime;
 	return TRUE;
     }
     warn("reason for difference unknown.");
-    state.game->besttime = currenttime;
+    game->besttime = playtime;
     return FALSE;
 }
+
+/* Double-checks the timing for a solution that has just been played
+ * back.
+ */
+int checksolution(void)
+{
+    return checkreplaytime(state.game, state.currenttime, state.timeoffset);
+}
+
+/*
+ * Keyframes for seeking within a playback.
+ */
+
+/* The maximum number of keyframes kept for one solution.
+ */
+#define	MAX_KEYFRAMES	1024
+
+/* Snapshots taken at regular intervals while the current level's
+ * solution is being played back, in order of time. The first one is
+ * always the starting position. When the index fills up, every other
+ * keyframe is dropped and the interval between them is doubled, so
+ * that any length of solution can be covered in bounded memory. The
+ * keyframes, and the length of the playback once it is known, can be
+ * added to by the presimulation thread as well, and so are only
+ * looked at with keyframelock held.
+ */
+static pthread_mutex_t	keyframelock = PTHREAD_MUTEX_INITIALIZER;
+static gamesnapshot    *keyframes[MAX_KEYFRAMES];
+static int		keyframecount = 0;
+static int		keyframeinterval = TICKS_PER_SECOND;
+static int		playbacklength = -1;
+
+/* The solution that the keyframes are made from. These are only used
+ * by the thread running the current game.
+ */
+static gamesetup       *keyframegame = NULL;
+static unsigned char   *keyframesolution = NULL;
+static int		keyframesolutionsize = 0;
+static int		keyframeruleset = Ruleset_None;
+
+/* The presimulation thread, which plays through the solution on its
+ * own game state ahead of the user. presimcancel is guarded by
+ * keyframelock. presimgame is a copy of the level's setup, made
+ * before the thread starts, so that the thread never reads the fields
+ * that the main thread goes on to change (checksolution() corrects
+ * the best time, for one). The level and solution data it points to
+ * are only changed or freed after the thread has been stopped.
+ */
+static pthread_t	presimthread;
+static int		presimrunning = FALSE;
+static int		presimcancel = FALSE;
+static gamesetup	presimgame;
+static int		presimruleset = Ruleset_None;
+
+/* Discard all keyframes, stopping the presimulation thread first.
+ */
+static void clearkeyframes(void)
+{
+    stoppresimulation();
+    while (keyframecount)
+	freegamesnapshot(keyframes[--keyframecount]);
+    keyframeinterval = TICKS_PER_SECOND;
+    playbacklength = -1;
+    keyframegame = NULL;
+    keyframesolution = NULL;
+    keyframesolutionsize = 0;
+    keyframeruleset = Ruleset_None;
+}
+
+/* Return TRUE if the keyframes are made from the solution that the
+ * given game state plays back.
+ */
+static int iskeyframesource(gamestate const *st)
+{
+    return keyframegame == st->game && keyframeruleset == st->ruleset
+				&& keyframesolution == st->game->solutiondata
+				&& keyframesolutionsize == st->game->solutionsize;
+}
+
+/* Make the keyframes belong to the current level's solution,
+ * discarding them if they were made from another one.
+ */
+static void checkkeyframes(void)
+{
+    if (iskeyframesource(&state))
+	return;
+    clearkeyframes();
+    keyframegame = state.game;
+    keyframesolution = state.game->solutiondata;
+    keyframesolutionsize = state.game->solutionsize;
+    keyframeruleset = state.ruleset;
+}
+
+/* Take a keyframe of the given game state if one is due. Keyframes
+ * are only ever added beyond the last one, so the same stretch of the
+ * solution can be played repeatedly, on either thread, without
+ * duplicating them. FALSE is returned if the presimulation thread has
+ * been asked to stop.
+ */
+static int recordkeyframe(gamestate const *st, gamelogic *lg)
+{
+    int	last, i, n, ret;
+
+    if (st->currenttime >= 0 && st->currenttime % TICKS_PER_SECOND)
+	return TRUE;
+
+    pthread_mutex_lock(&keyframelock);
+    ret = !presimcancel;
+    if (keyframecount) {
+	last = gamesnapshottime(keyframes[keyframecount - 1]);
+	if (st->currenttime % keyframeinterval || st->currenttime <= last)
+	    goto done;
+    } else if (st->currenttime >= 0) {
+	goto done;
+    }
+
+    if (keyframecount == MAX_KEYFRAMES) {
+	keyframeinterval *= 2;
+	for (i = n = 1 ; i < keyframecount ; ++i) {
+	    if (gamesnapshottime(keyframes[i]) % keyframeinterval)
+		freegamesnapshot(keyframes[i]);
+	    else
+		keyframes[n++] = keyframes[i];
+	}
+	keyframecount = n;
+	if (st->currenttime % keyframeinterval)
+	    goto done;
+    }
+    keyframes[keyframecount++] = takesnapshot(NULL, st, lg);
+
+  done:
+    pthread_mutex_unlock(&keyframelock);
+    return ret;
+}
+
+/* Record how many ticks the playback of the solution lasts.
+ */
+static void setplaybacklength(int length)
+{
+    pthread_mutex_lock(&keyframelock);
+    playbacklength = length;
+    pthread_mutex_unlock(&keyframelock);
+}
+
+/* Move the playback to the latest keyframe before the time at which
+ * the given number of seconds will have been played, or leave it
+ * where it is if it is already past that keyframe and short of the
+ * target. FALSE is returned if there is no keyframe to move back to.
+ */
+int seekplayback(int seconds)
+{
+    int	target, i, f;
+
+    if (state.replay < 0)
+	return FALSE;
+    checkkeyframes();
+    target = seconds * TICKS_PER_SECOND - state.timeoffset;
+
+    pthread_mutex_lock(&keyframelock);
+    for (i = keyframecount - 1 ; i >= 0 ; --i)
+	if (gamesnapshottime(keyframes[i]) < target)
+	    break;
+    if (i < 0)
+	f = FALSE;
+    else if (state.currenttime < target
+			&& gamesnapshottime(keyframes[i]) <= state.currenttime)
+	f = TRUE;
+    else
+	f = restoregamesnapshot(keyframes[i]);
+    pthread_mutex_unlock(&keyframelock);
+    return f;
+}
+
+/* Return the number of ticks that the current level's solution takes
+ * to play back, or -1 if that is not known yet.
+ */
+int getplaybacklength(void)
+{
+    int	length;
+
+    if (!iskeyframesource(&state))
+	return -1;
+    pthread_mutex_lock(&keyframelock);
+    length = playbacklength;
+    pthread_mutex_unlock(&keyframelock);
+    return length;
+}
+
+/* Create a new instance of the logic module for the given ruleset.
+ */
+static gamelogic *createlogic(int ruleset)
+{
+    switch (ruleset) {
+      case Ruleset_Lynx:	return lynxlogicstartup();
+      case Ruleset_MS:		return mslogicstartup();
+    }
+    errmsg(NULL, "unknown ruleset requested (ruleset=%d)", ruleset);
+    return NULL;
+}
+
+/* The presimulation thread. The solution is played back from start
+ * to finish on a private game state and logic module, recording
+ * keyframes along the way, unless the thread is told to stop first.
+ * The thread gives way to others after every second of game time, so
+ * that it does not hold up the game being displayed.
+ */
+static void *presimulate(void *data)
+{
+    gamestate  *st;
+    gamelogic  *lg;
+    int		f = 0;
+
+    lg = createlogic(presimruleset);
+    if (!lg)
+	return NULL;
+    st = calloc(1, sizeof *st);
+    if (!st)
+	memerrexit();
+    lg->state = st;
+
+    if (resetgamestate(st, lg, &presimgame, presimruleset)
+			&& loadplayback(st) && recordkeyframe(st, lg)) {
+	st->currenttime = 0;
+	while (!(f = advancestate(st, lg, CmdNone))) {
+	    if (!recordkeyframe(st, lg))
+		break;
+	    if (!(st->currenttime % TICKS_PER_SECOND))
+		sched_yield();
+	    ++st->currenttime;
+	}
+	if (f)
+	    setplaybacklength(st->currenttime);
+    }
+
+    (*lg->endgame)(lg);
+    (*lg->shutdown)(lg);
+    destroymovelist(&st->moves);
+    free(st);
+    return data;
+}
+
+/* Start the presimulation thread for the current level's solution,
+ * unless it is already running or its work is already done.
+ */
+int startpresimulation(void)
+{
+    int	done;
+
+    if (!logic || !state.game || !hassolution(state.game)
+			      || !state.game->solutionsize)
+	return FALSE;
+    checkkeyframes();
+    if (presimrunning)
+	return TRUE;
+    pthread_mutex_lock(&keyframelock);
+    done = playbacklength >= 0;
+    presimcancel = FALSE;
+    pthread_mutex_unlock(&keyframelock);
+    if (done)
+	return TRUE;
+
+    presimgame = *state.game;
+    presimruleset = state.ruleset;
+    if (pthread_create(&presimthread, NULL, presimulate, NULL)) {
+	warn("unable to start presimulation thread");
+	return FALSE;
+    }
+    presimrunning = TRUE;
+    return TRUE;
+}
+
+/* Tell the presimulation thread to stop, and wait for it to do so.
+ */
+static void stoppresimulation(void)
+{
+    if (!presimrunning)
+	return;
+    pthread_mutex_lock(&keyframelock);
+    presimcancel = TRUE;
+    pthread_mutex_unlock(&keyframelock);
+    pthread_join(presimthread, NULL);
+    presimrunning = FALSE;
+}
+
+/*
+ * Standalone verification.
+ */
+
+/* Play back the solution for the given level from start to finish,
+ * using a private game state and logic module, and store the outcome
+ * in result. Nothing outside of result is modified, so separate
+ * levels can be verified concurrently. FALSE is returned if the
+ * solution could not be set up for playback.
+ */
+int verifysolution(gamesetup *game, int ruleset, verifyresult *result)
+{
+    gamestate  *st;
+    gamelogic  *lg;
+    int		f;
+
+    result->status = 0;
+    result->currenttime = 0;
+    result->timeoffset = 0;
+
+    lg = createlogic(ruleset);
+    if (!lg)
+	return FALSE;
+    st = calloc(1, sizeof *st);
+    if (!st)
+	memerrexit();
+    lg->state = st;
+
+    if (resetgamestate(st, lg, game, ruleset) && loadplayback(st)) {
+	st->currenttime = 0;
+	while (!(f = advancestate(st, lg, CmdNone)))
+	    ++st->currenttime;
+	result->status = f;
+	result->currenttime = st->currenttime;
+	result->timeoffset = st->timeoffset;
+    }
+
+    (*lg->endgame)(lg);
+    (*lg->shutdown)(lg);
+    destroymovelist(&st->moves);
+    free(st);
+    return result->status != 0;
+}
+
+/* Double-check the timing recorded in result for a solution that was
+ * verified by verifysolution(), as with checksolution().
+ */
+int checkverifiedsolution(gamesetup *game, verifyresult const *result)
+{
+    return checkreplaytime(game, result->currenttime, result->timeoffset);
+}
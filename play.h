@@ -17,6 +17,18 @@ enum {
     BeginInput, EndInput, BeginVerify, EndVerify
 };
 
+/* The outcome of playing back a solution with verifysolution().
+ */
+typedef struct verifyresult {
+    int		status;		/* positive if solved, negative if not */
+    int		currenttime;	/* the tick count at the end of play */
+    int		timeoffset;	/* offset for displayed time */
+} verifyresult;
+
+/* A record of a game in progress, from which play can be resumed.
+ */
+typedef struct gamesnapshot gamesnapshot;
+
 /* TRUE if the program is running without a user interface.
  */
 extern int batchmode;
@@ -63,6 +75,41 @@ extern int doturn(int cmd);
  */
 extern int drawscreen(int showframe);
 
+/* Run the current game on a separate thread, so that slow drawing
+ * cannot hold up the timing of the ticks. The thread runs a tick as
+ * soon as it is due, starting with one that uses cmd, and posts a copy
+ * of what is to be displayed. drawplaythread() waits until there is a
+ * tick that has not been drawn, draws the latest one, and returns the
+ * value that doturn() returned for it; any ticks posted in between
+ * are skipped. sendplaythread() passes the user's latest command to
+ * the thread, for use in the next tick. stopplaythread() tells the
+ * thread to stop before running another tick, waits for it to do so,
+ * and returns the value of the last tick run after drawing it. The
+ * game state must not be otherwise used while the thread is running.
+ * startplaythread() returns FALSE if the thread could not be started.
+ */
+extern int startplaythread(int cmd);
+extern int drawplaythread(void);
+extern void sendplaythread(int cmd);
+extern int stopplaythread(void);
+
+/* Start or stop recording which map cells and creatures the game
+ * logic changes as the current game is played. While recording is
+ * off, the logic modules do no more than check that it is off.
+ */
+extern int setchangelogging(int enable);
+
+/* Return the record of the changes made to the current game since the
+ * record was last cleared with clearchangelog() (see changes.h), or
+ * NULL if no record is being kept. The record is marked as having
+ * changed entirely whenever the game is reset or restored, whether to
+ * a snapshot, a keyframe, or an earlier tick. When there is a user
+ * interface, the record is always kept, for the rewind history, and
+ * is cleared after every tick, so that it holds the changes made by
+ * the latest one.
+ */
+extern struct changelog *getchangelog(void);
+
 /* Quit game play early.
  */
 extern int quitgamestate(void);
@@ -84,6 +131,67 @@ extern void setenddisplay(void);
  */
 extern int hassolution(gamesetup const *game);
 
+/* Record the current state of the game in progress, including the
+ * parts of it that belong to the game logic, and return the snapshot.
+ * If snap is not NULL, its memory is reused (or reallocated) for the
+ * new snapshot; otherwise a new one is allocated. Only the length of
+ * the move list is recorded, not the moves themselves. The snapshot
+ * holds no pointers into the game, and so stays valid after the game
+ * or the logic module that made it has gone. NULL is returned if
+ * there is no game in progress.
+ */
+extern gamesnapshot *savegamesnapshot(gamesnapshot *snap);
+
+/* Return the current game to the state recorded in snap, which must
+ * have been taken during the same play of the same level. Any moves
+ * made after the snapshot was taken are discarded, and the timer is
+ * set to continue from the snapshot's tick. FALSE is returned if the
+ * snapshot cannot be used.
+ */
+extern int restoregamesnapshot(gamesnapshot const *snap);
+
+/* Return the tick count at which snap was taken.
+ */
+extern int gamesnapshottime(gamesnapshot const *snap);
+
+/* Step the game in progress back by up to the given number of ticks,
+ * during either live play or playback, and set the timer to continue
+ * from there. The cells, creatures and values changed by each of the
+ * last minute or so of ticks are kept for this purpose. During live play, the moves made
+ * in the ticks undone are dropped, so that the move list remains a
+ * valid solution. The return value is the number of ticks actually
+ * stepped back, which is zero if there is no history to go back to.
+ */
+extern int rewindgame(int ticks);
+
+/* Move the playback of the current level's solution back to the
+ * latest keyframe before the given number of seconds of play, or
+ * forward to it if it lies ahead of the current point. Keyframes are
+ * taken automatically, about once a second, as the solution is played
+ * back. Play then continues from the keyframe, so that the target can
+ * be reached by playing forward for no more than the interval between
+ * keyframes. FALSE is returned if the playback could not be moved.
+ */
+extern int seekplayback(int seconds);
+
+/* Begin playing through the current level's solution on a separate
+ * thread, with its own game state, so that the keyframes used by
+ * seekplayback() are ready before the user gets to them and the
+ * length of the playback becomes known. The thread is stopped when
+ * the game ends. FALSE is returned if the level has no solution or
+ * the thread could not be started.
+ */
+extern int startpresimulation(void);
+
+/* Return the number of ticks that the playback of the current level's
+ * solution lasts, or -1 if this is not yet known.
+ */
+extern int getplaybacklength(void);
+
+/* Free a snapshot made by savegamesnapshot().
+ */
+extern void freegamesnapshot(gamesnapshot *snap);
+
 /* Replace the user's solution with the just-executed solution if it
  * beats the existing solution for shortest time. FALSE is returned if
  * nothing was changed.
@@ -102,6 +210,21 @@ extern int deletesolution(void);
  */
 extern int checksolution(void);
 
+/* Play back the solution for the given level using a private game
+ * state, independently of the current game, and store the outcome in
+ * result. This function is reentrant, so different levels can be
+ * verified on separate threads. FALSE is returned if the solution
+ * could not be played back.
+ */
+extern int verifysolution(gamesetup *game, int ruleset,
+			  verifyresult *result);
+
+/* Double-check the timing of a solution verified by verifysolution(),
+ * in the same manner as checksolution().
+ */
+extern int checkverifiedsolution(gamesetup *game,
+				 verifyresult const *result);
+
 /* Turn pedantic mode on. The ruleset will be slightly changed to be
  * as faithful as possible to the original source material.
  */
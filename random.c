@@ -21,11 +21,6 @@
 #include	"gen.h"
 #include	"random.h"
 
-/* The most recently generated random number is stashed here, so that
- * it can provide the initial seed of the next PRNG.
- */
-static uint32_t	lastvalue = 0x80000000UL;
-
 /* The standard linear congruential random-number generator needs no
  * introduction.
  */
@@ -35,21 +30,31 @@ static uint32_t nextvalue(uint32_t value)
 }
 
 /* Move to the next pseudorandom number in the generator's series.
+ * The most recently generated random number of a shared sequence is
+ * stashed with the sequence, so that it can provide the initial seed
+ * of the next PRNG.
  */
 static void nextrandom(prng *gen)
 {
     if (gen->shared)
-	gen->value = lastvalue = nextvalue(lastvalue);
+	gen->value = *gen->shared = nextvalue(*gen->shared);
     else
 	gen->value = nextvalue(gen->value);
 }
 
-/* Create a new PRNG, reset to the shared sequence.
+/* Mark a shared sequence as not having been seeded yet.
+ */
+void initprngsequence(uint32_t *sequence)
+{
+    *sequence = 0x80000000UL;
+}
+
+/* Create a new PRNG, reset to the given shared sequence.
  */
-prng createprng(void)
+prng createprng(uint32_t *sequence)
 {
     prng gen;
-    resetprng(&gen);
+    resetprng(&gen, sequence);
     return gen;
 }
 
@@ -57,12 +62,12 @@ prng createprng(void)
  * numbers are generated and discarded to work out any biases in the
  * seed value.
  */
-void resetprng(prng *gen)
+void resetprng(prng *gen, uint32_t *sequence)
 {
-    if (lastvalue > 0x7FFFFFFFUL)
-	lastvalue = nextvalue(nextvalue(nextvalue(nextvalue(time(NULL)))));
-    gen->value = gen->initial = lastvalue;
-    gen->shared = TRUE;
+    if (*sequence > 0x7FFFFFFFUL)
+	*sequence = nextvalue(nextvalue(nextvalue(nextvalue(time(NULL)))));
+    gen->value = gen->initial = *sequence;
+    gen->shared = sequence;
 }
 
 /* Reset a PRNG to an independent sequence.
@@ -70,7 +75,7 @@ void resetprng(prng *gen)
 void restartprng(prng *gen, uint32_t seed)
 {
     gen->value = gen->initial = seed & 0x7FFFFFFFUL;
-    gen->shared = FALSE;
+    gen->shared = NULL;
 }
 
 /* Use the top two bits to get a random number between 0 and 3.
@@ -9,13 +9,20 @@
 
 #include	"defs.h"
 
-/* Create a fresh PRNG.
+/* Prepare a shared sequence of random numbers. PRNGs that are reset
+ * upon the same shared sequence continue where the last one left
+ * off; the very first one is seeded from the current time.
  */
-extern prng createprng(void);
+extern void initprngsequence(uint32_t *sequence);
 
-/* Mark an existing PRNG as beginning a new sequence.
+/* Create a fresh PRNG upon a shared sequence.
  */
-extern void resetprng(prng *gen);
+extern prng createprng(uint32_t *sequence);
+
+/* Mark an existing PRNG as beginning a new sequence, taken from the
+ * given shared sequence.
+ */
+extern void resetprng(prng *gen, uint32_t *sequence);
 
 /* Restart an existing PRNG upon a predetermined sequence.
  */
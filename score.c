@@ -11,6 +11,7 @@
 #include	"defs.h"
 #include	"err.h"
 #include	"play.h"
+#include	"series.h"
 #include	"score.h"
 
 /* Translate a number into a string. The second argument supplies the
@@ -78,6 +79,7 @@ int getscoresforlevel(gameseries const *series, int level,
 	levelscore = 0;
 	timescore = 0;
 	if (hassolution(game)) {
+	    readleveldetails(game);
 	    levelscore = game->number * 500;
 	    if (game->time)
 		timescore = 10 * (game->time
@@ -144,6 +146,7 @@ int createscorelist(gameseries const *series, int usepasswds, char zchar,
     for (j = 0, game = series->games ; j < series->count ; ++j, ++game) {
 	if (j >= series->allocated)
 	    break;
+	readleveldetails(game);
 
 	ptrs[n++] = textheap + used;
 	used += 1 + sprintf(textheap + used, "1+%s",
@@ -267,6 +270,7 @@ int createtimelist(gameseries const *series, int showpartial, char zchar,
 	    break;
 	if (!hassolution(game))
 	    continue;
+	readleveldetails(game);
 	ptrs[n++] = textheap + used;
 	used += 1 + sprintf(textheap + used, "1+%s",
 			    decimal(game->number, zchar));
@@ -8,6 +8,7 @@
 #include	<stdlib.h>
 #include	<string.h>
 #include	<ctype.h>
+#include	<errno.h>
 #include	"defs.h"
 #include	"err.h"
 #include	"fileio.h"
@@ -15,6 +16,7 @@
 #include	"unslist.h"
 #include	"series.h"
 #include	"oshw.h"
+#include	"ver.h"
 
 /* The signature bytes of the data files.
  */
@@ -37,6 +39,42 @@ typedef	struct seriesdata {
     int		usedatdir;	/* TRUE if the file is in seriesdatdir. */
 } seriesdata;
 
+/* The name of the file in savedir that remembers the headers of the
+ * series files.
+ */
+#define	CATALOGUEFILENAME	"seriescache"
+
+/* An entry in the catalogue of series files. The entry can stand in
+ * for reading the series file as long as neither the series file nor
+ * the data file it refers to have changed since the entry was made.
+ * For a configuration file, the data file must also still be found
+ * in the same place, so the data file's name and the directory it was
+ * looked for in are kept as well.
+ */
+typedef struct catalogueentry {
+    char	       *path;		/* the series file's pathname */
+    char	       *mapfilename;	/* the data file's pathname */
+    char	       *datfilename;	/* the data file named in a .dac, or "" */
+    char	       *datdir;		/* seriesdatdir for a .dac, or "" */
+    unsigned long	mtime;		/* the series file's modification time */
+    unsigned long	size;		/* the series file's size */
+    unsigned long	mapmtime;	/* the data file's modification time */
+    unsigned long	mapsize;	/* the data file's size */
+    int			count;		/* the number of levels */
+    int			final;		/* number of the ending level */
+    int			ruleset;	/* the ruleset for the game file */
+    int			gsflags;	/* the series flags */
+    int			used;		/* TRUE if seen in the current search */
+    char		name[256];	/* the series' name */
+} catalogueentry;
+
+/* The catalogue of series files.
+ */
+static catalogueentry  *catalogue = NULL;
+static int		cataloguecount = 0;
+static int		catalogueallocated = 0;
+static int		cataloguechanged = FALSE;
+
 /* The directory containing the series files (data files and
  * configuration files).
  */
@@ -48,7 +86,7 @@ char	       *seriesdatdir = NULL;
 
 /* Calculate a hash value for the given block of data.
  */
-static uint32_t hashvalue(unsigned char const *data, unsigned int size)
+uint32_t hashvalue(unsigned char const *data, unsigned int size)
 {
     static uint32_t remainders[256] = {
 	0x00000000, 0x04C11DB7, 0x09823B6E, 0x0D4326D9, 0x130476DC, 0x17C56B6B,
@@ -145,42 +183,71 @@ static int readseriesheader(gameseries *series)
     return TRUE;
 }
 
-/* Read a single level out of the given data file. The level's name,
- * password, and time limit are extracted from the data.
+/* Return a pointer to the list of optional fields in the given
+ * level's data, or NULL if the data is too short to contain one.
+ */
+static unsigned char const *getlevelfields(gamesetup const *game)
+{
+    unsigned char const	       *data;
+    unsigned char const	       *dataend;
+
+    if (game->levelsize < 10)
+	return NULL;
+    data = game->leveldata;
+    dataend = data + game->levelsize;
+    data += data[8] | (data[9] << 8);
+    data += 10;
+    if (data + 2 >= dataend)
+	return NULL;
+    data += data[0] | (data[1] << 8);
+    data += 2;
+    if (data + 2 > dataend)
+	return NULL;
+    return data;
+}
+
+/* Locate a single level at pos in the given data file's contents,
+ * and advance pos past it. The level's data is not copied out of the
+ * file's contents. Only the level's number and password are extracted
+ * from the data here; the rest is left for readleveldetails().
  */
-static int readleveldata(fileinfo *file, gamesetup *game)
+static int readleveldata(fileinfo *file, filemapping const *map,
+			 unsigned long *pos, gamesetup *game)
 {
     unsigned char	       *data;
     unsigned char const	       *dataend;
-    uint16_t			size;
+    unsigned int		size;
     int				n;
 
-    if (!filereadint16(file, &size, NULL))
+    if (map->size - *pos < 2) {
+	*pos = map->size;
 	return FALSE;
-    data = filereadbuf(file, size, "missing or invalid level data");
-    if (!data)
+    }
+    size = map->data[*pos] | (map->data[*pos + 1] << 8);
+    *pos += 2;
+    errno = 0;
+    if (size > map->size - *pos) {
+	*pos = map->size;
+	fileerr(file, "missing or invalid level data");
 	return FALSE;
+    }
+    data = map->data + *pos;
+    *pos += size;
     if (size < 2) {
 	fileerr(file, "invalid level data");
-	free(data);
 	return FALSE;
     }
     game->levelsize = size;
     game->leveldata = data;
+    game->detailsread = FALSE;
     dataend = game->leveldata + game->levelsize;
 
     game->number = data[0] | (data[1] << 8);
-    if (size < 10)
-	goto badlevel;
-    game->time = data[2] | (data[3] << 8);
     game->besttime = TIME_NIL;
     game->passwd[0] = '\0';
-    data += data[8] | (data[9] << 8);
-    data += 10;
-    if (data + 2 >= dataend)
+    data = (unsigned char*)getlevelfields(game);
+    if (!data)
 	goto badlevel;
-    data += data[0] | (data[1] << 8);
-    data += 2;
     size = data[0] | (data[1] << 8);
     data += 2;
     if (data + size != dataend)
@@ -193,14 +260,6 @@ static int readleveldata(fileinfo *file, gamesetup *game)
 	if (size > dataend - data)
 	    size = dataend - data;
 	switch (data[-2]) {
-	  case 1:
-	    if (size > 1)
-		game->time = data[0] | (data[1] << 8);
-	    break;
-	  case 3:
-	    memcpy(game->name, data, size);
-	    game->name[size] = '\0';
-	    break;
 	  case 6:
 	    for (n = 0 ; n < size && n < 15 && data[n] ; ++n)
 		game->passwd[n] = data[n] ^ 0x99;
@@ -215,17 +274,55 @@ static int readleveldata(fileinfo *file, gamesetup *game)
     if (!game->passwd[0] || strlen(game->passwd) != 4)
 	goto badlevel;
 
-    game->levelhash = hashvalue(game->leveldata, game->levelsize);
     return TRUE;
 
   badlevel:
-    free(game->leveldata);
     game->levelsize = 0;
     game->leveldata = NULL;
     errmsg(file->name, "level %d: invalid level data", game->number);
     return FALSE;
 }
 
+/* Extract the level's name and time limit from its data, and compute
+ * its hash value, if this has not already been done.
+ */
+void readleveldetails(gamesetup *game)
+{
+    unsigned char const	       *data;
+    unsigned char const	       *dataend;
+    int				size;
+
+    if (game->detailsread)
+	return;
+    game->detailsread = TRUE;
+    if (!game->leveldata)
+	return;
+
+    data = game->leveldata;
+    dataend = data + game->levelsize;
+    game->time = data[2] | (data[3] << 8);
+    data = getlevelfields(game) + 2;
+    while (data + 2 < dataend) {
+	size = data[1];
+	data += 2;
+	if (size > dataend - data)
+	    size = dataend - data;
+	switch (data[-2]) {
+	  case 1:
+	    if (size > 1)
+		game->time = data[0] | (data[1] << 8);
+	    break;
+	  case 3:
+	    memcpy(game->name, data, size);
+	    game->name[size] = '\0';
+	    break;
+	}
+	data += size;
+    }
+
+    game->levelhash = hashvalue(game->leveldata, game->levelsize);
+}
+
 /* Assuming that the series passed in is in fact the original
  * chips.dat file, this function undoes the changes that MS introduced
  * to the original Lynx levels. A rather "ad hack" way to accomplish
@@ -265,7 +362,8 @@ static int undomschanges(gameseries *series)
 	if (series->games[fixup->num].levelsize <= fixup->pos)
 	    return FALSE;
 
-    free(series->games[144].leveldata);
+    for (fixup = fixups ; fixup->num >= 0 ; ++fixup)
+	readleveldetails(series->games + fixup->num);
     memmove(series->games + 144, series->games + 145,
 	    4 * sizeof *series->games);
     --series->count;
@@ -290,11 +388,13 @@ static int undomschanges(gameseries *series)
  */
 
 /* Load all levels from the given data file, and all of the user's
- * saved solutions.
+ * saved solutions. The data file is mapped into memory, and a single
+ * pass is made over it to find where each level's data lies.
  */
 int readseriesfile(gameseries *series)
 {
-    int	n;
+    unsigned long	pos;
+    int			n;
 
     if (series->gsflags & GSF_ALLMAPSREAD)
 	return TRUE;
@@ -315,9 +415,13 @@ int readseriesfile(gameseries *series)
     memset(series->games + series->allocated, 0,
 	   (series->count - series->allocated) * sizeof *series->games);
     series->allocated = series->count;
+    if (!filemap(&series->mapfile, &series->datmap, "unknown error"))
+	return FALSE;
+    pos = 6;			/* skip over the header */
     n = 0;
-    while (n < series->count && !filetestend(&series->mapfile)) {
-	if (readleveldata(&series->mapfile, series->games + n))
+    while (n < series->count && pos < series->datmap.size) {
+	if (readleveldata(&series->mapfile, &series->datmap, &pos,
+			  series->games + n))
 	    ++n;
 	else
 	    --series->count;
@@ -351,10 +455,10 @@ void freeseriesdata(gameseries *series)
     series->solheaderflags = 0;
 
     for (n = 0, game = series->games ; n < series->count ; ++n, ++game) {
-	free(game->leveldata);
 	game->leveldata = NULL;
 	game->levelsize = 0;
     }
+    fileunmap(&series->datmap);
     free(series->games);
     series->games = NULL;
     series->allocated = 0;
@@ -440,41 +544,295 @@ static char *readconfigfile(fileinfo *file, gameseries *series)
 }
 
 /*
- * Functions to locate the series files.
+ * The catalogue of series files.
  */
 
-/* Open the given file and read the information in the file header (or
- * the entire file if it is a configuration file), then allocate and
- * initialize a gameseries structure for the file and add it to the
- * list stored under the second argument. This function is used as a
- * findfiles() callback.
+/* Return an independent copy of str.
  */
-static int getseriesfile(char *filename, void *data)
+static char *copystring(char const *str)
+{
+    char       *copy;
+    int		n;
+
+    n = strlen(str) + 1;
+    if (!(copy = malloc(n)))
+	memerrexit();
+    memcpy(copy, str, n);
+    return copy;
+}
+
+/* Return the catalogue entry for the series file at path, or NULL if
+ * there is none.
+ */
+static catalogueentry *findincatalogue(char const *path)
+{
+    int	n;
+
+    for (n = 0 ; n < cataloguecount ; ++n)
+	if (!strcmp(catalogue[n].path, path))
+	    return catalogue + n;
+    return NULL;
+}
+
+/* Add an entry to the end of the catalogue.
+ */
+static catalogueentry *addtocatalogue(void)
+{
+    if (cataloguecount >= catalogueallocated) {
+	catalogueallocated = catalogueallocated ? catalogueallocated * 2 : 64;
+	x_alloc(catalogue, catalogueallocated * sizeof *catalogue);
+    }
+    return catalogue + cataloguecount++;
+}
+
+/* Read the catalogue file from savedir. Lines that are malformed or
+ * that were written by a different version of the program are
+ * skipped.
+ */
+static void readcatalogue(void)
 {
     fileinfo		file;
-    seriesdata	       *sdata = (seriesdata*)data;
-    gameseries	       *series;
-    uint32_t		magic;
-    char	       *datfilename;
-    int			config, f;
+    catalogueentry	entry;
+    char		buf[2048], version[64];
+    char	       *mapfilename, *datfilename, *datdir, *name, *p;
+    int			n;
 
+    cataloguecount = 0;
+    cataloguechanged = FALSE;
+    if (!savedir || !*savedir)
+	return;
     clearfileinfo(&file);
-    if (!openfileindir(&file, seriesdir, filename, "rb", "unknown error"))
-	return 0;
-    if (!filereadint32(&file, &magic, "unexpected EOF")) {
-	fileclose(&file, NULL);
-	return 0;
+    if (!openfileindir(&file, savedir, CATALOGUEFILENAME, "r", NULL))
+	return;
+    for (;;) {
+	n = sizeof buf - 1;
+	if (!filegetline(&file, buf, &n, NULL))
+	    break;
+	if (buf[0] == '#' || !(p = strchr(buf, '\n')))
+	    continue;
+	*p = '\0';
+	n = 0;
+	if (sscanf(buf, "%63s %lu %lu %lu %lu %d %d %d %d\t%n", version,
+		   &entry.mtime, &entry.size, &entry.mapmtime, &entry.mapsize,
+		   &entry.ruleset, &entry.gsflags, &entry.count, &entry.final,
+		   &n) != 9 || !n)
+	    continue;
+	if (strcmp(version, VERSION) || entry.count <= 0)
+	    continue;
+	if (entry.ruleset != Ruleset_Lynx && entry.ruleset != Ruleset_MS)
+	    continue;
+	if (!(mapfilename = strchr(buf + n, '\t')))
+	    continue;
+	*mapfilename++ = '\0';
+	if (!(datfilename = strchr(mapfilename, '\t')))
+	    continue;
+	*datfilename++ = '\0';
+	if (!(datdir = strchr(datfilename, '\t')))
+	    continue;
+	*datdir++ = '\0';
+	if (!(name = strchr(datdir, '\t')))
+	    continue;
+	*name++ = '\0';
+	if (!buf[n] || !*mapfilename || findincatalogue(buf + n))
+	    continue;
+	entry.path = copystring(buf + n);
+	entry.mapfilename = copystring(mapfilename);
+	entry.datfilename = copystring(datfilename);
+	entry.datdir = copystring(datdir);
+	entry.used = FALSE;
+	sprintf(entry.name, "%.*s", (int)(sizeof entry.name - 1), name);
+	*addtocatalogue() = entry;
     }
-    filerewind(&file, NULL);
-    if (magic == SIG_DACFILE) {
-	config = TRUE;
-    } else if ((magic & 0xFFFF) == SIG_DATFILE) {
-	config = FALSE;
+    fileclose(&file, NULL);
+}
+
+/* Write the catalogue out to savedir, if it has been changed.
+ */
+static int writecatalogue(void)
+{
+    fileinfo	file;
+    int		n;
+
+    if (!cataloguechanged)
+	return TRUE;
+    if (readonly || !savedir || !*savedir || !finddir(savedir))
+	return FALSE;
+    clearfileinfo(&file);
+    if (!openfileindir(&file, savedir, CATALOGUEFILENAME, "w",
+		       "can't write series catalogue"))
+	return FALSE;
+    fputs("# version mtime size datmtime datsize ruleset flags count final"
+	  "\tfile\tdatfile\tdatname\tdatdir\tname\n", file.fp);
+    for (n = 0 ; n < cataloguecount ; ++n)
+	fprintf(file.fp, "%s %lu %lu %lu %lu %d %d %d %d\t%s\t%s\t%s\t%s\t%s\n",
+		VERSION, catalogue[n].mtime, catalogue[n].size,
+		catalogue[n].mapmtime, catalogue[n].mapsize,
+		catalogue[n].ruleset, catalogue[n].gsflags,
+		catalogue[n].count, catalogue[n].final,
+		catalogue[n].path, catalogue[n].mapfilename,
+		catalogue[n].datfilename, catalogue[n].datdir,
+		catalogue[n].name);
+    fileclose(&file, NULL);
+    cataloguechanged = FALSE;
+    return TRUE;
+}
+
+/* Remove the entries for the files in dir that were not seen during
+ * the current search, since they no longer exist.
+ */
+static void prunecatalogue(char const *dir)
+{
+    char       *path;
+    int		i, n;
+
+    for (i = n = 0 ; i < cataloguecount ; ++i) {
+	if (!catalogue[i].used) {
+	    path = getpathforfileindir(dir, skippathname(catalogue[i].path));
+	    if (path && !strcmp(path, catalogue[i].path)) {
+		free(path);
+		free(catalogue[i].path);
+		free(catalogue[i].mapfilename);
+		free(catalogue[i].datfilename);
+		free(catalogue[i].datdir);
+		cataloguechanged = TRUE;
+		continue;
+	    }
+	    free(path);
+	}
+	catalogue[n++] = catalogue[i];
+    }
+    cataloguecount = n;
+}
+
+/* Release the catalogue.
+ */
+static void freecatalogue(void)
+{
+    int	n;
+
+    for (n = 0 ; n < cataloguecount ; ++n) {
+	free(catalogue[n].path);
+	free(catalogue[n].mapfilename);
+	free(catalogue[n].datfilename);
+	free(catalogue[n].datdir);
+    }
+    free(catalogue);
+    catalogue = NULL;
+    cataloguecount = 0;
+    catalogueallocated = 0;
+}
+
+/* Fill in series from the catalogue entry for the series file at
+ * path, if there is one and the files have not changed since it was
+ * made. The data file named by a configuration file is looked up
+ * again in the current seriesdatdir, and if that does not lead to the
+ * same file the entry is not used. FALSE is returned if the file
+ * needs to be read.
+ */
+static int getseriesfromcatalogue(gameseries *series, char const *path,
+				  unsigned long mtime, unsigned long size)
+{
+    catalogueentry     *entry;
+    char	       *mapfilename;
+    unsigned long	mapmtime, mapsize;
+
+    if (!(entry = findincatalogue(path)))
+	return FALSE;
+    entry->used = TRUE;
+    if (entry->mtime != mtime || entry->size != size)
+	return FALSE;
+    if (*entry->datfilename) {
+	if (!seriesdatdir || strcmp(entry->datdir, seriesdatdir))
+	    return FALSE;
+	mapfilename = getpathforfileindir(seriesdatdir, entry->datfilename);
     } else {
-	fileerr(&file, "not a valid data file or configuration file");
-	fileclose(&file, NULL);
-	return 0;
+	mapfilename = copystring(path);
+    }
+    if (!mapfilename)
+	return FALSE;
+    if (strcmp(mapfilename, entry->mapfilename)) {
+	free(mapfilename);
+	return FALSE;
+    }
+    if (strcmp(mapfilename, path)) {
+	if (!getfilestamp(mapfilename, &mapmtime, &mapsize)
+			|| entry->mapmtime != mapmtime
+			|| entry->mapsize != mapsize) {
+	    free(mapfilename);
+	    return FALSE;
+	}
     }
+    series->mapfilename = mapfilename;
+    series->count = entry->count;
+    series->final = entry->final;
+    series->ruleset = entry->ruleset;
+    series->gsflags = entry->gsflags;
+    strcpy(series->name, entry->name);
+    return TRUE;
+}
+
+/* Record the header values of series, which was read from the series
+ * file at path, in the catalogue. datfilename is the data file named
+ * in a configuration file, or NULL if the series file is itself the
+ * data file. The data file's stamp must have been taken before it was
+ * read.
+ */
+static void addseriestocatalogue(gameseries const *series, char const *path,
+			     char const *datfilename,
+			     unsigned long mtime, unsigned long size,
+			     unsigned long mapmtime, unsigned long mapsize)
+{
+    catalogueentry     *entry;
+    char const	       *datdir;
+
+    datdir = "";
+    if (datfilename) {
+	if (!seriesdatdir)
+	    return;
+	datdir = seriesdatdir;
+    } else {
+	datfilename = "";
+    }
+    if (strpbrk(path, "\t\n") || strpbrk(series->mapfilename, "\t\n")
+			      || strpbrk(datfilename, "\t\n")
+			      || strpbrk(datdir, "\t\n")
+			      || strpbrk(series->name, "\t\n"))
+	return;
+    if ((entry = findincatalogue(path))) {
+	free(entry->mapfilename);
+	free(entry->datfilename);
+	free(entry->datdir);
+    } else {
+	entry = addtocatalogue();
+	entry->path = copystring(path);
+    }
+    entry->mapfilename = copystring(series->mapfilename);
+    entry->datfilename = copystring(datfilename);
+    entry->datdir = copystring(datdir);
+    entry->mtime = mtime;
+    entry->size = size;
+    entry->mapmtime = mapmtime;
+    entry->mapsize = mapsize;
+    entry->count = series->count;
+    entry->final = series->final;
+    entry->ruleset = series->ruleset;
+    entry->gsflags = series->gsflags;
+    entry->used = TRUE;
+    strcpy(entry->name, series->name);
+    cataloguechanged = TRUE;
+}
+
+/*
+ * Functions to locate the series files.
+ */
+
+/* Allocate and initialize a gameseries structure for the given file,
+ * at the end of the list stored in sdata. The list's count is not
+ * increased.
+ */
+static gameseries *newseries(seriesdata *sdata, char const *filename)
+{
+    gameseries *series;
 
     if (sdata->count >= sdata->allocated) {
 	sdata->allocated = sdata->count + 1;
@@ -482,7 +840,17 @@ static int getseriesfile(char *filename, void *data)
     }
     series = sdata->list + sdata->count;
     series->mapfilename = NULL;
+    clearfileinfo(&series->mapfile);
     clearfileinfo(&series->savefile);
+    series->datmap.data = NULL;
+    series->datmap.size = 0;
+    series->datmap.mapped = FALSE;
+    series->savemap.data = NULL;
+    series->savemap.size = 0;
+    series->savemap.mapped = FALSE;
+    series->journalmap.data = NULL;
+    series->journalmap.size = 0;
+    series->journalmap.mapped = FALSE;
     series->savefilename = NULL;
     series->gsflags = 0;
     series->solheaderflags = 0;
@@ -495,18 +863,71 @@ static int getseriesfile(char *filename, void *data)
                                       filename);
     sprintf(series->name, "%.*s", (int)(sizeof series->name - 1),
 				  skippathname(filename));
+    return series;
+}
+
+/* Open the given file and read the information in the file header (or
+ * the entire file if it is a configuration file), then allocate and
+ * initialize a gameseries structure for the file and add it to the
+ * list stored under the second argument. If the catalogue shows that
+ * the file has not changed since it was last read, the information is
+ * taken from there instead. This function is used as a findfiles()
+ * callback.
+ */
+static int getseriesfile(char *filename, void *data)
+{
+    fileinfo		file;
+    seriesdata	       *sdata = (seriesdata*)data;
+    gameseries	       *series;
+    uint32_t		magic;
+    char	       *path, *datpath, *datfilename;
+    unsigned long	mtime, size, mapmtime, mapsize;
+    int			config, stamped, f;
+
+    series = newseries(sdata, filename);
+    datfilename = NULL;
+    path = getpathforfileindir(seriesdir, filename);
+    stamped = path && getfilestamp(path, &mtime, &size);
+    if (stamped && getseriesfromcatalogue(series, path, mtime, size)) {
+	++sdata->count;
+	free(path);
+	return 0;
+    }
+    clearfileinfo(&file);
+    if (!openfileindir(&file, seriesdir, filename, "rb", "unknown error")) {
+	free(path);
+	return 0;
+    }
+    if (!filereadint32(&file, &magic, "unexpected EOF")) {
+	fileclose(&file, NULL);
+	free(path);
+	return 0;
+    }
+    filerewind(&file, NULL);
+    if (magic == SIG_DACFILE) {
+	config = TRUE;
+    } else if ((magic & 0xFFFF) == SIG_DATFILE) {
+	config = FALSE;
+    } else {
+	fileerr(&file, "not a valid data file or configuration file");
+	fileclose(&file, NULL);
+	free(path);
+	return 0;
+    }
 
     f = FALSE;
     if (config) {
 	fileclose(&file, NULL);
-	if (!openfileindir(&file, seriesdir, filename, "r", "unknown error"))
+	if (!openfileindir(&file, seriesdir, filename, "r", "unknown error")) {
+	    free(path);
 	    return 0;
-	clearfileinfo(&series->mapfile);
-	free(series->mapfilename);
-	series->mapfilename = NULL;
+	}
 	datfilename = readconfigfile(&file, series);
 	fileclose(&file, NULL);
 	if (datfilename) {
+	    datpath = getpathforfileindir(seriesdatdir, datfilename);
+	    if (!datpath || !getfilestamp(datpath, &mapmtime, &mapsize))
+		stamped = FALSE;
 	    if (openfileindir(&series->mapfile, seriesdatdir,
 			      datfilename, "rb", NULL))
 		f = readseriesheader(series);
@@ -515,10 +936,13 @@ static int getseriesfile(char *filename, void *data)
 	    fileclose(&series->mapfile, NULL);
 	    clearfileinfo(&series->mapfile);
 	    if (f)
-		series->mapfilename = getpathforfileindir(seriesdatdir,
-							  datfilename);
+		series->mapfilename = datpath;
+	    else
+		free(datpath);
 	}
     } else {
+	mapmtime = mtime;
+	mapsize = size;
 	series->mapfile = file;
 	f = readseriesheader(series);
 	fileclose(&series->mapfile, NULL);
@@ -526,8 +950,13 @@ static int getseriesfile(char *filename, void *data)
 	if (f)
 	    series->mapfilename = getpathforfileindir(seriesdir, filename);
     }
-    if (f)
+    if (f) {
 	++sdata->count;
+	if (stamped && series->mapfilename)
+	    addseriestocatalogue(series, path, datfilename, mtime, size,
+				 mapmtime, mapsize);
+    }
+    free(path);
     return 0;
 }
 
@@ -556,15 +985,17 @@ static int gameseriescmp(void const *a, void const *b)
 static int getseriesfiles(char const *preferred, gameseries **list, int *count)
 {
     seriesdata	s;
-    int		n;
+    int		f, n;
 
     s.list = NULL;
     s.allocated = 0;
     s.count = 0;
     s.usedatdir = FALSE;
+    readcatalogue();
     if (preferred && *preferred && haspathname(preferred)) {
-	if (getseriesfile((char*)preferred, &s) < 0)
-	    return FALSE;
+	getseriesfile((char*)preferred, &s);
+	writecatalogue();
+	freecatalogue();
 	if (!s.count) {
 	    errmsg(preferred, "couldn't read data file");
 	    return FALSE;
@@ -572,9 +1003,16 @@ static int getseriesfiles(char const *preferred, gameseries **list, int *count)
 	*seriesdir = '\0';
 	s.list[0].gsflags |= GSF_NODEFAULTSAVE;
     } else {
-	if (!*seriesdir)
+	if (!*seriesdir) {
+	    freecatalogue();
 	    return FALSE;
-	if (!findfiles(seriesdir, &s, getseriesfile) || !s.count) {
+	}
+	f = findfiles(seriesdir, &s, getseriesfile);
+	if (f)
+	    prunecatalogue(seriesdir);
+	writecatalogue();
+	freecatalogue();
+	if (!f || !s.count) {
 	    errmsg(seriesdir, "directory contains no data files");
 	    return FALSE;
 	}
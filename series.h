@@ -21,6 +21,13 @@ extern char    *seriesdatdir;
  */
 extern int readseriesfile(gameseries *series);
 
+/* Fill in the name, time limit, and hash value of the given level, if
+ * this has not yet been done. These details are not extracted from
+ * the level's data when the series is loaded, and so this function
+ * must be called before any of them are used.
+ */
+extern void readleveldetails(gamesetup *game);
+
 /* Release all resources associated with a gameseries structure.
  */
 extern void freeseriesdata(gameseries *series);
@@ -63,4 +70,9 @@ extern void freeserieslist(gameseries *serieslist, int count,
 extern int findlevelinseries(gameseries const *series,
 			     int number, char const *passwd);
 
+/* Calculate a hash value for the given block of data. This is the
+ * hash that is stored in the levelhash field of each level.
+ */
+extern uint32_t hashvalue(unsigned char const *data, unsigned int size);
+
 #endif
@@ -8,6 +8,7 @@
 #include	<stdlib.h>
 #include	<string.h>
 #include	<ctype.h>
+#include	<errno.h>
 #include	<stdint.h>
 #include	"defs.h"
 #include	"err.h"
@@ -120,6 +121,12 @@
  */
 #define	CSSIG		0x999B3335UL
 
+/* The suffixes added to the name of a solution file to make the name
+ * of its journal, and of the new copy of it made when it is written.
+ */
+#define	JOURNALSUFFIX	".jnl"
+#define	NEWFILESUFFIX	".new"
+
 /* Translate move directions between three-bit and four-bit
  * representations.
  *
@@ -209,38 +216,31 @@ void destroymovelist(actlist *list)
  * Functions for handling the solution file header.
  */
 
-/* Read the header bytes of the given solution file. flags receives
- * the option bytes (bytes 5-6). extra receives any bytes in the
- * header that this code doesn't recognize.
+/* Read the header bytes of the given solution file's contents. flags
+ * receives the option bytes (bytes 5-6). extra receives any bytes in
+ * the header that this code doesn't recognize. The return value is the
+ * size of the header, or zero if the header is invalid.
  */
-static int readsolutionheader(fileinfo *file, int ruleset, int *flags,
+static int readsolutionheader(fileinfo *file, filemapping const *map,
+			      int ruleset, int *flags,
 			      int *extrasize, unsigned char *extra)
 {
-    uint32_t		sig;
-    uint16_t		f;
-    uint8_t		n;
+    unsigned char const	       *data = map->data;
 
-    if (!filereadint32(file, &sig, "not a valid solution file"))
-	return FALSE;
-    if (sig != CSSIG)
+    errno = 0;
+    if (map->size < 8 || (data[0] | (data[1] << 8) | (data[2] << 16)
+				 | ((uint32_t)data[3] << 24)) != CSSIG)
 	return fileerr(file, "not a valid solution file");
-    if (!filereadint8(file, &n, "not a valid solution file"))
-	return FALSE;
-    if (n != ruleset)
+    if (data[4] != ruleset)
 	return fileerr(file, "solution file is for a different ruleset"
 			     " than the level set file");
-    if (!filereadint16(file, &f, "not a valid solution file"))
-	return FALSE;
-    *flags = (int)f;
-
-    if (!filereadint8(file, &n, "not a valid solution file"))
-	return FALSE;
-    *extrasize = n;
-    if (n)
-	if (!fileread(file, extra, *extrasize, "not a valid solution file"))
-	    return FALSE;
+    *flags = data[5] | (data[6] << 8);
+    *extrasize = data[7];
+    if (map->size < 8 + (unsigned long)*extrasize)
+	return fileerr(file, "not a valid solution file");
+    memcpy(extra, data + 8, *extrasize);
 
-    return TRUE;
+    return 8 + *extrasize;
 }
 
 /* Write the header bytes to the given solution file.
@@ -272,18 +272,46 @@ static int writesolutionsetname(fileinfo *file, char const *setname)
  * Solution translation.
  */
 
-/* Expand a level's solution data into an actual list of moves.
+/* Return the number of bytes used by the move whose first byte is at
+ * p, or zero if there are too few bytes left before dataend.
  */
-int expandsolution(solutioninfo *solution, gamesetup const *game)
+static int solutionmovesize(unsigned char const *p,
+			    unsigned char const *dataend)
+{
+    int	size;
+
+    switch (*p & 0x03) {
+      case 0:
+      case 1:	size = 1;						break;
+      case 2:	size = 2;						break;
+      default:	size = *p & 0x10 ? 2 + ((*p >> 2) & 0x03) : 4;		break;
+    }
+    return p + size > dataend ? 0 : size;
+}
+
+/* Read the header of a level's solution data, and set cursor to the
+ * first move. The whole of the data is checked for truncation here,
+ * so that decoding the moves later on cannot fail.
+ */
+int opensolution(solutioninfo *solution, solutioncursor *cursor,
+		 gamesetup const *game)
 {
     unsigned char const	       *dataend;
     unsigned char const	       *p;
-    action			act;
     int				n;
 
     if (game->solutionsize <= 16)
 	return FALSE;
 
+    dataend = game->solutiondata + game->solutionsize;
+    for (p = game->solutiondata + 16 ; p < dataend ; p += n) {
+	n = solutionmovesize(p, dataend);
+	if (!n) {
+	    errmsg(NULL, "level %d: truncated solution data", game->number);
+	    return FALSE;
+	}
+    }
+
     solution->flags = game->solutiondata[6];
     solution->rndslidedir = indextodir(game->solutiondata[7] & 7);
     solution->stepping = (game->solutiondata[7] >> 3) & 7;
@@ -291,69 +319,101 @@ int expandsolution(solutioninfo *solution, gamesetup const *game)
 					      | (game->solutiondata[10] << 16)
 					      | (game->solutiondata[11] << 24);
 
-    initmovelist(&solution->moves);
-    act.when = -1;
-    p = game->solutiondata + 16;
-    dataend = game->solutiondata + game->solutionsize;
-    while (p < dataend) {
-	switch (*p & 0x03) {
-	  case 0:
+    cursor->offset = 16;
+    cursor->packed = 0;
+    cursor->next.when = -1;
+    cursor->next.dir = NIL;
+    cursor->more = TRUE;
+    nextsolutionmove(cursor, game);
+    return TRUE;
+}
+
+/* Decode the move after the one at the cursor. A byte can hold up to
+ * three moves, so the cursor keeps count of how many of them have
+ * been used.
+ */
+int nextsolutionmove(solutioncursor *cursor, gamesetup const *game)
+{
+    unsigned char const	       *p;
+    action			act;
+    int				n;
+
+    if (!cursor->more)
+	return FALSE;
+    if (cursor->offset >= game->solutionsize) {
+	cursor->more = FALSE;
+	return FALSE;
+    }
+
+    p = game->solutiondata + cursor->offset;
+    act = cursor->next;
+    switch (*p & 0x03) {
+      case 0:
+	act.dir = indextodir((*p >> (2 + 2 * cursor->packed)) & 0x03);
+	act.when += 4;
+	if (++cursor->packed < 3)
+	    goto done;
+	cursor->packed = 0;
+	break;
+      case 1:
+	act.dir = indextodir((*p >> 2) & 0x07);
+	act.when += ((*p >> 5) & 0x07) + 1;
+	break;
+      case 2:
+	act.dir = indextodir((*p >> 2) & 0x07);
+	act.when += ((p[0] >> 5) & 0x07) + ((unsigned long)p[1] << 3) + 1;
+	break;
+      case 3:
+	if (*p & 0x10) {
+	    n = (*p >> 2) & 0x03;
+	    act.dir = ((p[0] >> 5) & 0x07) | ((p[1] & 0x3F) << 3);
+	    act.when += (p[1] >> 6) & 0x03;
+	    while (n--)
+		act.when += (unsigned long)p[2 + n] << (2 + n * 8);
+	    ++act.when;
+	} else {
 	    act.dir = indextodir((*p >> 2) & 0x03);
-	    act.when += 4;
-	    addtomovelist(&solution->moves, act);
-	    act.dir = indextodir((*p >> 4) & 0x03);
-	    act.when += 4;
-	    addtomovelist(&solution->moves, act);
-	    act.dir = indextodir((*p >> 6) & 0x03);
-	    act.when += 4;
-	    addtomovelist(&solution->moves, act);
-	    ++p;
-	    break;
-	  case 1:
-	    act.dir = indextodir((*p >> 2) & 0x07);
-	    act.when += ((*p >> 5) & 0x07) + 1;
-	    addtomovelist(&solution->moves, act);
-	    ++p;
-	    break;
-	  case 2:
-	    if (p + 2 > dataend)
-		goto truncated;
-	    act.dir = indextodir((*p >> 2) & 0x07);
-	    act.when += ((p[0] >> 5) & 0x07) + ((unsigned long)p[1] << 3) + 1;
-	    addtomovelist(&solution->moves, act);
-	    p += 2;
-	    break;
-	  case 3:
-	    if (*p & 0x10) {
-		n = (*p >> 2) & 0x03;
-		if (p + 2 + n > dataend)
-		    goto truncated;
-		act.dir = ((p[0] >> 5) & 0x07) | ((p[1] & 0x3F) << 3);
-		act.when += (p[1] >> 6) & 0x03;
-		while (n--)
-		    act.when += (unsigned long)p[2 + n] << (2 + n * 8);
-		++act.when;
-		p += 2 + ((*p >> 2) & 0x03);
-	    } else {
-		if (p + 4 > dataend)
-		    goto truncated;
-		act.dir = indextodir((*p >> 2) & 0x03);
-		act.when += ((p[0] >> 5) & 0x07) | ((unsigned long)p[1] << 3)
-						 | ((unsigned long)p[2] << 11)
-						 | ((unsigned long)p[3] << 19);
-		++act.when;
-		p += 4;
-	    }
-	    addtomovelist(&solution->moves, act);
-	    break;
+	    act.when += ((p[0] >> 5) & 0x07) | ((unsigned long)p[1] << 3)
+					     | ((unsigned long)p[2] << 11)
+					     | ((unsigned long)p[3] << 19);
+	    ++act.when;
 	}
+	break;
     }
+    cursor->offset += solutionmovesize(p, game->solutiondata
+						+ game->solutionsize);
+
+  done:
+    cursor->next = act;
     return TRUE;
+}
 
-  truncated:
-    errmsg(NULL, "level %d: truncated solution data", game->number);
+/* Expand a level's solution data into an actual list of moves.
+ */
+int expandsolution(solutioninfo *solution, gamesetup const *game)
+{
+    solutioncursor	cursor;
+
+    if (!opensolution(solution, &cursor, game))
+	return FALSE;
     initmovelist(&solution->moves);
-    return FALSE;
+    for ( ; cursor.more ; nextsolutionmove(&cursor, game))
+	addtomovelist(&solution->moves, cursor.next);
+    return TRUE;
+}
+
+/* Discard the level's solution data, and mark the level as needing
+ * to be saved. Data that lies in the contents of the solution file or
+ * the journal is left alone.
+ */
+void freesolutiondata(gamesetup *game)
+{
+    if (!(game->sgflags & SGF_MAPPED))
+	free(game->solutiondata);
+    game->sgflags &= ~SGF_MAPPED;
+    game->sgflags |= SGF_MODIFIED;
+    game->solutionsize = 0;
+    game->solutiondata = NULL;
 }
 
 /* Take the given solution and compress it, storing the compressed
@@ -365,9 +425,7 @@ int contractsolution(solutioninfo const *solution, gamesetup *game)
     unsigned char      *data;
     int			size, delta, when, i;
 
-    free(game->solutiondata);
-    game->solutionsize = 0;
-    game->solutiondata = NULL;
+    freesolutiondata(game);
     if (!solution->moves.count)
 	return TRUE;
 
@@ -470,47 +528,62 @@ int contractsolution(solutioninfo const *solution, gamesetup *game)
  * File I/O for level solutions.
  */
 
-/* Read the data of a one complete solution from the given file into
- * the appropriate fields of game.
+/* Read the data of a one complete solution, starting at pos in the
+ * given file's contents, into the appropriate fields of game, and
+ * advance pos past it. The solution data is not copied: game is left
+ * pointing into the file's contents.
  */
-static int readsolution(fileinfo *file, gamesetup *game)
+static int readsolution(fileinfo *file, filemapping const *map,
+			unsigned long *pos, gamesetup *game)
 {
-    uint32_t		size;
+    unsigned char const	       *data;
+    uint32_t			size;
 
     game->number = 0;
     game->sgflags = 0;
     game->besttime = TIME_NIL;
     game->solutionsize = 0;
     game->solutiondata = NULL;
-    if (!file->fp)
-	return TRUE;
 
-    if (!filereadint32(file, &size, NULL) || size == 0xFFFFFFFF)
+    if (map->size - *pos < 4)
+	return FALSE;
+    data = map->data + *pos;
+    size = data[0] | (data[1] << 8) | (data[2] << 16)
+		   | ((uint32_t)data[3] << 24);
+    *pos += 4;
+    if (size == 0xFFFFFFFF)
 	return FALSE;
     if (!size)
 	return TRUE;
+    errno = 0;
+    if (size > map->size - *pos) {
+	fileerr(file, "unexpected EOF");
+	return fileerr(file, "invalid data in solution file");
+    }
+    data += 4;
+    *pos += size;
     game->solutionsize = size;
-    game->solutiondata = filereadbuf(file, size, "unexpected EOF");
-    if (!game->solutiondata || (size <= 16 && size != 6))
+    game->solutiondata = (unsigned char*)data;
+    game->sgflags |= SGF_MAPPED;
+    if (size <= 16 && size != 6)
 	return fileerr(file, "invalid data in solution file");
-    game->number = (game->solutiondata[1] << 8) | game->solutiondata[0];
-    memcpy(game->passwd, game->solutiondata + 2, 4);
+    game->number = (data[1] << 8) | data[0];
+    memcpy(game->passwd, data + 2, 4);
     game->passwd[5] = '\0';
     game->sgflags |= SGF_HASPASSWD;
     if (size == 6)
 	return TRUE;
 
-    game->besttime = game->solutiondata[12] | (game->solutiondata[13] << 8)
-					    | (game->solutiondata[14] << 16)
-					    | (game->solutiondata[15] << 24);
+    game->besttime = data[12] | (data[13] << 8) | (data[14] << 16)
+			      | (data[15] << 24);
     size -= 16;
     if (!game->number && !*game->passwd) {
 	game->sgflags |= SGF_SETNAME;
+	game->sgflags &= ~SGF_MAPPED;
 	if (size > 255)
 	    size = 255;
-	memcpy(game->name, game->solutiondata + 16, size);
+	memcpy(game->name, data + 16, size);
 	game->name[size] = '\0';
-	free(game->solutiondata);
 	game->solutionsize = 0;
 	game->solutiondata = NULL;
     }
@@ -542,32 +615,54 @@ static int writesolution(fileinfo *file, gamesetup const *game)
  * File I/O for solution files.
  */
 
-/* Locate the solution file for the given data file and open it.
+/* Return the name of the solution file for the given series, with
+ * suffix added to the end, in an allocated buffer.
  */
-static int opensolutionfile(fileinfo *file, char const *datname, int writable)
+static char *getsolutionfilename(gameseries const *series,
+				 char const *suffix)
 {
-    static int	savedirchecked = FALSE;
+    char const *name;
     char       *buf = NULL;
-    char const *filename;
-    int		n;
-
-    if (writable && readonly)
-	return FALSE;
-
-    if (file->name) {
-	filename = file->name;
+    int		m, n;
+
+    m = strlen(suffix);
+    if (series->savefile.name) {
+	name = series->savefile.name;
+	n = strlen(name);
+	x_alloc(buf, n + m + 1);
+	memcpy(buf, name, n);
     } else {
-	n = strlen(datname);
-	if (datname[n - 4] == '.' && tolower(datname[n - 3]) == 'd'
-				  && tolower(datname[n - 2]) == 'a'
-				  && tolower(datname[n - 1]) == 't')
+	name = series->filebase;
+	n = strlen(name);
+	if (name[n - 4] == '.' && tolower(name[n - 3]) == 'd'
+			       && tolower(name[n - 2]) == 'a'
+			       && tolower(name[n - 1]) == 't')
 	    n -= 4;
-	x_alloc(buf, n + 5);
-	memcpy(buf, datname, n);
-	memcpy(buf + n, ".tws", 5);
-	filename = buf;
+	x_alloc(buf, n + m + 5);
+	memcpy(buf, name, n);
+	memcpy(buf + n, ".tws", 4);
+	n += 4;
     }
+    memcpy(buf + n, suffix, m + 1);
+    return buf;
+}
+
+/* Locate the solution file for the given series, or the file whose
+ * name is that of the solution file with suffix added, and open it
+ * with the given mode.
+ */
+static int opensolutionfile(gameseries const *series, fileinfo *file,
+			    char const *suffix, char const *mode)
+{
+    static int	savedirchecked = FALSE;
+    char       *filename;
+    int		writable, n;
+
+    writable = *mode != 'r';
+    if (writable && readonly)
+	return FALSE;
 
+    filename = getsolutionfilename(series, suffix);
     if (writable) {
 	if (!savedirchecked && savedir && *savedir && !haspathname(filename)) {
 	    savedirchecked = TRUE;
@@ -578,44 +673,50 @@ static int opensolutionfile(fileinfo *file, char const *datname, int writable)
 	}
     }
 
-    n = openfileindir(file, savedir, filename,
-		      writable ? "wb" : "rb",
+    n = openfileindir(file, savedir, filename, mode,
 		      writable ? "can't access file" : NULL);
-    if (buf)
-	free(buf);
+    free(filename);
     return n;
 }
 
-/* Read the saved solution data for the given series into memory.
+/* Return the full pathname of the solution file for the given series,
+ * with suffix added, in an allocated buffer.
  */
-int readsolutions(gameseries *series)
+static char *getsolutionpath(gameseries const *series, char const *suffix)
 {
-    gamesetup	gametmp = {0};
-    int		n;
+    char       *filename;
+    char       *path;
 
-    if (!series->savefile.name)
-	series->savefile.name = series->savefilename;
-    if ((!series->savefile.name && (series->gsflags & GSF_NODEFAULTSAVE))
-		|| !opensolutionfile(&series->savefile,
-				     series->filebase, FALSE)) {
-	series->solheaderflags = 0;
-	series->solheadersize = 0;
-	return TRUE;
-    }
+    filename = getsolutionfilename(series, suffix);
+    path = getpathforfileindir(savedir, filename);
+    free(filename);
+    return path;
+}
 
-    if (!readsolutionheader(&series->savefile, series->ruleset,
-			    &series->solheaderflags,
-			    &series->solheadersize, series->solheader))
-	return FALSE;
+/* Read the solutions stored in the given file's contents, starting at
+ * pos, and give them to the matching levels of the series. A solution
+ * replaces any that the level already has. If end is not NULL, it
+ * receives the position just past the last record read intact. FALSE
+ * is returned if the solutions were recorded for a different level
+ * set.
+ */
+static int readsolutionlist(gameseries *series, fileinfo *file,
+			    filemapping const *map, unsigned long pos,
+			    unsigned long *end)
+{
+    gamesetup	gametmp = {0};
+    int		n;
 
     for (;;) {
-	if (!readsolution(&series->savefile, &gametmp))
+	if (end)
+	    *end = pos;
+	if (!readsolution(file, map, &pos, &gametmp))
 	    break;
 	if (gametmp.sgflags & SGF_SETNAME) {
 	    if (strcmp(gametmp.name, series->name)) {
 		errmsg(series->name, "ignoring solution file %s as it was"
 				     " recorded for a different level set: %s",
-		       series->savefile.name, gametmp.name);
+		       file->name, gametmp.name);
 		series->gsflags |= GSF_NOSAVING;
 		return FALSE;
 	    }
@@ -625,27 +726,154 @@ int readsolutions(gameseries *series)
 	if (n < 0) {
 	    n = findlevelinseries(series, 0, gametmp.passwd);
 	    if (n < 0) {
-		fileerr(&series->savefile,
-			"unmatched password in solution file");
+		fileerr(file, "unmatched password in solution file");
 		continue;
 	    }
 	    warn("level %d has been moved to level %d",
 		 gametmp.number, series->games[n].number);
 	}
+	freesolutiondata(series->games + n);
 	series->games[n].besttime = gametmp.besttime;
 	series->games[n].sgflags = gametmp.sgflags;
 	series->games[n].solutionsize = gametmp.solutionsize;
 	series->games[n].solutiondata = gametmp.solutiondata;
     }
+    return TRUE;
+}
+
+/* Read the saved solution data for the given series into memory,
+ * followed by any solutions saved to the journal since the solution
+ * file was last written. If the journal ends in a partial record (as
+ * when the program was stopped while appending to it), the records
+ * before it are kept, and the series is marked so that the next save
+ * writes the solution file anew rather than appending after it.
+ */
+int readsolutions(gameseries *series)
+{
+    fileinfo		file;
+    unsigned long	pos, end;
+
+    if (!series->savefile.name)
+	series->savefile.name = series->savefilename;
+    if ((!series->savefile.name && (series->gsflags & GSF_NODEFAULTSAVE))
+		|| !opensolutionfile(series, &series->savefile, "", "rb")) {
+	series->solheaderflags = 0;
+	series->solheadersize = 0;
+	return TRUE;
+    }
 
+    if (!filemap(&series->savefile, &series->savemap, "can't read file"))
+	return FALSE;
+    pos = readsolutionheader(&series->savefile, &series->savemap,
+			     series->ruleset, &series->solheaderflags,
+			     &series->solheadersize, series->solheader);
+    if (!pos)
+	return FALSE;
+    if (!readsolutionlist(series, &series->savefile, &series->savemap,
+			  pos, NULL))
+	return FALSE;
     fileclose(&series->savefile, NULL);
+    series->gsflags |= GSF_SAVEFILEREAD;
+
+    clearfileinfo(&file);
+    if (opensolutionfile(series, &file, JOURNALSUFFIX, "rb")) {
+	if (filemap(&file, &series->journalmap, "can't read file")
+				&& series->journalmap.size) {
+	    series->gsflags |= GSF_JOURNALED;
+	    if (readsolutionlist(series, &file, &series->journalmap, 0, &end)
+				&& end < series->journalmap.size) {
+		warn("%s: ignoring %lu bytes at the end of the journal",
+		     series->name, series->journalmap.size - end);
+		series->gsflags |= GSF_JOURNALTORN;
+	    }
+	}
+	fileclose(&file, NULL);
+    }
+    return TRUE;
+}
+
+/* Write out all the solutions for the given series to a new solution
+ * file, and then put it in place of the old one and delete the
+ * journal. The old file is not overwritten, so that a failure partway
+ * through leaves it intact, and so that any memory mapping of it
+ * remains valid.
+ */
+static int writesolutionfile(gameseries *series)
+{
+    fileinfo	file;
+    gamesetup  *game;
+    char       *newpath;
+    char       *path;
+    int		i;
+
+    clearfileinfo(&file);
+    if (!opensolutionfile(series, &file, NEWFILESUFFIX, "wb"))
+	return FALSE;
+
+    if (!writesolutionheader(&file, series->ruleset,
+			     series->solheaderflags,
+			     series->solheadersize, series->solheader))
+	goto corrupted;
+    if (!writesolutionsetname(&file, series->name))
+	goto corrupted;
+    for (i = 0, game = series->games ; i < series->count ; ++i, ++game) {
+	if (!writesolution(&file, game))
+	    goto corrupted;
+    }
+    if (!filesync(&file, "write error"))
+	goto corrupted;
+    fileclose(&file, NULL);
+
+    newpath = getsolutionpath(series, NEWFILESUFFIX);
+    path = getsolutionpath(series, "");
+    if (!newpath || !path) {
+	free(newpath);
+	free(path);
+	return FALSE;
+    }
+#ifdef WIN32
+    remove(path);
+#endif
+    errno = 0;
+    if (rename(newpath, path)) {
+	file.name = path;
+	fileerr(&file, "can't replace file");
+	free(newpath);
+	free(path);
+	return FALSE;
+    }
+    free(newpath);
+    free(path);
+
+    if ((path = getsolutionpath(series, JOURNALSUFFIX))) {
+	remove(path);
+	free(path);
+    }
+    for (i = 0, game = series->games ; i < series->count ; ++i, ++game)
+	game->sgflags &= ~SGF_MODIFIED;
+    series->gsflags |= GSF_SAVEFILEREAD;
+    series->gsflags &= ~(GSF_JOURNALED | GSF_JOURNALTORN);
     return TRUE;
+
+  corrupted:
+    fileerr(&file, "saved-game file has become corrupted!");
+    remove(file.name);
+    fileclose(&file, NULL);
+    return FALSE;
 }
 
-/* Write out all the solutions for the given series.
+/* Save the solutions of the given series that have changed. Once a
+ * solution file exists, the changed solutions are appended to the
+ * journal, in the same form as they take in the solution file, with
+ * a single flush to the disk. The solution file itself is only
+ * written anew when the journal cannot express a change, namely the
+ * loss of a level's password along with its solution, or when the
+ * journal ends in a partial record that would be followed by the new
+ * ones.
  */
 int savesolutions(gameseries *series)
 {
+    fileinfo	file;
     gamesetup  *game;
     int		i;
 
@@ -658,27 +886,52 @@ int savesolutions(gameseries *series)
 	series->savefile.name = series->savefilename;
     if (!series->savefile.name && (series->gsflags & GSF_NODEFAULTSAVE))
 	return TRUE;
-    if (!opensolutionfile(&series->savefile, series->filebase, TRUE))
-	return FALSE;
 
-    if (!writesolutionheader(&series->savefile, series->ruleset,
-			     series->solheaderflags,
-			     series->solheadersize, series->solheader))
-	return fileerr(&series->savefile,
-		       "saved-game file has become corrupted!");
-    if (!writesolutionsetname(&series->savefile, series->name))
-	return fileerr(&series->savefile,
-		       "saved-game file has become corrupted!");
+    if (!(series->gsflags & GSF_SAVEFILEREAD)
+			|| (series->gsflags & GSF_JOURNALTORN))
+	return writesolutionfile(series);
+    for (i = 0, game = series->games ; i < series->count ; ++i, ++game)
+	if ((game->sgflags & SGF_MODIFIED) && !game->solutionsize
+					   && !(game->sgflags & SGF_HASPASSWD))
+	    return writesolutionfile(series);
+
+    clearfileinfo(&file);
+    if (!opensolutionfile(series, &file, JOURNALSUFFIX, "ab"))
+	return FALSE;
     for (i = 0, game = series->games ; i < series->count ; ++i, ++game) {
-	if (!writesolution(&series->savefile, game))
-	    return fileerr(&series->savefile,
-			   "saved-game file has become corrupted!");
+	if (!(game->sgflags & SGF_MODIFIED))
+	    continue;
+	if (!writesolution(&file, game)) {
+	    fileerr(&file, "saved-game journal has become corrupted!");
+	    fileclose(&file, NULL);
+	    return FALSE;
+	}
     }
+    if (!filesync(&file, "write error")) {
+	fileclose(&file, NULL);
+	return FALSE;
+    }
+    fileclose(&file, NULL);
 
-    fileclose(&series->savefile, NULL);
+    for (i = 0, game = series->games ; i < series->count ; ++i, ++game)
+	game->sgflags &= ~SGF_MODIFIED;
+    series->gsflags |= GSF_JOURNALED;
     return TRUE;
 }
 
+/* Fold the journal back into the solution file, if it has anything in
+ * it.
+ */
+int compactsolutions(gameseries *series)
+{
+    if (readonly || (series->gsflags & GSF_NOSAVING)
+		 || !(series->gsflags & GSF_JOURNALED))
+	return TRUE;
+    if (!series->savefile.name)
+	series->savefile.name = series->savefilename;
+    return writesolutionfile(series);
+}
+
 /* Free all memory allocated for storing the game's solutions, and mark
  * the levels as being unsolved.
  */
@@ -688,12 +941,14 @@ void clearsolutions(gameseries *series)
     int		n;
 
     for (n = 0, game = series->games ; n < series->count ; ++n, ++game) {
-	free(game->solutiondata);
+	freesolutiondata(game);
 	game->besttime = TIME_NIL;
 	game->sgflags = 0;
-	game->solutionsize = 0;
-	game->solutiondata = NULL;
     }
+    fileunmap(&series->savemap);
+    fileunmap(&series->journalmap);
+    series->gsflags &= ~(GSF_SAVEFILEREAD | GSF_JOURNALED
+					  | GSF_JOURNALTORN);
     series->solheadersize = 0;
     series->solheaderflags = 0;
     fileclose(&series->savefile, NULL);
@@ -757,16 +1012,30 @@ typedef	struct solutiondata {
     int		prefixlen;	/* length of the filename prefix */
 } solutiondata;
 
+/* Return TRUE if filename ends with suffix.
+ */
+static int hassuffix(char const *filename, char const *suffix)
+{
+    int	m, n;
+
+    m = strlen(filename);
+    n = strlen(suffix);
+    return m >= n && !strcmp(filename + m - n, suffix);
+}
+
 /* If the given file starts with the prefix stored in the solutiondata
- * structure, then add it to the pool of filenames, prefixed with
- * "1-". This function is a callback for findfiles().
+ * structure, and is not a journal or an unfinished solution file, then
+ * add it to the pool of filenames, prefixed with "1-". This function
+ * is a callback for findfiles().
  */
 static int getsolutionfile(char *filename, void *data)
 {
     solutiondata       *sdata = data;
     int			n;
 
-    if (!memcmp(filename, sdata->prefix, sdata->prefixlen)) {
+    if (!memcmp(filename, sdata->prefix, sdata->prefixlen)
+			&& !hassuffix(filename, JOURNALSUFFIX)
+			&& !hassuffix(filename, NEWFILESUFFIX)) {
 	n = strlen(filename) + 1;
 	x_alloc(sdata->pool, sdata->allocated + n + 2);
 	sdata->pool[sdata->allocated++] = '1';
@@ -46,30 +46,60 @@ extern void destroymovelist(actlist *list);
 
 /* Expand a level's solution data into the actual solution, including
  * the full list of moves. FALSE is returned if the solution is
- * invalid or absent.
+ * invalid or absent. (When the moves only need to be read through
+ * once, as in playing the solution back, a cursor is cheaper.)
  */
 extern int expandsolution(solutioninfo *solution, gamesetup const *game);
 
+/* Read the header of a level's solution data into solution, without
+ * expanding the list of moves, and set cursor to the first move. The
+ * moves field of solution is left untouched. FALSE is returned if the
+ * solution is invalid or absent.
+ */
+extern int opensolution(solutioninfo *solution, solutioncursor *cursor,
+			gamesetup const *game);
+
+/* Move cursor on to the next move in the level's solution data, and
+ * return the cursor's more field. The data must be the same as when
+ * the cursor was opened.
+ */
+extern int nextsolutionmove(solutioncursor *cursor, gamesetup const *game);
+
 /* Take the given solution and compress it, storing the compressed
  * data as part of the level's setup. FALSE is returned if an error
  * occurs. (It is not an error to compress the null solution.)
  */
 extern int contractsolution(solutioninfo const *solution, gamesetup *game);
 
-/* Read all the solutions for the given series into memory. FALSE is
- * returned if an error occurs. Note that it is not an error for the
- * solution file to not exist.
+/* Discard a level's saved solution data, and mark the level as
+ * needing to be saved.
+ */
+extern void freesolutiondata(gamesetup *game);
+
+/* Read all the solutions for the given series into memory, including
+ * any in the solution file's journal. FALSE is returned if an error
+ * occurs. Note that it is not an error for the solution file to not
+ * exist.
  */
 extern int readsolutions(gameseries *series);
 
-/* Write out all the solutions for the given series. The solution file
- * is created if it does not currently exist. The solution file's
- * directory is also created if it does not currently exist. (Nothing
- * is done if the directory's name has been unset, however.) FALSE is
- * returned if an error occurs.
+/* Save the solutions for the given series that have changed since
+ * they were last saved. If the solution file already exists, they are
+ * appended to a journal kept alongside it, named after the solution
+ * file with ".jnl" added; otherwise the solution file is created. The
+ * solution file's directory is also created if it does not currently
+ * exist. (Nothing is done if the directory's name has been unset,
+ * however.) FALSE is returned if an error occurs.
  */
 extern int savesolutions(gameseries *series);
 
+/* Rewrite the solution file for the given series, so that it holds
+ * all of the solutions saved to its journal, and delete the journal.
+ * Nothing is done if the journal is empty. FALSE is returned if an
+ * error occurs.
+ */
+extern int compactsolutions(gameseries *series);
+
 /* Free all memory allocated for storing the game's solutions, and mark
  * the levels as being unsolved.
  */
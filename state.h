@@ -188,6 +188,7 @@ typedef struct creature {
     unsigned char	hidden;		/* TRUE if creature is invisible */
     unsigned char	state;		/* internal state value */
     unsigned char	tdir;		/* internal state value */
+    short		slipindex;	/* position on the MS slip list */
 } creature;
 #endif
 
@@ -250,8 +251,10 @@ typedef struct gamestate {
     signed char		stepping;		/* initial timer offset 0-7 */
     unsigned long	soundeffects;		/* the latest sound effects */
     actlist		moves;			/* the list of moves */
+    solutioncursor	replaycursor;		/* the next move to replay */
     prng		mainprng;		/* the main PRNG */
     creature	       *creatures;		/* the creature list */
+    struct changelog   *changes;		/* changes made, or NULL */
     short		trapcount;		/* number of trap buttons */
     short		clonercount;		/* number of cloner buttons */
     short		crlistcount;		/* number of creatures */
@@ -0,0 +1,278 @@
+/* twbench.c: Measuring the speed of the game logic modules.
+ *
+ * Copyright (C) 2001-2014 by Brian Raiter, Madhav Shanbhag, and Eric Schmidt,
+ * under the GNU General Public License. No warranty. See COPYING for details.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<time.h>
+#include	"defs.h"
+#include	"err.h"
+#include	"series.h"
+#include	"play.h"
+#include	"logic.h"
+#include	"solution.h"
+#include	"oshw.h"
+#include	"cmdline.h"
+#include	"phase.h"
+#include	"changes.h"
+
+/* This program plays through every level of the named level sets
+ * without a user interface and reports how quickly the game logic
+ * ran. A level with a saved solution is played back from it; other
+ * levels are played with a scripted series of moves that is the same
+ * on every run. Lynx level sets are run twice, the second time in
+ * pedantic mode.
+ */
+
+/* The level sets used when none are named on the command line.
+ */
+static char const *defaultsets[] = {
+    "intro-ms.dac", "intro-lynx.dac", "cc-ms.dac", "cc-lynx.dac", "CCLP2.dac"
+};
+
+/* Online help.
+ */
+static char const *yowzitch =
+    "Usage: twbench [-ch] [-r N] [-t N] [-DLS DIR] [NAME ...]\n"
+    "   -D  Read data files from DIR instead of ./data.\n"
+    "   -L  Read level sets from DIR instead of ./sets.\n"
+    "   -S  Play back the saved solutions in DIR.\n"
+    "   -r  Play through each level set N times (default 1).\n"
+    "   -t  Stop scripted play after N ticks (default 2000).\n"
+    "   -c  Record the changes made by each tick, as the display does.\n"
+    "   -h  Display this help and exit.\n"
+    "NAME specifies a level set to use (default: the bundled sets).\n";
+
+/* How many times to run through each level set.
+ */
+static int	repeats = 1;
+
+/* The maximum length of a scripted game.
+ */
+static int	maxticks = 2000;
+
+/* TRUE if the changes made by each tick are to be recorded.
+ */
+static int	logchanges = FALSE;
+
+/* The number of memory allocations made so far. The benchmark is
+ * linked so that calls to malloc() and friends come here first.
+ */
+static unsigned long	allocations = 0;
+
+extern void *__real_malloc(size_t size);
+extern void *__real_calloc(size_t count, size_t size);
+extern void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    ++allocations;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    ++allocations;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    ++allocations;
+    return __real_realloc(ptr, size);
+}
+
+/* The totals for one run through a level set.
+ */
+typedef struct benchtotals {
+    int			levels;		/* number of levels played */
+    int			replayed;	/* number played from solutions */
+    unsigned long	ticks;		/* number of ticks played */
+    unsigned long	allocations;	/* number of allocations made */
+    double		seconds;	/* time spent inside doturn() */
+} benchtotals;
+
+/* Return the current time in seconds.
+ */
+static double now(void)
+{
+    struct timespec	ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Return the next keystroke of the scripted moves. Chip walks in one
+ * direction for a while, occasionally stopping.
+ */
+static int scriptedmove(uint32_t *seed, int *cmd, int *hold)
+{
+    if (*hold <= 0) {
+	*seed = *seed * 1103515245UL + 12345UL;
+	*hold = 1 + (int)((*seed >> 16) % 12);
+	*cmd = ((*seed >> 8) & 3) == 0 ? NIL : 1 << ((*seed >> 12) & 3);
+    }
+    --*hold;
+    return *cmd;
+}
+
+/* Play through one level, adding its figures to totals.
+ */
+static void benchlevel(gamesetup *game, int ruleset, benchtotals *totals)
+{
+    unsigned long	allocs;
+    uint32_t		seed;
+    double		start;
+    int			cmd, hold, replay, f;
+
+    allocs = allocations;
+    settimer(-1);
+    if (!initgamestate(game, ruleset)) {
+	endgamestate();
+	return;
+    }
+    replay = hassolution(game) && prepareplayback();
+    seed = game->number;
+    cmd = NIL;
+    hold = 0;
+
+    start = now();
+    for (;;) {
+	f = doturn(replay ? CmdNone : scriptedmove(&seed, &cmd, &hold));
+	if (logchanges)
+	    clearchangelog(getchangelog());
+	advancetick();
+	if (f || (!replay && gettickcount() >= maxticks))
+	    break;
+    }
+    totals->seconds += now() - start;
+
+    endgamestate();
+    totals->ticks += gettickcount();
+    totals->allocations += allocations - allocs;
+    totals->replayed += replay;
+    ++totals->levels;
+}
+
+/* Display one line of the report.
+ */
+static void printtotals(char const *name, char const *mode,
+			benchtotals const *totals)
+{
+    printf("%-16.16s %-7s %6d %6d %10lu %12.0f %9.1f %9.1f\n",
+	   name, mode, totals->levels, totals->replayed, totals->ticks,
+	   totals->seconds ? totals->ticks / totals->seconds : 0.0,
+	   totals->ticks ? totals->seconds * 1e9 / totals->ticks : 0.0,
+	   totals->levels ? (double)totals->allocations / totals->levels
+			  : 0.0);
+}
+
+/* Run the benchmark on the named level set, once for each mode that
+ * applies to its ruleset. sums receives the figures for the MS, Lynx
+ * and pedantic Lynx modes, in that order.
+ */
+static int benchseries(char const *filename, benchtotals sums[3])
+{
+    gameseries	       *list;
+    benchtotals		totals;
+    char const	       *mode;
+    int			count, pedantic, which, n, i;
+
+    if (!createserieslist(filename, &list, &count, NULL) || count != 1) {
+	errmsg(filename, "level set not available; skipping");
+	return FALSE;
+    }
+    if (!readseriesfile(list)) {
+	errmsg(list->filebase, "cannot read level set; skipping");
+	return FALSE;
+    }
+
+    for (pedantic = 0 ; pedantic < 2 ; ++pedantic) {
+	if (pedantic && list->ruleset != Ruleset_Lynx)
+	    break;
+	pedanticmode = pedantic;
+	memset(&totals, 0, sizeof totals);
+	for (n = 0 ; n < repeats ; ++n)
+	    for (i = 0 ; i < list->count ; ++i)
+		benchlevel(list->games + i, list->ruleset, &totals);
+	if (list->ruleset == Ruleset_MS) {
+	    which = 0;
+	    mode = "MS";
+	} else {
+	    which = pedantic ? 2 : 1;
+	    mode = pedantic ? "Lynx/P" : "Lynx";
+	}
+	printtotals(list->name, mode, &totals);
+	sums[which].levels += totals.levels;
+	sums[which].replayed += totals.replayed;
+	sums[which].ticks += totals.ticks;
+	sums[which].allocations += totals.allocations;
+	sums[which].seconds += totals.seconds;
+    }
+    pedanticmode = FALSE;
+    freeserieslist(list, count, NULL);
+    return TRUE;
+}
+
+int main(int argc, char *argv[])
+{
+    static char const  *modes[3] = { "MS", "Lynx", "Lynx/P" };
+    cmdlineinfo		opts;
+    benchtotals		sums[3];
+    char const	      **names;
+    int			namecount = 0;
+    int			ch, i;
+
+    seriesdir = "sets";
+    seriesdatdir = "data";
+    savedir = "";
+    readonly = TRUE;
+    batchmode = TRUE;
+
+    names = malloc(argc * sizeof *names);
+    if (!names)
+	memerrexit();
+    initoptions(&opts, argc - 1, argv + 1, "cD:hL:r:S:t:");
+    while ((ch = readoption(&opts)) >= 0) {
+	switch (ch) {
+	  case 0:	names[namecount++] = opts.val;			break;
+	  case 'c':	logchanges = TRUE;				break;
+	  case 'D':	seriesdatdir = opts.val;			break;
+	  case 'L':	seriesdir = opts.val;				break;
+	  case 'S':	savedir = opts.val;				break;
+	  case 'r':	repeats = atoi(opts.val);			break;
+	  case 't':	maxticks = atoi(opts.val);			break;
+	  case 'h':	fputs(yowzitch, stdout);	   exit(EXIT_SUCCESS);
+	  default:
+	    fputs(yowzitch, stderr);
+	    return EXIT_FAILURE;
+	}
+    }
+    if (logchanges)
+	setchangelogging(TRUE);
+    if (!namecount) {
+	free(names);
+	names = defaultsets;
+	namecount = sizeof defaultsets / sizeof *defaultsets;
+    }
+
+    printf("%-16s %-7s %6s %6s %10s %12s %9s %9s\n", "level set", "rules",
+	   "levels", "saved", "ticks", "ticks/sec", "ns/tick", "allocs");
+    memset(sums, 0, sizeof sums);
+    for (i = 0 ; i < namecount ; ++i)
+	benchseries(names[i], sums);
+    for (i = 0 ; i < 3 ; ++i)
+	if (sums[i].levels)
+	    printtotals("(total)", modes[i], sums + i);
+#ifdef PHASETIMING
+    printphasetimes();
+#endif
+
+    shutdowngamestate();
+    if (names != defaultsets)
+	free(names);
+    return EXIT_SUCCESS;
+}
@@ -21,6 +21,7 @@
 #include	"oshw.h"
 #include	"cmdline.h"
 #include	"ver.h"
+#include	"verify.h"
 
 /* Bell-ringing macro.
  */
@@ -51,6 +52,7 @@ typedef	struct startupdata {
     int		listscores;	/* TRUE if the scores should be listed */
     int		listtimes;	/* TRUE if the times should be listed */
     int		batchverify;	/* TRUE to enter batch verification */
+    int		verifyjobs;	/* threads to use for batch verification */
 } startupdata;
 
 /* History of levelsets in order of last used date/time.
@@ -59,6 +61,11 @@ typedef	struct startupdata {
 static history *historylist = NULL;
 static int	historycount = 0;
 
+/* The level set currently being played, so that its solution file can
+ * be brought up to date when the program exits.
+ */
+static gameseries *currentseries = NULL;
+
 /* Structure used to hold the complete list of available series.
  */
 typedef	struct seriesdata {
@@ -87,7 +94,9 @@ static int	showhistogram = FALSE;
  */
 static int	mudsucking = 1;
 
-/* Frame-skipping disable flag.
+/* Frame-skipping disable flag. When it is set, every tick is drawn,
+ * and so the game is run in step with the display rather than on the
+ * play thread.
  */
 static int	noframeskip = FALSE;
 
@@ -443,7 +452,7 @@ static void replaceablesolution(gamespec *gs, int change)
 static void passwordseen(gamespec *gs, int number)
 {
     if (!(gs->series.games[number].sgflags & SGF_HASPASSWD)) {
-	gs->series.games[number].sgflags |= SGF_HASPASSWD;
+	gs->series.games[number].sgflags |= SGF_HASPASSWD | SGF_MODIFIED;
 	savesolutions(&gs->series);
     }
 }
@@ -654,6 +663,7 @@ static int showsolutionfiles(gamespec *gs)
 
     f = n >= 0 && n != current;
     if (f) {
+	compactsolutions(&gs->series);
 	clearsolutions(&gs->series);
 	if (!gs->series.savefilename)
 	    gs->series.savefilename = getpathbuffer();
@@ -1063,6 +1073,52 @@ static int finalinput(gamespec *gs)
     }
 }
 
+/* Step the game back one tick at a time for as long as the user
+ * keeps asking to, with play suspended meanwhile. The command that
+ * ended the rewinding is returned.
+ */
+static int rewindplay(void)
+{
+    int	cmd;
+
+    setgameplaymode(SuspendPlay);
+    cmd = CmdRewind;
+    for (;;) {
+	if (cmd == CmdRewind && rewindgame(1))
+	    drawscreen(TRUE);
+	cmd = input(TRUE);
+	if (cmd != CmdRewind && cmd != CmdPreserve)
+	    break;
+    }
+    setgameplaymode(ResumePlay);
+    return cmd;
+}
+
+/* Let the play thread run the current level, drawing the ticks as
+ * they arrive and passing on the user's moves, until either the game
+ * ends or the user enters some other command. The thread is stopped
+ * before returning. The return value is that of the last call to
+ * doturn(); if it is zero, cmd receives the command that the user
+ * entered.
+ */
+static int playthreaded(int *cmd)
+{
+    int	n;
+
+    for (;;) {
+	n = drawplaythread();
+	if (n)
+	    return stopplaythread();
+	*cmd = input(FALSE);
+	if (*cmd == CmdNone || *cmd == CmdPreserve
+			    || (*cmd >= CmdMoveFirst && *cmd <= CmdMoveLast)) {
+	    sendplaythread(*cmd);
+	    continue;
+	}
+	return stopplaythread();
+    }
+}
+
 /* Play the current level, using firstcmd as the initial key command,
  * and returning when the level's play ends. The return value is FALSE
  * if play ended because the user restarted or changed the current
@@ -1087,13 +1143,20 @@ static int playgame(gamespec *gs, int firstcmd)
     setgameplaymode(BeginPlay);
     render = lastrendered = TRUE;
     for (;;) {
-	n = doturn(cmd);
-	drawscreen(render);
-	lastrendered = render;
-	if (n)
-	    break;
-	render = waitfortick() || noframeskip;
-	cmd = input(FALSE);
+	if (!noframeskip && startplaythread(cmd)) {
+	    n = playthreaded(&cmd);
+	    lastrendered = TRUE;
+	    if (n)
+		break;
+	} else {
+	    n = doturn(cmd);
+	    drawscreen(render);
+	    lastrendered = render;
+	    if (n)
+		break;
+	    render = waitfortick() || noframeskip;
+	    cmd = input(FALSE);
+	}
 	if (cmd == CmdQuitLevel) {
 	    quitgamestate();
 	    n = -2;
@@ -1129,6 +1192,13 @@ static int playgame(gamespec *gs, int firstcmd)
 		setgameplaymode(ResumePlay);
 		cmd = CmdNone;
 		break;
+	      case CmdRewind:
+		cmd = rewindplay();
+		if (cmd == CmdQuit)
+		    exit(0);
+		if (!(cmd >= CmdMoveFirst && cmd <= CmdMoveLast))
+		    cmd = CmdNone;
+		break;
 	      case CmdHelp:
 		setgameplaymode(SuspendPlay);
 		dohelp(Help_KeysDuringGame);
@@ -1183,30 +1253,41 @@ static int playbackgame(gamespec *gs)
     int secondstoskip = -1, hideandseek = FALSE;
 
     secondstoskip = getreplaysecondstoskip();
-    
+    if (secondstoskip > 0)
+	seekplayback(secondstoskip);
+
     drawscreen(TRUE);
 
     gs->status = 0;
     setgameplaymode(BeginPlay);
     render = lastrendered = TRUE;
     for (;;) {
-	n = doturn(CmdNone);
 	hideandseek = (secondstoskip > 0  &&  secondsplayed() < secondstoskip);
-	if (hideandseek) {
-	    lastrendered = FALSE;
-	} else {
-	    drawscreen(render);
-	    lastrendered = render;
-	}
-	if (n)
-	    break;
-	if (hideandseek) {
-	    advancetick();
-	    render = TRUE;
-	    cmd = CmdNone;
+	if (!hideandseek && !noframeskip && startplaythread(CmdNone)) {
+	    n = playthreaded(&cmd);
+	    lastrendered = TRUE;
+	    if (n)
+		break;
 	} else {
-	    render = waitfortick() || noframeskip;
-	    cmd = input(FALSE);
+	    n = doturn(CmdNone);
+	    hideandseek = (secondstoskip > 0
+				&& secondsplayed() < secondstoskip);
+	    if (hideandseek) {
+		lastrendered = FALSE;
+	    } else {
+		drawscreen(render);
+		lastrendered = render;
+	    }
+	    if (n)
+		break;
+	    if (hideandseek) {
+		advancetick();
+		render = TRUE;
+		cmd = CmdNone;
+	    } else {
+		render = waitfortick() || noframeskip;
+		cmd = input(FALSE);
+	    }
 	}
 	switch (cmd) {
 	  case CmdSeek:
@@ -1217,16 +1298,19 @@ static int playbackgame(gamespec *gs)
 	    } else {
 	        secondstoskip = secondsplayed() + ((cmd == CmdNext10) ? +10 : -10);
 	    }
-	    quitgamestate();
-	    setgameplaymode(EndPlay);
-	    gs->playmode = Play_None;
-	    endgamestate();
-	    initgamestate(gs->series.games + gs->currentgame,
-			  gs->series.ruleset);
-	    prepareplayback();
-	    gs->playmode = Play_Back;
-	    gs->status = 0;
-	    setgameplaymode(BeginPlay);
+	    if (!seekplayback(secondstoskip)) {
+		quitgamestate();
+		setgameplaymode(EndPlay);
+		gs->playmode = Play_None;
+		endgamestate();
+		initgamestate(gs->series.games + gs->currentgame,
+			      gs->series.ruleset);
+		prepareplayback();
+		startpresimulation();
+		gs->playmode = Play_Back;
+		gs->status = 0;
+		setgameplaymode(BeginPlay);
+	    }
 	    lastrendered = FALSE;
 	    break;
 	  case CmdPrevLevel:	changecurrentgame(gs, -1);	goto quitloop;
@@ -1254,6 +1338,11 @@ static int playbackgame(gamespec *gs)
 	    }
 	    setgameplaymode(ResumePlay);
 	    break;
+	  case CmdRewind:
+	    if (rewindplay() == CmdQuit)
+		exit(0);
+	    secondstoskip = -1;
+	    break;
 	  case CmdHelp:
 	    setgameplaymode(SuspendPlay);
 	    dohelp(Help_None);
@@ -1362,6 +1451,8 @@ static int runcurrentlevel(gamespec *gs)
 
     valid = initgamestate(gs->series.games + gs->currentgame,
 			  gs->series.ruleset);
+    if (valid)
+	startpresimulation();
     changesubtitle(gs->series.games[gs->currentgame].name);
     passwordseen(gs, gs->currentgame);
     if (!islastinseries(gs, gs->currentgame))
@@ -1392,46 +1483,6 @@ static int runcurrentlevel(gamespec *gs)
     return ret;
 }
 
-static int batchverify(gameseries *series, int display)
-{
-    gamesetup  *game;
-    int		valid = 0, invalid = 0;
-    int		i, f;
-
-    batchmode = TRUE;
-
-    for (i = 0, game = series->games ; i < series->count ; ++i, ++game) {
-	if (!hassolution(game))
-	    continue;
-	if (initgamestate(game, series->ruleset) && prepareplayback()) {
-	    setgameplaymode(BeginVerify);
-	    while (!(f = doturn(CmdNone)))
-		advancetick();
-	    setgameplaymode(EndVerify);
-	    if (f > 0) {
-		++valid;
-		checksolution();
-	    } else {
-		++invalid;
-		game->sgflags |= SGF_REPLACEABLE;
-		if (display)
-		    printf("Solution for level %d is invalid\n", game->number);
-	    }
-	}
-	endgamestate();
-    }
-
-    if (display) {
-	if (valid + invalid == 0) {
-	    printf("No solutions were found.\n");
-	} else {
-	    printf("  Valid solutions:%4d\n", valid);
-	    printf("Invalid solutions:%4d\n", invalid);
-	}
-    }
-    return invalid;
-}
-
 /*
  * Game selection functions
  */
@@ -1695,13 +1746,14 @@ static int initoptionswithcmdline(int argc, char *argv[], startupdata *start)
     start->listscores = FALSE;
     start->listtimes = FALSE;
     start->batchverify = FALSE;
+    start->verifyjobs = 1;
     listdirs = FALSE;
     pedantic = FALSE;
     mudsucking = 1;
     soundbufsize = 0;
     volumelevel = -1;
 
-    initoptions(&opts, argc - 1, argv + 1, "abD:dFfHhL:lm:n:PpqR:rS:stVv");
+    initoptions(&opts, argc - 1, argv + 1, "abD:dFfHhj:L:lm:n:PpqR:rS:stVv");
     while ((ch = readoption(&opts)) >= 0) {
 	switch (ch) {
 	  case 0:
@@ -1738,6 +1790,7 @@ static int initoptionswithcmdline(int argc, char *argv[], startupdata *start)
 	  case 's':	start->listscores = TRUE;			break;
 	  case 't':	start->listtimes = TRUE;			break;
 	  case 'b':	start->batchverify = TRUE;			break;
+	  case 'j':	start->verifyjobs = atoi(opts.val);		break;
 	  case 'm':	mudsucking = atoi(opts.val);			break;
 	  case 'n':	volumelevel = atoi(opts.val);			break;
 	  case 'h':	printtable(stdout, yowzitch); 	   exit(EXIT_SUCCESS);
@@ -1809,6 +1862,8 @@ static void shutdownsystem(void)
 {
     savehistory();
     savesettings();
+    if (currentseries)
+	compactsolutions(currentseries);
     shutdowngamestate();
     freeallresources();
     free(resdir);
@@ -1861,8 +1916,9 @@ static int choosegameatstartup(gamespec *gs, startupdata const *start)
 	    return -1;
 	}
 	if (start->batchverify) {
-	    n = batchverify(series.list, !silence && !start->listtimes
-						  && !start->listscores);
+	    n = batchverify(series.list, start->verifyjobs,
+			    !silence && !start->listtimes
+				     && !start->listscores);
 	    if (silence)
 		exit(n > 100 ? 100 : n);
 	    else if (!start->listtimes && !start->listscores)
@@ -1921,6 +1977,7 @@ int tworld(int argc, char *argv[])
 	return EXIT_SUCCESS;
 
     atexit(shutdownsystem);
+    currentseries = &spec.series;
 
     while (f > 0) {
 	pushsubtitle(NULL);
@@ -1929,9 +1986,11 @@ int tworld(int argc, char *argv[])
 	popsubtitle();
 	cleardisplay();
 	strcpy(lastseries, spec.series.filebase);
+	compactsolutions(&spec.series);
 	freeseriesdata(&spec.series);
 	f = choosegame(&spec, lastseries);
     };
 
+    currentseries = NULL;
     return (f == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
 }
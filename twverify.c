@@ -0,0 +1,162 @@
+/* twverify.c: Batch verification of solutions without a user interface.
+ *
+ * Copyright (C) 2001-2014 by Brian Raiter, Madhav Shanbhag, and Eric Schmidt,
+ * under the GNU General Public License. No warranty. See COPYING for details.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	"defs.h"
+#include	"err.h"
+#include	"series.h"
+#include	"play.h"
+#include	"solution.h"
+#include	"fileio.h"
+#include	"cmdline.h"
+#include	"verify.h"
+
+/* This program does the same thing as "tworld -b", but is linked
+ * only with the core modules and nullhw.c, so it starts up quickly
+ * and can run where there is no display.
+ */
+
+/* Online help.
+ */
+static char const *yowzitch =
+    "Usage: twverify [-hqP] [-j N] [-DLS DIR] NAME [SNAME]\n"
+    "   -D  Read data files from DIR instead of the default.\n"
+    "   -L  Read level sets from DIR instead of the default.\n"
+    "   -S  Read saved games from DIR instead of the default.\n"
+    "   -P  Put Lynx ruleset emulation in pedantic mode.\n"
+    "   -j  Use N threads to verify the solutions.\n"
+    "   -q  Display nothing; the exit code is the number of invalid"
+    " solutions.\n"
+    "   -h  Display this help and exit.\n"
+    "NAME specifies which data file to use.\n"
+    "SNAME specifies an alternate solution file.\n";
+
+/* Set the directories, using the same defaults as tworld.
+ */
+static void initdirs(char const *series, char const *seriesdat,
+		     char const *save)
+{
+    char const *root = NULL;
+    char const *dir;
+
+    if (!series || !seriesdat) {
+	if ((dir = getenv("TWORLDDIR")) && *dir)
+	    root = dir;
+	if (!root) {
+#ifdef ROOTDIR
+	    root = ROOTDIR;
+#else
+	    root = ".";
+#endif
+	}
+    }
+    if (!save && (dir = getenv("TWORLDSAVEDIR")) && *dir)
+	save = dir;
+
+    seriesdir = getpathbuffer();
+    if (series)
+	sprintf(seriesdir, "%.*s", getpathbufferlen(), series);
+    else
+	combinepath(seriesdir, root, "sets");
+
+    seriesdatdir = getpathbuffer();
+    if (seriesdat)
+	sprintf(seriesdatdir, "%.*s", getpathbufferlen(), seriesdat);
+    else
+	combinepath(seriesdatdir, root, "data");
+
+    savedir = getpathbuffer();
+    if (save)
+	sprintf(savedir, "%.*s", getpathbufferlen(), save);
+    else if ((dir = getenv("HOME")) && *dir)
+	combinepath(savedir, dir, ".tworld");
+    else
+	combinepath(savedir, root, "save");
+}
+
+int main(int argc, char *argv[])
+{
+    cmdlineinfo	opts;
+    gameseries *list;
+    char       *filename = NULL;
+    char       *name;
+    char       *savefilename = NULL;
+    char const *optseriesdir = NULL;
+    char const *optseriesdatdir = NULL;
+    char const *optsavedir = NULL;
+    int		silence = FALSE;
+    int		jobs = 1;
+    int		count, ch, n;
+
+    initoptions(&opts, argc - 1, argv + 1, "D:hj:L:PqS:");
+    while ((ch = readoption(&opts)) >= 0) {
+	switch (ch) {
+	  case 0:
+	    if (!filename) {
+		filename = opts.val;
+	    } else if (!savefilename) {
+		savefilename = opts.val;
+	    } else {
+		fprintf(stderr, "too many arguments: %s\n", opts.val);
+		fputs(yowzitch, stderr);
+		return EXIT_FAILURE;
+	    }
+	    break;
+	  case 'D':	optseriesdatdir = opts.val;			break;
+	  case 'L':	optseriesdir = opts.val;			break;
+	  case 'S':	optsavedir = opts.val;				break;
+	  case 'P':	setpedanticmode();				break;
+	  case 'q':	silence = TRUE;					break;
+	  case 'j':	jobs = atoi(opts.val);				break;
+	  case 'h':	fputs(yowzitch, stdout);	   exit(EXIT_SUCCESS);
+	  case ':':
+	    fprintf(stderr, "option requires an argument: -%c\n", opts.opt);
+	    fputs(yowzitch, stderr);
+	    return EXIT_FAILURE;
+	  default:
+	    fprintf(stderr, "unrecognized option: -%c\n", opts.opt);
+	    fputs(yowzitch, stderr);
+	    return EXIT_FAILURE;
+	}
+    }
+    if (!filename) {
+	fputs(yowzitch, stderr);
+	return EXIT_FAILURE;
+    }
+
+    initdirs(optseriesdir, optseriesdatdir, optsavedir);
+
+    /* A solution file can be named in place of its level set.
+     */
+    if (!savefilename) {
+	name = getpathbuffer();
+	if (loadsolutionsetname(filename, name) > 0) {
+	    savefilename = filename;
+	    filename = name;
+	} else {
+	    free(name);
+	}
+    }
+
+    if (!createserieslist(filename, &list, &count, NULL))
+	return EXIT_FAILURE;
+    if (count != 1) {
+	errmsg(filename, count ? "more than one level set matches"
+			       : "no level sets found");
+	return EXIT_FAILURE;
+    }
+    if (savefilename)
+	list->savefilename = savefilename;
+    if (!readseriesfile(list)) {
+	errmsg(list->filebase, "cannot read level set");
+	return EXIT_FAILURE;
+    }
+
+    n = batchverify(list, jobs, !silence);
+    return silence ? (n > 100 ? 100 : n) : EXIT_SUCCESS;
+}
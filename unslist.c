@@ -12,6 +12,7 @@
 #include	"err.h"
 #include	"fileio.h"
 #include	"res.h"
+#include	"series.h"
 #include	"solution.h"
 #include	"unslist.h"
 
@@ -199,14 +200,16 @@ static int readunslist(fileinfo *file)
  * set name is supplied, so this function relies on the other three
  * data. A copy of the level's annotation is made if note is not NULL.
  */
-int islevelunsolvable(gamesetup const *game, char *note)
+int islevelunsolvable(gamesetup *game, char *note)
 {
     int		i;
 
     for (i = 0 ; i < listcount ; ++i) {
-	if (unslist[i].levelnum == game->number
-		      && unslist[i].size == game->levelsize
-		      && unslist[i].hashval == game->levelhash) {
+	if (unslist[i].levelnum != game->number
+		      || unslist[i].size != game->levelsize)
+	    continue;
+	readleveldetails(game);
+	if (unslist[i].hashval == game->levelhash) {
 	    if (note)
 		strcpy(note, getstring(unslist[i].note));
 	    return TRUE;
@@ -235,9 +238,11 @@ int markunsolvablelevels(gameseries *series)
 	if (unslist[i].setid != setid)
 	    continue;
 	for (j = 0 ; j < series->count ; ++j) {
-	    if (series->games[j].number == unslist[i].levelnum
-			&& series->games[j].levelsize == unslist[i].size
-			&& series->games[j].levelhash == unslist[i].hashval) {
+	    if (series->games[j].number != unslist[i].levelnum
+			|| series->games[j].levelsize != unslist[i].size)
+		continue;
+	    readleveldetails(series->games + j);
+	    if (series->games[j].levelhash == unslist[i].hashval) {
 		series->games[j].unsolvable = getstring(unslist[i].note);
 		++count;
 		break;
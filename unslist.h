@@ -22,7 +22,7 @@ extern int loadunslistfromfile(char const *filename);
  * the buffer it points to will receive a copy of the level's
  * annotation.
  */
-extern int islevelunsolvable(gamesetup const *game, char *note);
+extern int islevelunsolvable(gamesetup *game, char *note);
 
 /* Look up all the levels in the given series, and mark the ones that
  * appear in the list of unsolvable levels by initializing the
@@ -0,0 +1,348 @@
+/* verify.c: Batch verification of a series' solutions.
+ *
+ * Copyright (C) 2001-2014 by Brian Raiter, Madhav Shanbhag, and Eric Schmidt,
+ * under the GNU General Public License. No warranty. See COPYING for details.
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<pthread.h>
+#include	"defs.h"
+#include	"err.h"
+#include	"fileio.h"
+#include	"logic.h"
+#include	"series.h"
+#include	"solution.h"
+#include	"play.h"
+#include	"ver.h"
+#include	"verify.h"
+
+/* The name of the file in savedir that remembers earlier results.
+ */
+#define	CACHEFILENAME	"verifycache"
+
+/* An entry in the cache of verification results. A result can be
+ * reused as long as the level and the solution are the same, and they
+ * are played back under the same rules. Results from other versions
+ * of the program, or from another revision of the game logic, are
+ * never kept, so neither is stored here. Each entry belongs to the
+ * series that it was made for, so that the entries for a series'
+ * old levels and solutions can be dropped when it is verified again.
+ */
+typedef struct cacheentry {
+    char		series[256];	/* the series' filename */
+    int			seen;		/* TRUE if used by this run */
+    int			ruleset;	/* the ruleset used */
+    int			pedantic;	/* TRUE if in pedantic mode */
+    uint32_t		levelhash;	/* the level data's hash value */
+    uint32_t		solutionhash;	/* the solution data's hash value */
+    int			solutionsize;	/* size of the solution data */
+    verifyresult	result;		/* the outcome of the playback */
+} cacheentry;
+
+/* The cache of results, sorted by key.
+ */
+static cacheentry      *cache = NULL;
+static int		cachecount = 0;
+static int		cacheallocated = 0;
+
+/* The work shared by the verification threads. Each thread claims
+ * the next unclaimed level and stores its outcome in the slot of the
+ * results array with the same index.
+ */
+typedef struct verifyjob {
+    gameseries	       *series;		/* the series being verified */
+    verifyresult       *results;	/* one outcome per level */
+    int			next;		/* index of the next level */
+    pthread_mutex_t	mutex;		/* guards next */
+} verifyjob;
+
+/*
+ * The cache of verification results.
+ */
+
+/* Fill in the key of a cache entry for the given level.
+ */
+static void makecachekey(cacheentry *entry, gameseries const *series,
+			 gamesetup const *game)
+{
+    sprintf(entry->series, "%.*s", (int)(sizeof entry->series - 1),
+	    series->name);
+    entry->seen = TRUE;
+    entry->ruleset = series->ruleset;
+    entry->pedantic = series->ruleset == Ruleset_Lynx && pedanticmode;
+    entry->levelhash = game->levelhash;
+    entry->solutionhash = hashvalue(game->solutiondata, game->solutionsize);
+    entry->solutionsize = game->solutionsize;
+}
+
+/* Compare the keys of two cache entries.
+ */
+static int cachekeycmp(void const *a, void const *b)
+{
+    cacheentry const   *x = a;
+    cacheentry const   *y = b;
+    int			n;
+
+    if ((n = strcmp(x->series, y->series)))
+	return n;
+    if (x->ruleset != y->ruleset)
+	return x->ruleset < y->ruleset ? -1 : +1;
+    if (x->pedantic != y->pedantic)
+	return x->pedantic < y->pedantic ? -1 : +1;
+    if (x->levelhash != y->levelhash)
+	return x->levelhash < y->levelhash ? -1 : +1;
+    if (x->solutionhash != y->solutionhash)
+	return x->solutionhash < y->solutionhash ? -1 : +1;
+    if (x->solutionsize != y->solutionsize)
+	return x->solutionsize < y->solutionsize ? -1 : +1;
+    return 0;
+}
+
+/* Add an entry to the end of the cache.
+ */
+static void addtocache(cacheentry const *entry)
+{
+    if (cachecount >= cacheallocated) {
+	cacheallocated = cacheallocated ? cacheallocated * 2 : 256;
+	x_alloc(cache, cacheallocated * sizeof *cache);
+    }
+    cache[cachecount++] = *entry;
+}
+
+/* Read the cache file from savedir. Lines that are malformed or that
+ * were written by a different version of the program or revision of
+ * the game logic are skipped.
+ */
+static void readcache(void)
+{
+    fileinfo		file;
+    cacheentry		entry;
+    char		buf[512], version[64];
+    char	       *p;
+    unsigned long	levelhash, solutionhash;
+    int			revision, n;
+
+    cachecount = 0;
+    clearfileinfo(&file);
+    if (!openfileindir(&file, savedir, CACHEFILENAME, "r", NULL))
+	return;
+    for (;;) {
+	n = sizeof buf - 1;
+	if (!filegetline(&file, buf, &n, NULL))
+	    break;
+	if (buf[0] == '#' || !(p = strchr(buf, '\n')))
+	    continue;
+	*p = '\0';
+	n = 0;
+	if (sscanf(buf, "%63s %d %d %d %lx %lx %d %d %d %d\t%n", version,
+		   &revision, &entry.ruleset, &entry.pedantic,
+		   &levelhash, &solutionhash, &entry.solutionsize,
+		   &entry.result.status, &entry.result.currenttime,
+		   &entry.result.timeoffset, &n) != 10 || !n || !buf[n])
+	    continue;
+	if (strcmp(version, VERSION) || revision != LOGIC_REVISION
+				     || !entry.result.status)
+	    continue;
+	sprintf(entry.series, "%.*s", (int)(sizeof entry.series - 1),
+		buf + n);
+	entry.seen = FALSE;
+	entry.levelhash = (uint32_t)levelhash;
+	entry.solutionhash = (uint32_t)solutionhash;
+	addtocache(&entry);
+    }
+    fileclose(&file, NULL);
+    qsort(cache, cachecount, sizeof *cache, cachekeycmp);
+}
+
+/* Drop the entries made for the given series, under its present rules,
+ * that were not used by this run. Their levels or solutions have since
+ * changed, so they can never be used again. The number of entries
+ * dropped is returned.
+ */
+static int prunecache(gameseries const *series)
+{
+    int	pedantic, i, n;
+
+    pedantic = series->ruleset == Ruleset_Lynx && pedanticmode;
+    for (i = n = 0 ; i < cachecount ; ++i) {
+	if (!cache[i].seen && cache[i].ruleset == series->ruleset
+			   && cache[i].pedantic == pedantic
+			   && !strcmp(cache[i].series, series->name))
+	    continue;
+	cache[n++] = cache[i];
+    }
+    i = cachecount - n;
+    cachecount = n;
+    return i;
+}
+
+/* Write the cache out to savedir, sorting any new entries into place
+ * first.
+ */
+static int writecache(void)
+{
+    fileinfo	file;
+    int		i;
+
+    if (readonly || !savedir || !*savedir || !finddir(savedir))
+	return FALSE;
+    qsort(cache, cachecount, sizeof *cache, cachekeycmp);
+    clearfileinfo(&file);
+    if (!openfileindir(&file, savedir, CACHEFILENAME, "w",
+		       "can't write verification cache"))
+	return FALSE;
+    fputs("# version logic ruleset pedantic levelhash solutionhash"
+	  " solutionsize status ticks timeoffset series\n", file.fp);
+    for (i = 0 ; i < cachecount ; ++i)
+	fprintf(file.fp, "%s %d %d %d %08lX %08lX %d %d %d %d\t%s\n",
+		VERSION, LOGIC_REVISION, cache[i].ruleset, cache[i].pedantic,
+		(unsigned long)cache[i].levelhash,
+		(unsigned long)cache[i].solutionhash,
+		cache[i].solutionsize, cache[i].result.status,
+		cache[i].result.currenttime, cache[i].result.timeoffset,
+		cache[i].series);
+    fileclose(&file, NULL);
+    return TRUE;
+}
+
+/* Release the cache.
+ */
+static void freecache(void)
+{
+    free(cache);
+    cache = NULL;
+    cachecount = 0;
+    cacheallocated = 0;
+}
+
+/*
+ * Verification proper.
+ */
+
+/* Verify levels until there are none left to claim.
+ */
+static void *verifyworker(void *data)
+{
+    verifyjob  *job = data;
+    gamesetup  *game;
+    int		n;
+
+    for (;;) {
+	pthread_mutex_lock(&job->mutex);
+	n = job->next++;
+	pthread_mutex_unlock(&job->mutex);
+	if (n >= job->series->count)
+	    break;
+	game = job->series->games + n;
+	if (hassolution(game) && !job->results[n].status)
+	    verifysolution(game, job->series->ruleset, job->results + n);
+    }
+    return NULL;
+}
+
+/* Run the verification threads. The calling thread acts as one of
+ * them, so a single job runs without starting any threads at all.
+ */
+static void runworkers(verifyjob *job, int jobs)
+{
+    pthread_t  *threads;
+    int		count, i;
+
+    if (jobs > job->series->count)
+	jobs = job->series->count;
+    count = 0;
+    threads = NULL;
+    if (jobs > 1) {
+	threads = malloc((jobs - 1) * sizeof *threads);
+	if (!threads)
+	    memerrexit();
+	for (count = 0 ; count < jobs - 1 ; ++count) {
+	    if (pthread_create(threads + count, NULL, verifyworker, job)) {
+		warn("unable to start more than %d verification threads",
+		     count + 1);
+		break;
+	    }
+	}
+    }
+    verifyworker(job);
+    for (i = 0 ; i < count ; ++i)
+	pthread_join(threads[i], NULL);
+    free(threads);
+}
+
+/* Verify all of the series' solutions, and then apply the outcomes
+ * in order of level. Solutions found in the cache are not played back
+ * again, and the outcomes of the rest are added to the cache.
+ */
+int batchverify(gameseries *series, int jobs, int display)
+{
+    verifyjob	job;
+    gamesetup  *game;
+    cacheentry	entry, *found;
+    int		valid = 0, invalid = 0, added = 0;
+    int		i;
+
+    batchmode = TRUE;
+
+    job.series = series;
+    job.next = 0;
+    job.results = calloc(series->count ? series->count : 1,
+			 sizeof *job.results);
+    if (!job.results)
+	memerrexit();
+
+    readcache();
+    for (i = 0, game = series->games ; i < series->count ; ++i, ++game) {
+	if (!hassolution(game))
+	    continue;
+	readleveldetails(game);
+	makecachekey(&entry, series, game);
+	found = bsearch(&entry, cache, cachecount, sizeof *cache,
+			cachekeycmp);
+	if (found) {
+	    found->seen = TRUE;
+	    job.results[i] = found->result;
+	}
+    }
+
+    pthread_mutex_init(&job.mutex, NULL);
+    runworkers(&job, jobs);
+    pthread_mutex_destroy(&job.mutex);
+
+    for (i = 0, game = series->games ; i < series->count ; ++i, ++game) {
+	if (!hassolution(game) || !job.results[i].status)
+	    continue;
+	makecachekey(&entry, series, game);
+	if (!bsearch(&entry, cache, cachecount - added, sizeof *cache,
+		     cachekeycmp)) {
+	    entry.result = job.results[i];
+	    addtocache(&entry);
+	    ++added;
+	}
+	if (job.results[i].status > 0) {
+	    ++valid;
+	    checkverifiedsolution(game, job.results + i);
+	} else {
+	    ++invalid;
+	    game->sgflags |= SGF_REPLACEABLE;
+	    if (display)
+		printf("Solution for level %d is invalid\n", game->number);
+	}
+    }
+    free(job.results);
+    if (prunecache(series) || added)
+	writecache();
+    freecache();
+
+    if (display) {
+	if (valid + invalid == 0) {
+	    printf("No solutions were found.\n");
+	} else {
+	    printf("  Valid solutions:%4d\n", valid);
+	    printf("Invalid solutions:%4d\n", invalid);
+	}
+    }
+    return invalid;
+}
@@ -0,0 +1,22 @@
+/* verify.h: Batch verification of a series' solutions.
+ *
+ * Copyright (C) 2001-2014 by Brian Raiter, Madhav Shanbhag, and Eric Schmidt,
+ * under the GNU General Public License. No warranty. See COPYING for details.
+ */
+
+#ifndef	HEADER_verify_h_
+#define	HEADER_verify_h_
+
+#include	"defs.h"
+
+/* Play back every solution in the given series, using up to jobs
+ * threads, and mark the ones that fail as replaceable. The results
+ * are applied in level order, so the outcome does not depend on the
+ * number of threads. Results are cached in savedir, and solutions
+ * that were verified on an earlier run are not played back again.
+ * If display is TRUE, the invalid levels and a summary are printed
+ * on stdout. The return value is the number of invalid solutions.
+ */
+extern int batchverify(gameseries *series, int jobs, int display);
+
+#endif